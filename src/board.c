@@ -0,0 +1,81 @@
+/*
+ * board.c
+ *
+ * Board profile table and DMI matching (board.h). A new model is one more
+ * table entry; keep the most specific patterns first. A writable entry is
+ * keyed on the product or board name it was verified on - never on the
+ * vendor alone, which would hand a guessed layout to a whole family.
+ */
+
+#define _GNU_SOURCE   /* FNM_CASEFOLD */
+
+#include "board.h"
+#include "ec.h"
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static void dmi_field(const char *name, char *out, size_t len);
+static int  field_matches(const char *pattern, const char *value);
+
+/* The layout this tool grew up on (EC_REG_* in ec.h), duty command 0x99 */
+#define LAYOUT_COMMON                                                        \
+    EC_REG_CPU_TEMP, EC_REG_GPU_TEMP,                                        \
+    { EC_REG_FAN1_DUTY, EC_REG_FAN2_DUTY },                                  \
+    { EC_REG_FAN1_RPM_HI, EC_REG_FAN2_RPM_HI },                              \
+    { EC_REG_FAN1_RPM_LO, EC_REG_FAN2_RPM_LO },                              \
+    0x99, { 0x01, 0x02 }, 255, 2156220L
+
+static const struct board_profile g_boards[] = {
+    /* name            sys_vendor   product_name  board_name */
+    { "gigabyte-g5",   "GIGABYTE*", "G5*",        NULL, LAYOUT_COMMON, 0 },
+    { BOARD_UNKNOWN,   NULL,        NULL,         NULL, LAYOUT_COMMON, 1 },   /* must stay last */
+};
+#define BOARD_COUNT ((int)(sizeof(g_boards) / sizeof(g_boards[0])))
+
+void board_dmi_read(struct board_dmi *d) {
+    dmi_field("sys_vendor",   d->sys_vendor,   sizeof(d->sys_vendor));
+    dmi_field("product_name", d->product_name, sizeof(d->product_name));
+    dmi_field("board_name",   d->board_name,   sizeof(d->board_name));
+}
+
+const struct board_profile *board_match(const struct board_dmi *d) {
+    for (int i = 0; i < BOARD_COUNT - 1; i++) {
+        const struct board_profile *b = &g_boards[i];
+        if (field_matches(b->sys_vendor, d->sys_vendor) &&
+            field_matches(b->product_name, d->product_name) &&
+            field_matches(b->board_name, d->board_name)) return b;
+    }
+    return &g_boards[BOARD_COUNT - 1];
+}
+
+const struct board_profile *board_by_name(const char *name) {
+    for (int i = 0; i < BOARD_COUNT; i++)
+        if (strcmp(g_boards[i].name, name) == 0) return &g_boards[i];
+    return NULL;
+}
+
+const struct board_profile *board_at(int i) {
+    return (i >= 0 && i < BOARD_COUNT) ? &g_boards[i] : NULL;
+}
+
+/* One line of /sys/class/dmi/id/<name>, newline stripped */
+static void dmi_field(const char *name, char *out, size_t len) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", BOARD_DMI_DIR, name);
+    out[0] = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    ssize_t n = read(fd, out, len - 1);
+    close(fd);
+    if (n <= 0) { out[0] = 0; return; }
+    out[n] = 0;
+    out[strcspn(out, "\n")] = 0;
+}
+
+static int field_matches(const char *pattern, const char *value) {
+    return pattern == NULL || fnmatch(pattern, value, FNM_CASEFOLD) == 0;
+}
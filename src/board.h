@@ -0,0 +1,58 @@
+/*
+ * board.h
+ *
+ * Per-model EC layout: which registers hold the temperatures, duties and
+ * RPMs, the command that writes a duty, and how raw values scale. The
+ * profile is picked once at startup from DMI (/sys/class/dmi/id) or by
+ * --board=NAME; ec.c works from the selected profile from then on.
+ *
+ * An unknown board gets BOARD_UNKNOWN: the common layout for reading, and
+ * no writes at all (auto/daemon only monitor, fans stay under EC control).
+ */
+
+#ifndef FAN_CONTROL_BOARD_H
+#define FAN_CONTROL_BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef BOARD_DMI_DIR
+#define BOARD_DMI_DIR   "/sys/class/dmi/id"
+#endif
+#define BOARD_UNKNOWN   "unknown"
+#define BOARD_DMI_MAX   64      /* per DMI string */
+
+struct board_profile {
+    const char *name;
+    /* fnmatch() patterns, case-insensitive; NULL matches anything */
+    const char *sys_vendor, *product_name, *board_name;
+
+    uint8_t cpu_temp, gpu_temp;       /* °C registers */
+    uint8_t duty[2];                  /* duty read-back, raw */
+    uint8_t rpm_hi[2], rpm_lo[2];
+    uint8_t duty_cmd;                 /* EC command that sets a duty ... */
+    uint8_t duty_port[2];             /* ... and its fan selector */
+    int     duty_raw_max;             /* raw value of 100% */
+    long    rpm_k;                    /* RPM = rpm_k / raw */
+    int     read_only;                /* never write */
+};
+
+/* What DMI says about this machine ("" where unreadable) */
+struct board_dmi {
+    char sys_vendor[BOARD_DMI_MAX];
+    char product_name[BOARD_DMI_MAX];
+    char board_name[BOARD_DMI_MAX];
+};
+
+void board_dmi_read(struct board_dmi *d);
+
+/* First profile matching d; the read-only BOARD_UNKNOWN profile if none */
+const struct board_profile *board_match(const struct board_dmi *d);
+
+/* Profile by name (--board=), NULL if there is none */
+const struct board_profile *board_by_name(const char *name);
+
+/* i-th profile, NULL past the end */
+const struct board_profile *board_at(int i);
+
+#endif /* FAN_CONTROL_BOARD_H */
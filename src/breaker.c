@@ -0,0 +1,54 @@
+/*
+ * breaker.c
+ *
+ * EC circuit breaker (breaker.h):
+ *
+ *   CLOSED --BREAKER_TRIP_FAILS failures--> OPEN (backoff = min)
+ *   OPEN   --backoff elapsed-------------> PROBE (one cycle)
+ *   PROBE  --ok--> CLOSED     --failure--> OPEN (backoff doubled, capped)
+ */
+
+#include "breaker.h"
+
+void breaker_init(struct breaker *b) {
+    b->state = BREAKER_CLOSED;
+    b->event = BREAKER_EV_NONE;
+    b->fails = 0;
+    b->backoff_ms = BREAKER_BACKOFF_MIN_MS;
+    b->retry_us = 0;
+    b->trips = b->skipped = 0;
+}
+
+int breaker_allow(struct breaker *b, long long now_us) {
+    if (b->state == BREAKER_CLOSED || b->state == BREAKER_PROBE) return 1;
+    if (now_us >= b->retry_us) {
+        b->state = BREAKER_PROBE;
+        return 1;
+    }
+    b->skipped++;
+    return 0;
+}
+
+void breaker_result(struct breaker *b, int ok, long long now_us) {
+    b->event = BREAKER_EV_NONE;
+    if (ok) {
+        if (b->state != BREAKER_CLOSED) b->event = BREAKER_EV_RESET;
+        b->state = BREAKER_CLOSED;
+        b->fails = 0;
+        b->backoff_ms = BREAKER_BACKOFF_MIN_MS;
+        return;
+    }
+
+    b->fails++;
+    if (b->state == BREAKER_PROBE) {
+        b->backoff_ms = (b->backoff_ms * 2 < BREAKER_BACKOFF_MAX_MS) ? b->backoff_ms * 2 : BREAKER_BACKOFF_MAX_MS;
+    } else if (b->fails >= BREAKER_TRIP_FAILS) {
+        b->trips++;
+        b->event = BREAKER_EV_TRIP;
+        b->backoff_ms = BREAKER_BACKOFF_MIN_MS;
+    } else {
+        return;
+    }
+    b->state = BREAKER_OPEN;
+    b->retry_us = now_us + (long long)b->backoff_ms * 1000;
+}
@@ -0,0 +1,39 @@
+/*
+ * breaker.h
+ *
+ * Circuit breaker around the EC: after BREAKER_TRIP_FAILS failed cycles in
+ * a row the loop stops talking to the EC, the fans are left at a safe high
+ * duty, and a single probe cycle is let through after a backoff that
+ * doubles on every failed probe. A good cycle closes it again.
+ */
+
+#ifndef FAN_CONTROL_BREAKER_H
+#define FAN_CONTROL_BREAKER_H
+
+#define BREAKER_TRIP_FAILS       3        /* consecutive failed cycles */
+#define BREAKER_BACKOFF_MIN_MS   1000
+#define BREAKER_BACKOFF_MAX_MS   60000
+#define BREAKER_DEFAULT_SAFE_DUTY 100     /* % while open (config ec_safe_duty) */
+
+enum { BREAKER_CLOSED, BREAKER_OPEN, BREAKER_PROBE };
+enum { BREAKER_EV_NONE, BREAKER_EV_TRIP, BREAKER_EV_RESET };   /* latest breaker_result() */
+
+struct breaker {
+    int       state;          /* BREAKER_* */
+    int       event;
+    int       fails;          /* consecutive failed cycles */
+    int       backoff_ms;
+    long long retry_us;       /* open: next probe */
+    unsigned long trips;
+    unsigned long skipped;    /* cycles without EC access while open */
+};
+
+void breaker_init(struct breaker *b);
+
+/* 1 if this cycle may use the EC (closed, or the probe is due) */
+int  breaker_allow(struct breaker *b, long long now_us);
+
+/* Outcome of a cycle that was allowed */
+void breaker_result(struct breaker *b, int ok, long long now_us);
+
+#endif /* FAN_CONTROL_BREAKER_H */
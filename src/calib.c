@@ -0,0 +1,125 @@
+/*
+ * calib.c
+ *
+ * Calibration file format, like the config file ("key = value", '#'
+ * comments):
+ *   stamp = 1760000000
+ *   fan1.rpm = 0 0 1150 1620 2050 2480 2890 3270 3640 4010 4380
+ *   fan1.start = 18
+ *   fan1.stall = 12
+ *   fan2.rpm = ...
+ */
+
+#include "calib.h"
+#include "util.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int calib_load(const char *path, struct calib *c) {
+    memset(c, 0, sizeof(*c));
+    FILE *f = fopen(path, "re");
+    if (!f) return -1;
+
+    char line[512];
+    int have[2] = { 0, 0 };
+    while (fgets(line, sizeof(line), f)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        char key[32];
+        int off = 0;
+        if (sscanf(line, " %31[^= \t] = %n", key, &off) != 1 || off == 0) continue;
+        const char *val = line + off;
+
+        if (strcmp(key, "stamp") == 0) { c->stamp = atoll(val); continue; }
+        if (strncmp(key, "fan", 3) != 0 || (key[3] != '1' && key[3] != '2') || key[4] != '.') continue;
+        struct fan_calib *fc = &c->fan[key[3] - '1'];
+        const char *what = key + 5;
+        if (strcmp(what, "rpm") == 0) {
+            char *p = (char *)val, *end;
+            int n = 0;
+            for (; n < CALIB_POINTS; n++) {
+                long v = strtol(p, &end, 10);
+                if (end == p || v < 0 || v > 65535) break;
+                fc->rpm[n] = (int)v;
+                p = end;
+            }
+            if (n == CALIB_POINTS) have[key[3] - '1'] = 1;
+        } else if (strcmp(what, "start") == 0) {
+            fc->start_pct = clamp(atoi(val), 0, 100);
+        } else if (strcmp(what, "stall") == 0) {
+            fc->stall_pct = clamp(atoi(val), 0, 100);
+        }
+    }
+    fclose(f);
+    for (int i = 0; i < 2; i++) c->fan[i].valid = have[i] && calib_max_rpm(&c->fan[i]) > 0;
+    return 0;
+}
+
+int calib_save(const char *path, const struct calib *c) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "we");
+    if (!f) return -1;
+    fprintf(f, "# fan-cli calibrate: settled RPM at 0, %d, ..., 100%% duty\n", CALIB_STEP_PCT);
+    fprintf(f, "stamp = %lld\n", c->stamp);
+    for (int i = 0; i < 2; i++) {
+        const struct fan_calib *fc = &c->fan[i];
+        if (!fc->valid) continue;
+        fprintf(f, "fan%d.rpm =", i + 1);
+        for (int k = 0; k < CALIB_POINTS; k++) fprintf(f, " %d", fc->rpm[k]);
+        fprintf(f, "\nfan%d.start = %d\nfan%d.stall = %d\n", i + 1, fc->start_pct, i + 1, fc->stall_pct);
+    }
+    int rc = (fclose(f) == 0) ? 0 : -1;
+    if (rc == 0 && rename(tmp, path) != 0) rc = -1;   /* whole file or the old one */
+    if (rc != 0) { int e = errno; remove(tmp); errno = e; }
+    return rc;
+}
+
+/* Non-decreasing envelope: measurement noise must not make the inverse ambiguous */
+static int env_rpm(const struct fan_calib *f, int i) {
+    int v = 0;
+    for (int k = 0; k <= i; k++) if (f->rpm[k] > v) v = f->rpm[k];
+    return v;
+}
+
+int calib_rpm_for_duty(const struct fan_calib *f, double duty_pct) {
+    if (duty_pct <= 0) return 0;
+    if (duty_pct >= 100) return env_rpm(f, CALIB_POINTS - 1);
+    int i = (int)(duty_pct / CALIB_STEP_PCT);
+    double frac = (duty_pct - i * CALIB_STEP_PCT) / CALIB_STEP_PCT;
+    int a = env_rpm(f, i), b = env_rpm(f, i + 1);
+    return (int)(a + (b - a) * frac + 0.5);
+}
+
+double calib_duty_for_rpm(const struct fan_calib *f, double rpm) {
+    if (rpm <= 0) return 0;
+    for (int i = 1; i < CALIB_POINTS; i++) {
+        int a = env_rpm(f, i - 1), b = env_rpm(f, i);
+        if (rpm <= b) {
+            double frac = (b > a) ? (rpm - a) / (b - a) : 1.0;
+            return (i - 1 + frac) * CALIB_STEP_PCT;
+        }
+    }
+    return 100;
+}
+
+int calib_duty(const struct fan_calib *f, int airflow_pct, double trim, int running) {
+    if (airflow_pct <= 0) return 0;
+    double duty = calib_duty_for_rpm(f, airflow_pct / 100.0 * calib_max_rpm(f)) + trim;
+    int floor = running ? f->stall_pct : f->start_pct;
+    if (floor > 0) floor += CALIB_START_MARGIN;
+    if (duty < floor) duty = floor;
+    return clamp((int)(duty + 0.5), 0, 100);
+}
+
+void calib_trim_update(const struct fan_calib *f, double *trim, int airflow_pct, int rpm, double dt_s) {
+    int max = calib_max_rpm(f);
+    if (airflow_pct <= 0 || airflow_pct >= 100 || max <= 0 || dt_s <= 0) return;   /* nothing to correct */
+    double err = (airflow_pct / 100.0 * max - rpm) / max;
+    *trim += CALIB_TRIM_RATE * err * dt_s;
+    if (*trim > CALIB_TRIM_MAX)  *trim = CALIB_TRIM_MAX;
+    if (*trim < -CALIB_TRIM_MAX) *trim = -CALIB_TRIM_MAX;
+}
@@ -0,0 +1,57 @@
+/*
+ * calib.h
+ *
+ * Per-fan duty -> RPM calibration, measured by "fan-cli calibrate": RPM at
+ * every CALIB_STEP_PCT of duty, plus the duty a stopped fan starts at and
+ * the duty a running fan stalls below. With fan_target = rpm, auto mode
+ * turns the controller's output into airflow (% of the calibrated maximum
+ * RPM), looks up the duty for it and slowly trims that duty against the
+ * measured RPM, which absorbs fan wear and dust.
+ */
+
+#ifndef FAN_CONTROL_CALIB_H
+#define FAN_CONTROL_CALIB_H
+
+#ifndef CALIB_PATH
+#define CALIB_PATH           "/var/lib/fan-control/calibration"
+#endif
+
+#define CALIB_STEP_PCT       10
+#define CALIB_POINTS         (100 / CALIB_STEP_PCT + 1)   /* 0, 10, ..., 100 % */
+#define CALIB_START_MARGIN   2      /* % above the measured thresholds */
+
+/* RPM mode trim (wear/dust correction) */
+#define CALIB_TRIM_RATE      1.0    /* duty %/s at 100% RPM error (10% off: 6%/min) */
+#define CALIB_TRIM_MAX       25.0   /* |trim| cap, duty % */
+#define CALIB_TRIM_SETTLE_MS 5000   /* only trim a fan whose duty held this long */
+
+struct fan_calib {
+    int valid;
+    int rpm[CALIB_POINTS];   /* settled RPM at i * CALIB_STEP_PCT duty */
+    int start_pct;           /* lowest duty that starts a stopped fan */
+    int stall_pct;           /* lowest duty that keeps a running fan turning */
+};
+
+struct calib {
+    struct fan_calib fan[2];
+    long long stamp;         /* unix time of the measurement */
+};
+
+/* 0 on success; a missing file leaves both fans invalid and returns -1/ENOENT */
+int  calib_load(const char *path, struct calib *c);
+int  calib_save(const char *path, const struct calib *c);
+
+static inline int calib_max_rpm(const struct fan_calib *f) { return f->rpm[CALIB_POINTS - 1]; }
+
+/* Interpolated RPM at a duty, and the duty for an RPM (monotone envelope of the table) */
+int  calib_rpm_for_duty(const struct fan_calib *f, double duty_pct);
+double calib_duty_for_rpm(const struct fan_calib *f, double rpm);
+
+/* RPM mode, one fan: airflow % (0 = off) -> duty, honouring start/stall and
+   the trim. running: the fan turns now (RPM > 0) */
+int  calib_duty(const struct fan_calib *f, int airflow_pct, double trim, int running);
+
+/* Slow integral trim toward the target RPM; call once per cycle */
+void calib_trim_update(const struct fan_calib *f, double *trim, int airflow_pct, int rpm, double dt_s);
+
+#endif /* FAN_CONTROL_CALIB_H */
@@ -0,0 +1,517 @@
+/*
+ * config.c
+ *
+ * Config file parser. Keys:
+ *   curve  = 40:20 60:45 80:100   temp:duty points for both fans
+ *   curve1 = ... / curve2 = ...   per fan (override "curve")
+ *   deadband = 2                  °C of hysteresis around the first point
+ *   min_duty = 20                 floor for a running fan
+ *   step = 2                      max % change per cycle (not per second:
+ *                                 faster ramps while the sampler runs fast)
+ *   max_temp = 80                 100% at/above this, immediately
+ *   min_interval = 200            sampler bounds (ms): min 10..1000, max 1000..600000,
+ *   max_interval = 5000           so min <= the 1 s base period <= max
+ *   ec_deadline_us = 100000       per-handshake EC timeout
+ *   ec_budget_us = 150000         EC time per control cycle, all transactions
+ *   ec_safe_duty = 100            duty while the EC keeps failing (circuit breaker)
+ *   controller = curve            or pid: hold the hotter temp at pid_setpoint
+ *   independent = 0               1: fan1 follows CPU, fan2 GPU (temp and load)
+ *   coupling = 0.25               independent mode: share of the other side's excess
+ *   pid_setpoint = 65             °C
+ *   pid_kp / pid_ki / pid_kd      gains (%/°C, %/°C·s, %/(°C/s))
+ *   pid_d_tau = 2                 derivative filter time constant, s
+ *   pid_rate_up / pid_rate_down   slew limits, %/s
+ *   ff_weight = 1                 load feed-forward (0: off)
+ *   ff_threshold = 40             sustained load % where it starts
+ *   ff_max_duty = 60              duty at 100% load
+ *   ff_tau = 3                    "sustained": averaging time constant, s
+ *   throttle_boost = 10           % added per cycle with new CPU throttle events (0: off)
+ *   throttle_max = 40             boost cap, %
+ *   throttle_decay = 1            boost decay without events, %/s
+ *   temp_oversample = 3           CPU temp reads per cycle, median (1..7)
+ *   temp_filter = euro            across cycles: none / ema / euro (one-euro)
+ *   temp_ema_tau = 2              ema time constant, s
+ *   temp_euro_cutoff = 0.1        euro: cutoff at rest (Hz) ...
+ *   temp_euro_beta = 0.2          ... plus this per °C/s
+ *   temp_max_jump = 20            bigger one-cycle jumps need 3 cycles to count (°C, 0: off)
+ *   spinup_duty = 60              a stopped fan starts at this for spinup_ms (0: no kick)
+ *   spinup_ms = 1500
+ *   stall_timeout = 4000          0 RPM this long at duty > 0 is a stall: kick again (ms, 0: off)
+ *   profile = auto                normal / idle; auto: idle while on battery
+ *   idle_min_interval = 1000      idle profile sampler bounds (ms, same ranges)
+ *   idle_max_interval = 10000
+ *   idle_align = 1000             idle wakeups on multiples of this (ms)
+ *   idle_timer_slack_us = 50000   idle PR_SET_TIMER_SLACK
+ *   log_level = info              error / warn / info / debug (every duty change)
+ *   log_format = human            kv: key=value lines, json: one object per line
+ *   log_summary = 300             seconds between summary events (0: off)
+ *   record = 1                    trace every cycle to REC_DIR (0: off)
+ *   record_files = 4              rotating trace files ...
+ *   record_file_mb = 16           ... of this size each
+ *   gpu_interval = 500            GPU sampling thread period (ms)
+ *   gpu_stale = 3000              older GPU samples are replaced by the EC's (ms)
+ *   fan_target = duty             rpm: curve/PID output is airflow, % of the calibrated
+ *                                 max RPM, held by duty lookup and trim (calib.h)
+ *   zone.NAME = amdgpu/edge amdgpu/junction-10 ...
+ *                                 a zone: sensor globs with @weight / +-offset (zone.h)
+ *   zone.NAME.agg = max           or avg (weighted) / pNN (percentile, p90)
+ *   zone.NAME.fans = both         1, 2 or both: fans that follow this zone
+ *   zone.NAME.curve = 45:25 ...   its curve (default: each fan's own)
+ * '#' starts a comment. Curves are compiled into lookup tables here, once
+ * per load; the daemon reloads through config_watch() and swaps the whole
+ * struct between cycles.
+ */
+
+#include "breaker.h"
+#include "config.h"
+#include "ec.h"
+#include "gpumon.h"
+#include "log.h"
+#include "rec.h"
+#include "sampler.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define CONFIG_LINE_MAX  512
+#define CONFIG_DIR_MAX   256
+
+static const char *base_name(const char *path);
+static char *trim(char *s);
+static int   parse_int(const char *v, long lo, long hi, long *out, char *why, size_t whylen);
+static int   parse_double(const char *v, double lo, double hi, double *out, char *why, size_t whylen);
+static int   parse_zone(struct config *cfg, const char *key, const char *val, char *why, size_t whylen);
+
+void config_defaults(struct config *cfg) {
+    char err[64];
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->deadband_c      = CONFIG_DEFAULT_DEADBAND;
+    cfg->min_duty_pct    = CONFIG_DEFAULT_MIN_DUTY;
+    cfg->step_pct        = CONFIG_DEFAULT_STEP;
+    cfg->max_temp_c      = CONFIG_DEFAULT_MAX_TEMP;
+    cfg->min_interval_ms = SAMPLER_MIN_MS;
+    cfg->max_interval_ms = SAMPLER_MAX_MS;
+    cfg->ec_budget_us    = EC_CYCLE_BUDGET_US;
+    cfg->ec_safe_duty    = BREAKER_DEFAULT_SAFE_DUTY;
+    cfg->controller      = CONTROLLER_CURVE;
+    cfg->coupling        = CONFIG_DEFAULT_COUPLING;
+    cfg->profile         = PROFILE_AUTO;
+    cfg->idle_min_interval_ms = CONFIG_DEFAULT_IDLE_MIN_MS;
+    cfg->idle_max_interval_ms = CONFIG_DEFAULT_IDLE_MAX_MS;
+    cfg->idle_align_ms        = CONFIG_DEFAULT_IDLE_ALIGN_MS;
+    cfg->idle_timer_slack_us  = CONFIG_DEFAULT_IDLE_SLACK_US;
+    cfg->log_level       = LOG_INFO;
+    cfg->log_format      = LOG_FMT_HUMAN;
+    cfg->log_summary_s   = CONFIG_DEFAULT_LOG_SUMMARY_S;
+    cfg->record          = 1;
+    cfg->record_files    = REC_DEFAULT_FILES;
+    cfg->record_file_mb  = REC_DEFAULT_FILE_MB;
+    cfg->gpu_interval_ms = GPUMON_DEFAULT_PERIOD_MS;
+    cfg->gpu_stale_ms    = GPUMON_DEFAULT_STALE_MS;
+    cfg->pid.setpoint_c  = PID_DEFAULT_SETPOINT_C;
+    cfg->pid.kp          = PID_DEFAULT_KP;
+    cfg->pid.ki          = PID_DEFAULT_KI;
+    cfg->pid.kd          = PID_DEFAULT_KD;
+    cfg->pid.d_tau_s     = PID_DEFAULT_D_TAU_S;
+    cfg->pid.rate_up     = PID_DEFAULT_RATE_UP;
+    cfg->pid.rate_down   = PID_DEFAULT_RATE_DOWN;
+    cfg->ff.weight       = FF_DEFAULT_WEIGHT;
+    cfg->ff.threshold_pct = FF_DEFAULT_THRESHOLD;
+    cfg->ff.max_duty_pct = FF_DEFAULT_MAX_DUTY;
+    cfg->ff.tau_s        = FF_DEFAULT_TAU_S;
+    cfg->throttle.boost_pct   = THROTTLE_DEFAULT_BOOST;
+    cfg->throttle.max_pct     = THROTTLE_DEFAULT_MAX;
+    cfg->throttle.decay_pct_s = THROTTLE_DEFAULT_DECAY;
+    cfg->filter.kind          = FILTER_EURO;
+    cfg->filter.oversample    = FILTER_DEFAULT_OVERSAMPLE;
+    cfg->filter.ema_tau_s     = FILTER_DEFAULT_EMA_TAU_S;
+    cfg->filter.euro_cutoff_hz = FILTER_DEFAULT_EURO_CUTOFF;
+    cfg->filter.euro_beta     = FILTER_DEFAULT_EURO_BETA;
+    cfg->filter.max_jump_c    = FILTER_DEFAULT_MAX_JUMP;
+    cfg->spin.kick_pct        = SPIN_DEFAULT_KICK_PCT;
+    cfg->spin.kick_ms         = SPIN_DEFAULT_KICK_MS;
+    cfg->spin.stall_ms        = SPIN_DEFAULT_STALL_MS;
+    for (int f = 0; f < 2; f++) {
+        curve_parse(&cfg->curve[f], CONFIG_DEFAULT_CURVE, err, sizeof(err));
+        curve_compile(&cfg->curve[f], cfg->deadband_c, cfg->min_duty_pct, cfg->max_temp_c);
+    }
+}
+
+int config_controller(const char *name) {
+    if (strcmp(name, "curve") == 0) return CONTROLLER_CURVE;
+    if (strcmp(name, "pid") == 0)   return CONTROLLER_PID;
+    return -1;
+}
+
+int config_profile(const char *name) {
+    if (strcmp(name, "auto") == 0)   return PROFILE_AUTO;
+    if (strcmp(name, "normal") == 0) return PROFILE_NORMAL;
+    if (strcmp(name, "idle") == 0)   return PROFILE_IDLE;
+    return -1;
+}
+
+int config_temp_filter(const char *name) {
+    if (strcmp(name, "none") == 0) return FILTER_NONE;
+    if (strcmp(name, "ema") == 0)  return FILTER_EMA;
+    if (strcmp(name, "euro") == 0) return FILTER_EURO;
+    return -1;
+}
+
+int config_fan_target(const char *name) {
+    if (strcmp(name, "duty") == 0) return FAN_TARGET_DUTY;
+    if (strcmp(name, "rpm") == 0)  return FAN_TARGET_RPM;
+    return -1;
+}
+
+int config_load(const char *path, int optional, struct config *cfg, char *err, size_t errlen) {
+    config_defaults(cfg);
+
+    FILE *f = fopen(path, "re");
+    if (!f) {
+        if (optional && errno == ENOENT) return 0;
+        snprintf(err, errlen, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    /* Points are parsed as they come; compiling waits for deadband/min_duty/max_temp */
+    struct fan_curve both, fan[2];
+    int have_both = 0, have_fan[2] = { 0, 0 };
+
+    char line[CONFIG_LINE_MAX], why[128];
+    int lineno = 0, rc = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        char *key = trim(line);
+        if (!*key) continue;
+
+        char *eq = strchr(key, '=');
+        if (!eq) { snprintf(why, sizeof(why), "expected key = value"); rc = -1; break; }
+        *eq = 0;
+        char *val = trim(eq + 1);
+        key = trim(key);
+
+        long v = 0;
+        if (strcmp(key, "curve") == 0 || strcmp(key, "curve1") == 0 || strcmp(key, "curve2") == 0) {
+            struct fan_curve *c = (key[5] == '1') ? &fan[0] : (key[5] == '2') ? &fan[1] : &both;
+            if (curve_parse(c, val, why, sizeof(why)) != 0) { rc = -1; break; }
+            if (c == &both) have_both = 1;
+            else have_fan[c - fan] = 1;
+        } else if (strcmp(key, "deadband") == 0) {
+            if ((rc = parse_int(val, 0, 50, &v, why, sizeof(why))) != 0) break;
+            cfg->deadband_c = (int)v;
+        } else if (strcmp(key, "min_duty") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->min_duty_pct = (int)v;
+        } else if (strcmp(key, "step") == 0) {
+            if ((rc = parse_int(val, 1, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->step_pct = (int)v;
+        } else if (strcmp(key, "max_temp") == 0) {
+            if ((rc = parse_int(val, 1, 255, &v, why, sizeof(why))) != 0) break;
+            cfg->max_temp_c = (int)v;
+        } else if (strcmp(key, "min_interval") == 0) {
+            if ((rc = parse_int(val, SAMPLER_FLOOR_MS, SAMPLER_BASE_MS, &v, why, sizeof(why))) != 0) break;
+            cfg->min_interval_ms = (int)v;
+        } else if (strcmp(key, "max_interval") == 0) {
+            if ((rc = parse_int(val, SAMPLER_BASE_MS, SAMPLER_CEIL_MS, &v, why, sizeof(why))) != 0) break;
+            cfg->max_interval_ms = (int)v;
+        } else if (strcmp(key, "ec_deadline_us") == 0) {
+            if ((rc = parse_int(val, 1000, 10000000, &v, why, sizeof(why))) != 0) break;
+            cfg->ec_deadline_us = v;
+        } else if (strcmp(key, "ec_budget_us") == 0) {
+            if ((rc = parse_int(val, 1000, 10000000, &v, why, sizeof(why))) != 0) break;
+            cfg->ec_budget_us = v;
+        } else if (strcmp(key, "ec_safe_duty") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->ec_safe_duty = (int)v;
+        } else if (strcmp(key, "controller") == 0) {
+            if ((cfg->controller = config_controller(val)) < 0) {
+                snprintf(why, sizeof(why), "controller must be curve or pid");
+                rc = -1;
+                break;
+            }
+        } else if (strcmp(key, "independent") == 0) {
+            if ((rc = parse_int(val, 0, 1, &v, why, sizeof(why))) != 0) break;
+            cfg->independent = (int)v;
+        } else if (strcmp(key, "coupling") == 0) {
+            if ((rc = parse_double(val, 0, 1, &cfg->coupling, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_setpoint") == 0) {
+            if ((rc = parse_double(val, 20, 110, &cfg->pid.setpoint_c, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_kp") == 0) {
+            if ((rc = parse_double(val, 0, 100, &cfg->pid.kp, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_ki") == 0) {
+            if ((rc = parse_double(val, 0, 100, &cfg->pid.ki, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_kd") == 0) {
+            if ((rc = parse_double(val, 0, 1000, &cfg->pid.kd, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_d_tau") == 0) {
+            if ((rc = parse_double(val, 0, 60, &cfg->pid.d_tau_s, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_rate_up") == 0) {
+            if ((rc = parse_double(val, 0.1, 1000, &cfg->pid.rate_up, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "pid_rate_down") == 0) {
+            if ((rc = parse_double(val, 0.1, 1000, &cfg->pid.rate_down, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "ff_weight") == 0) {
+            if ((rc = parse_double(val, 0, 1, &cfg->ff.weight, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "ff_threshold") == 0) {
+            if ((rc = parse_int(val, 0, 99, &v, why, sizeof(why))) != 0) break;
+            cfg->ff.threshold_pct = (int)v;
+        } else if (strcmp(key, "ff_max_duty") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->ff.max_duty_pct = (int)v;
+        } else if (strcmp(key, "ff_tau") == 0) {
+            if ((rc = parse_double(val, 0, 60, &cfg->ff.tau_s, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "throttle_boost") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->throttle.boost_pct = (int)v;
+        } else if (strcmp(key, "throttle_max") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->throttle.max_pct = (int)v;
+        } else if (strcmp(key, "throttle_decay") == 0) {
+            if ((rc = parse_double(val, 0.01, 100, &cfg->throttle.decay_pct_s, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "temp_oversample") == 0) {
+            if ((rc = parse_int(val, 1, FILTER_MAX_SAMPLES, &v, why, sizeof(why))) != 0) break;
+            cfg->filter.oversample = (int)v;
+        } else if (strcmp(key, "temp_filter") == 0) {
+            if ((cfg->filter.kind = config_temp_filter(val)) < 0) {
+                snprintf(why, sizeof(why), "temp_filter must be none, ema or euro");
+                rc = -1;
+                break;
+            }
+        } else if (strcmp(key, "temp_ema_tau") == 0) {
+            if ((rc = parse_double(val, 0.1, 60, &cfg->filter.ema_tau_s, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "temp_euro_cutoff") == 0) {
+            if ((rc = parse_double(val, 0.01, 10, &cfg->filter.euro_cutoff_hz, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "temp_euro_beta") == 0) {
+            if ((rc = parse_double(val, 0, 10, &cfg->filter.euro_beta, why, sizeof(why))) != 0) break;
+        } else if (strcmp(key, "temp_max_jump") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->filter.max_jump_c = (int)v;
+        } else if (strcmp(key, "spinup_duty") == 0) {
+            if ((rc = parse_int(val, 0, 100, &v, why, sizeof(why))) != 0) break;
+            cfg->spin.kick_pct = (int)v;
+        } else if (strcmp(key, "spinup_ms") == 0) {
+            if ((rc = parse_int(val, 100, 10000, &v, why, sizeof(why))) != 0) break;
+            cfg->spin.kick_ms = (int)v;
+        } else if (strcmp(key, "stall_timeout") == 0) {
+            if ((rc = parse_int(val, 0, 60000, &v, why, sizeof(why))) != 0) break;
+            cfg->spin.stall_ms = (int)v;
+        } else if (strcmp(key, "profile") == 0) {
+            if ((cfg->profile = config_profile(val)) < 0) {
+                snprintf(why, sizeof(why), "profile must be auto, normal or idle");
+                rc = -1;
+                break;
+            }
+        } else if (strcmp(key, "idle_min_interval") == 0) {
+            if ((rc = parse_int(val, SAMPLER_FLOOR_MS, SAMPLER_BASE_MS, &v, why, sizeof(why))) != 0) break;
+            cfg->idle_min_interval_ms = (int)v;
+        } else if (strcmp(key, "idle_max_interval") == 0) {
+            if ((rc = parse_int(val, SAMPLER_BASE_MS, SAMPLER_CEIL_MS, &v, why, sizeof(why))) != 0) break;
+            cfg->idle_max_interval_ms = (int)v;
+        } else if (strcmp(key, "idle_align") == 0) {
+            if ((rc = parse_int(val, 0, 60000, &v, why, sizeof(why))) != 0) break;
+            cfg->idle_align_ms = (int)v;
+        } else if (strcmp(key, "idle_timer_slack_us") == 0) {
+            if ((rc = parse_int(val, 0, 1000000, &v, why, sizeof(why))) != 0) break;
+            cfg->idle_timer_slack_us = v;
+        } else if (strcmp(key, "log_level") == 0) {
+            if ((cfg->log_level = log_level_from_name(val)) < 0) {
+                snprintf(why, sizeof(why), "log_level must be error, warn, info or debug");
+                rc = -1;
+                break;
+            }
+        } else if (strcmp(key, "log_format") == 0) {
+            if ((cfg->log_format = log_format_from_name(val)) < 0) {
+                snprintf(why, sizeof(why), "log_format must be human, kv or json");
+                rc = -1;
+                break;
+            }
+        } else if (strcmp(key, "log_summary") == 0) {
+            if ((rc = parse_int(val, 0, 86400, &v, why, sizeof(why))) != 0) break;
+            cfg->log_summary_s = (int)v;
+        } else if (strcmp(key, "record") == 0) {
+            if ((rc = parse_int(val, 0, 1, &v, why, sizeof(why))) != 0) break;
+            cfg->record = (int)v;
+        } else if (strcmp(key, "record_files") == 0) {
+            if ((rc = parse_int(val, 1, REC_MAX_FILES, &v, why, sizeof(why))) != 0) break;
+            cfg->record_files = (int)v;
+        } else if (strcmp(key, "record_file_mb") == 0) {
+            if ((rc = parse_int(val, 1, 4096, &v, why, sizeof(why))) != 0) break;
+            cfg->record_file_mb = (int)v;
+        } else if (strcmp(key, "gpu_interval") == 0) {
+            if ((rc = parse_int(val, 50, 60000, &v, why, sizeof(why))) != 0) break;
+            cfg->gpu_interval_ms = (int)v;
+        } else if (strcmp(key, "gpu_stale") == 0) {
+            if ((rc = parse_int(val, 100, 600000, &v, why, sizeof(why))) != 0) break;
+            cfg->gpu_stale_ms = (int)v;
+        } else if (strcmp(key, "fan_target") == 0) {
+            if ((cfg->fan_target = config_fan_target(val)) < 0) {
+                snprintf(why, sizeof(why), "fan_target must be duty or rpm");
+                rc = -1;
+                break;
+            }
+        } else if (strncmp(key, "zone.", 5) == 0) {
+            if ((rc = parse_zone(cfg, key + 5, val, why, sizeof(why))) != 0) break;
+        } else {
+            snprintf(why, sizeof(why), "unknown key '%s'", key);
+            rc = -1;
+            break;
+        }
+    }
+    if (rc == 0 && ferror(f)) { snprintf(why, sizeof(why), "%s", strerror(errno)); rc = -1; }
+    fclose(f);
+
+    if (rc != 0) {
+        snprintf(err, errlen, "%s:%d: %s", path, lineno, why);
+        config_defaults(cfg);
+        return -1;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (have_fan[i])     cfg->curve[i] = fan[i];
+        else if (have_both)  cfg->curve[i] = both;
+        curve_compile(&cfg->curve[i], cfg->deadband_c, cfg->min_duty_pct, cfg->max_temp_c);
+    }
+    for (int z = 0; z < cfg->nzones; z++) {
+        struct zone *zn = &cfg->zone[z];
+        if (zn->nterms == 0) {
+            snprintf(err, errlen, "%s: zone %s has no sensors", path, zn->name);
+            config_defaults(cfg);
+            return -1;
+        }
+        if (zn->have_curve) curve_compile(&zn->curve, cfg->deadband_c, cfg->min_duty_pct, cfg->max_temp_c);
+    }
+    return 0;
+}
+
+int config_bind_zones(struct config *cfg) {
+    int empty = 0;
+    sensor_unuse_all();
+    for (int z = 0; z < cfg->nzones; z++) empty += zone_bind(&cfg->zone[z]) == 0;
+    return empty;
+}
+
+/* "NAME", "NAME.agg", "NAME.fans" or "NAME.curve"; a new NAME adds a zone */
+static int parse_zone(struct config *cfg, const char *key, const char *val, char *why, size_t whylen) {
+    const char *dot = strchr(key, '.');
+    size_t len = dot ? (size_t)(dot - key) : strlen(key);
+    const char *what = dot ? dot + 1 : "";
+    if (len == 0 || len >= ZONE_NAME_MAX) {
+        snprintf(why, whylen, "zone name must be 1..%d characters", ZONE_NAME_MAX - 1);
+        return -1;
+    }
+
+    struct zone *z = NULL;
+    for (int i = 0; i < cfg->nzones && !z; i++) {
+        if (strncmp(cfg->zone[i].name, key, len) == 0 && cfg->zone[i].name[len] == 0) z = &cfg->zone[i];
+    }
+    if (!z) {
+        if (cfg->nzones >= ZONE_MAX) { snprintf(why, whylen, "more than %d zones", ZONE_MAX); return -1; }
+        z = &cfg->zone[cfg->nzones++];
+        memset(z, 0, sizeof(*z));
+        memcpy(z->name, key, len);
+        z->agg = ZONE_AGG_MAX;
+        z->fans = 3;
+    }
+
+    if (*what == 0) return zone_parse_terms(z, val, why, whylen);
+    if (strcmp(what, "agg") == 0) {
+        if (zone_parse_agg(z, val) == 0) return 0;
+        snprintf(why, whylen, "zone agg must be max, avg or p1..p99");
+        return -1;
+    }
+    if (strcmp(what, "fans") == 0) {
+        z->fans = strcmp(val, "1") == 0 ? 1 : strcmp(val, "2") == 0 ? 2 : strcmp(val, "both") == 0 ? 3 : 0;
+        if (z->fans) return 0;
+        snprintf(why, whylen, "zone fans must be 1, 2 or both");
+        return -1;
+    }
+    if (strcmp(what, "curve") == 0) {
+        z->have_curve = 1;
+        return curve_parse(&z->curve, val, why, whylen);
+    }
+    snprintf(why, whylen, "unknown key 'zone.%s'", key);
+    return -1;
+}
+
+/* ---------------------- Hot reload ---------------------- */
+
+int config_watch(const char *path) {
+    char dir[CONFIG_DIR_MAX];
+    const char *base = base_name(path);
+    size_t n = (size_t)(base - path);
+    if (n == 0) snprintf(dir, sizeof(dir), ".");
+    else if (n >= sizeof(dir)) return -1;
+    else { memcpy(dir, path, n); dir[n] = 0; }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+    /* Not IN_DELETE/IN_MOVED_FROM: editors move the old file away before
+       writing the new one, and a removed file just keeps the current settings */
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) { close(fd); return -1; }
+    return fd;
+}
+
+int config_changed(int wfd, const char *path) {
+    if (wfd < 0) return 0;
+
+    const char *base = base_name(path);
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    for (;;) {
+        ssize_t n = read(wfd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW) changed = 1;       /* lost events: assume it changed */
+            else if (ev->len && strcmp(ev->name, base) == 0) changed = 1;
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+    return changed;
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+/* In-place whitespace trim */
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = 0;
+    return s;
+}
+
+/* 0 on success, -1 if not an integer within lo..hi */
+static int parse_int(const char *v, long lo, long hi, long *out, char *why, size_t whylen) {
+    char *end;
+    errno = 0;
+    long n = strtol(v, &end, 10);
+    if (errno || end == v || *end || n < lo || n > hi) {
+        snprintf(why, whylen, "'%s': expected an integer in %ld..%ld", v, lo, hi);
+        return -1;
+    }
+    *out = n;
+    return 0;
+}
+
+/* Same for floating point values */
+static int parse_double(const char *v, double lo, double hi, double *out, char *why, size_t whylen) {
+    char *end;
+    errno = 0;
+    double d = strtod(v, &end);
+    if (errno || end == v || *end || d < lo || d > hi) {
+        snprintf(why, whylen, "'%s': expected a number in %g..%g", v, lo, hi);
+        return -1;
+    }
+    *out = d;
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * config.h
+ *
+ * /etc/fan-control.conf: fan curves and loop tuning, "key = value" per line.
+ */
+
+#ifndef FAN_CONTROL_CONFIG_H
+#define FAN_CONTROL_CONFIG_H
+
+#include <stddef.h>
+
+#include "curve.h"
+#include "filter.h"
+#include "load.h"
+#include "pid.h"
+#include "spin.h"
+#include "throttle.h"
+#include "zone.h"
+
+#ifndef CONFIG_PATH
+#define CONFIG_PATH              "/etc/fan-control.conf"
+#endif
+
+/* Defaults: the built-in curve used when there is no config file */
+#define CONFIG_DEFAULT_CURVE     "40:20 80:100"
+#define CONFIG_DEFAULT_DEADBAND  2     /* hysteresis around the first curve point */
+#define CONFIG_DEFAULT_MIN_DUTY  20    /* anything below 16% and the fan will not start sometimes */
+#define CONFIG_DEFAULT_STEP      2     /* max % change per cycle for smoothing */
+#define CONFIG_DEFAULT_MAX_TEMP  80    /* 100% at/above this, no smoothing */
+#define CONFIG_DEFAULT_COUPLING  0.25  /* independent mode: share of the other side's excess */
+
+/* Idle profile (battery) */
+#define CONFIG_DEFAULT_IDLE_MIN_MS   1000    /* slowest "fast" period */
+#define CONFIG_DEFAULT_IDLE_MAX_MS   10000
+#define CONFIG_DEFAULT_IDLE_ALIGN_MS 1000    /* wake on whole seconds */
+#define CONFIG_DEFAULT_IDLE_SLACK_US 50000   /* PR_SET_TIMER_SLACK */
+
+#define CONFIG_DEFAULT_LOG_SUMMARY_S 300     /* one summary event per 5 min, 0: off */
+
+enum { CONTROLLER_CURVE, CONTROLLER_PID };
+enum { PROFILE_AUTO, PROFILE_NORMAL, PROFILE_IDLE };   /* auto: idle on battery */
+enum { FAN_TARGET_DUTY, FAN_TARGET_RPM };              /* rpm: controller output is airflow (calib.h) */
+
+struct config {
+    int  controller;             /* CONTROLLER_*, --controller= wins */
+    int  independent;            /* per-fan inputs, --independent wins */
+    double coupling;             /* 0: fully independent .. 1: hotter-of */
+    struct fan_curve curve[2];   /* fan1 (CPU), fan2 (GPU), compiled */
+    struct pid_params pid;
+    struct ff_params  ff;        /* load feed-forward */
+    struct throttle_params throttle;
+    struct spin_params spin;     /* start kick, stall watch */
+    struct filter_params filter; /* temperature inputs */
+    int  deadband_c;
+    int  min_duty_pct;
+    int  step_pct;               /* per cycle: the ramp rate scales with the sample rate */
+    int  max_temp_c;
+    int  min_interval_ms;        /* sampler bounds */
+    int  max_interval_ms;
+    long ec_deadline_us;         /* 0: build default */
+    long ec_budget_us;           /* EC time per control cycle */
+    int  ec_safe_duty;           /* held while the EC breaker is open (breaker.h) */
+    int  profile;                /* PROFILE_*, --profile= wins */
+    int  idle_min_interval_ms;   /* sampler bounds in the idle profile */
+    int  idle_max_interval_ms;
+    int  idle_align_ms;
+    long idle_timer_slack_us;
+    int  log_level;              /* LOG_* (log.h) */
+    int  log_format;             /* LOG_FMT_* */
+    int  log_summary_s;          /* periodic summary event, 0: off */
+    int  record;                 /* trace recorder (rec.h) on; read at start only */
+    int  record_files;
+    int  record_file_mb;
+    int  gpu_interval_ms;        /* GPU worker period (gpumon.h) */
+    int  gpu_stale_ms;           /* older GPU samples fall back to the EC */
+    int  fan_target;             /* FAN_TARGET_* */
+    int  nzones;                 /* 0: fans follow the CPU/GPU sides */
+    struct zone zone[ZONE_MAX];  /* sensor groups, each with its curve (zone.h) */
+};
+
+void config_defaults(struct config *cfg);
+
+/* "curve" / "pid" -> CONTROLLER_*, -1 if unknown */
+int  config_controller(const char *name);
+
+/* "auto" / "normal" / "idle" -> PROFILE_*, -1 if unknown */
+int  config_profile(const char *name);
+
+/* "none" / "ema" / "euro" -> FILTER_*, -1 if unknown */
+int  config_temp_filter(const char *name);
+
+/* "duty" / "rpm" -> FAN_TARGET_*, -1 if unknown */
+int  config_fan_target(const char *name);
+
+/* Bind every zone of cfg against the sensor registry (sensor_scan() first);
+   returns the number of zones without any sensor present */
+int  config_bind_zones(struct config *cfg);
+
+/* Parse path into cfg (starting from the defaults); 0 on success.
+   A missing file is fine if optional. On error, err holds "path:line: why". */
+int  config_load(const char *path, int optional, struct config *cfg, char *err, size_t errlen);
+
+/* inotify on path's directory (catches editors that replace the file);
+   non-blocking fd, -1 if unavailable */
+int  config_watch(const char *path);
+
+/* Drain pending events: 1 if path was rewritten or renamed into place */
+int  config_changed(int wfd, const char *path);
+
+#endif /* FAN_CONTROL_CONFIG_H */
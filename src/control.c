@@ -0,0 +1,109 @@
+/*
+ * control.c
+ *
+ * Per fan: input temperature (own side plus a coupling share of the
+ * other, or the hottest of its zones), feed-forward, curve or PID,
+ * throttle boost, max_temp override.
+ */
+
+#include "control.h"
+#include "curve.h"
+#include "load.h"
+#include "util.h"
+
+#include <string.h>
+
+static inline int step_toward(int last_pct, int target_pct, int step_pct)
+{
+    int delta = target_pct - last_pct;
+    if (delta > 0)       return last_pct + (delta < step_pct ? delta : step_pct);
+    else if (delta < 0)  return last_pct - ((-delta) < step_pct ? -delta : step_pct);
+    else                 return last_pct;
+}
+
+void control_init(struct control *c, int controller, int independent, int duty1, int duty2) {
+    memset(c, 0, sizeof(*c));
+    c->controller = controller;
+    c->independent = independent;
+    c->last[0] = c->target[0] = duty1;
+    c->last[1] = c->target[1] = duty2;
+}
+
+void control_step(struct control *c, const struct config *cfg, const struct control_input *in) {
+    // Zones replace the sides: a fan in a zone with a reading sees its
+    // hottest zone, and its raw CPU/GPU temp (the GPU's may be a VRAM
+    // sensor) counts for nothing, max_temp included
+    int nz = (in->nzones < cfg->nzones) ? in->nzones : cfg->nzones;
+    int side[2] = { in->tc, in->tg }, zoned[2] = { 0, 0 };
+    for (int z = 0; z < nz; z++) {
+        if (in->zone_t[z] < 0) continue;
+        for (int f = 0; f < 2; f++) {
+            if (!(cfg->zone[z].fans & (1 << f))) continue;
+            if (!zoned[f]++ || in->zone_t[z] > side[f]) side[f] = in->zone_t[z];
+        }
+    }
+    c->th = (side[0] > side[1]) ? side[0] : side[1];  // ***only the hotter temp***
+
+    // Inputs per fan: its own side plus a share of the other side's excess.
+    // Shared mode is coupling 1, i.e. both fans see the hotter side.
+    double w = c->independent ? cfg->coupling : 1.0;
+    const double own_l[2] = { in->cpu_load, in->gpu_load };
+
+    for (int f = 0; f < 2; f++) {
+        int    dtemp = side[1 - f] - side[f];
+        double dl = own_l[1 - f] - own_l[f];
+        c->tin[f] = zoned[f] ? side[f] : side[f] + (dtemp > 0 ? (int)(w * dtemp + 0.5) : 0);
+
+        // Feed-forward: sustained load pre-spins the fan before the heat arrives
+        c->ff[f] = load_ff_duty(&cfg->ff, own_l[f] + (dl > 0 ? w * dl : 0.0), cfg->min_duty_pct);
+
+        // Zoned fan: the highest of its zones' curves is the target
+        int zduty = 0;
+        for (int z = 0; zoned[f] && z < nz; z++) {
+            const struct zone *zn = &cfg->zone[z];
+            if (!(zn->fans & (1 << f)) || in->zone_t[z] < 0) continue;
+            int d = curve_duty(zn->have_curve ? &zn->curve : &cfg->curve[f], in->zone_t[z], c->last[f]);
+            if (d > zduty) zduty = d;
+        }
+
+        int newduty;
+        if (c->controller == CONTROLLER_PID) {
+            // Setpoint tracking; rate limits and anti-windup are inside
+            newduty = pid_update(&c->pid[f], &cfg->pid, c->tin[f], c->last[f], cfg->min_duty_pct, in->now_us);
+            c->target[f] = (int)(c->pid[f].out + 0.5);
+            if (c->prime) newduty = (c->target[f] > 0 && c->target[f] < cfg->min_duty_pct) ? cfg->min_duty_pct : c->target[f];
+            if (c->ff[f] > newduty) newduty = c->target[f] = c->ff[f];   /* ff is already smoothed */
+        } else {
+            // Table lookup; hysteresis is in the table (indexed by running/stopped)
+            pid_reset(&c->pid[f]);   /* a later switch to PID starts bumpless */
+            c->target[f] = zoned[f] ? zduty : curve_duty(&cfg->curve[f], c->tin[f], c->last[f]);
+            if (c->ff[f] > c->target[f]) c->target[f] = c->ff[f];
+            // step_pct per cycle, on purpose: the sampler runs fast while
+            // temps move, so the ramp speeds up exactly then (README)
+            newduty = c->prime ? c->target[f] : step_toward(c->last[f], c->target[f], cfg->step_pct);
+        }
+
+        // Throttling: the CPU is losing clocks, so raise the target whatever the EC
+        // temp says and go there at once (fan2 gets the coupling share)
+        int boost = (int)(in->throttle_boost * (f == 0 ? 1.0 : w) + 0.5);
+        if (boost > 0) {
+            c->target[f] = clamp(c->target[f] + boost, 0, 100);
+            if (newduty < c->target[f]) newduty = c->target[f];
+        }
+
+        // Safety: if either side is at/above max_temp, jump straight to 100%
+        if (c->th >= cfg->max_temp_c) newduty = 100;
+        c->last[f] = clamp(newduty, 0, 100);
+    }
+    c->prime = 0;
+}
+
+int control_knee(const struct control *c, const struct config *cfg) {
+    if (c->controller == CONTROLLER_PID) return (int)cfg->pid.setpoint_c;
+    int knee = cfg->curve[0].temp[0];
+    if (cfg->curve[1].temp[0] < knee) knee = cfg->curve[1].temp[0];
+    for (int z = 0; z < cfg->nzones; z++) {
+        if (cfg->zone[z].have_curve && cfg->zone[z].curve.temp[0] < knee) knee = cfg->zone[z].curve.temp[0];
+    }
+    return knee;
+}
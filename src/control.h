@@ -0,0 +1,52 @@
+/*
+ * control.h
+ *
+ * The control decision, without any I/O: temperatures, load and throttle
+ * boost in, a duty per fan out. auto mode feeds it from the EC and sysfs,
+ * the simulator (sim.h) from a thermal model.
+ */
+
+#ifndef FAN_CONTROL_CONTROL_H
+#define FAN_CONTROL_CONTROL_H
+
+#include "config.h"
+#include "pid.h"
+
+/* One cycle's sensing */
+struct control_input {
+    int       tc, tg;             /* CPU / GPU °C */
+    double    cpu_load, gpu_load; /* sustained (EMA) utilization, % */
+    double    throttle_boost;     /* % from throttle.h, 0 = none */
+    int       nzones;             /* zone_t[] entries, 0 = no zones (CPU/GPU sides) */
+    int       zone_t[ZONE_MAX];   /* °C per cfg->zone[], -1 = no reading */
+    long long now_us;             /* CLOCK_MONOTONIC (PID timing) */
+};
+
+struct control {
+    int controller;          /* CONTROLLER_* in effect */
+    int independent;         /* per-fan inputs (else both fans see the hotter side) */
+    int th;                  /* hotter input: CPU/GPU, or the zones of zoned fans */
+    int tin[2];              /* temp each fan's controller sees */
+    int ff[2];               /* feed-forward duty per fan from sustained load */
+    int target[2];           /* curve target per fan */
+    int last[2];             /* duty after smoothing: the decision */
+    struct pid_state pid[2]; /* CONTROLLER_PID only */
+    int prime;               /* next step goes straight to the target (start, resume) */
+};
+
+/* Start from the given duties (the fans' now, or a checkpoint's) */
+void control_init(struct control *c, int controller, int independent, int duty1, int duty2);
+
+/* Decide c->last[] for this cycle */
+void control_step(struct control *c, const struct config *cfg, const struct control_input *in);
+
+/* Lower knee the sampler should watch: lowest curve start (zones' included),
+   or the PID setpoint */
+int  control_knee(const struct control *c, const struct config *cfg);
+
+/* Applied duty already equals the target on both fans */
+static inline int control_settled(const struct control *c) {
+    return c->last[0] == c->target[0] && c->last[1] == c->target[1];
+}
+
+#endif /* FAN_CONTROL_CONTROL_H */
@@ -0,0 +1,214 @@
+/*
+ * ctl.c
+ *
+ * Unix-domain control socket (SOCK_STREAM, one request per connection).
+ * Everyone may read ("dump"); changing duties needs a root peer (SO_PEERCRED).
+ */
+
+#define _GNU_SOURCE   /* struct ucred, accept4 */
+
+#include "ctl.h"
+#include "util.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int  ctl_addr(struct sockaddr_un *sa);
+static void ctl_set_timeouts(int fd, int ms);
+static int  ctl_write_all(int fd, const char *buf, size_t len);
+static int  ctl_wait(int fd, short events, long long deadline_us);
+static int  ctl_send_by(int fd, const char *buf, size_t len, long long deadline_us);
+static void ctl_answer(int cfd, ctl_handler_fn handler, void *ctx, long long deadline_us);
+
+/* ------------------------ Server ------------------------ */
+
+int ctl_listen(void) {
+    struct sockaddr_un sa;
+    if (ctl_addr(&sa) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        if (errno != EADDRINUSE) { close(fd); return -1; }
+
+        /* Someone answering there owns the EC; otherwise it's a stale socket */
+        if (ctl_probe()) { close(fd); errno = EADDRINUSE; return -1; }
+
+        unlink(sa.sun_path);
+        if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) { close(fd); return -1; }
+    }
+
+    chmod(sa.sun_path, 0666);    /* dump for everyone; writes are checked per peer */
+    if (listen(fd, 8) != 0) { close(fd); unlink(sa.sun_path); return -1; }
+    return fd;
+}
+
+int ctl_probe(void) {
+    struct sockaddr_un sa;
+    if (ctl_addr(&sa) != 0) return 0;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return 0;
+    int alive = (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0);
+    close(fd);
+    return alive;
+}
+
+void ctl_close(int lfd) {
+    if (lfd < 0) return;
+    close(lfd);
+    unlink(CTL_SOCKET_PATH);
+}
+
+void ctl_serve(int lfd, ctl_handler_fn handler, void *ctx) {
+    long long deadline = mono_us() + CTL_SERVE_BUDGET_MS * 1000LL;
+    for (int served = 0; served < CTL_SERVE_MAX && mono_us() < deadline; ) {
+        int cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR) continue;
+            return;                          /* EAGAIN: nothing left */
+        }
+        served++;
+        ctl_answer(cfd, handler, ctx, deadline);
+        close(cfd);
+    }
+}
+
+/* Non-blocking client fd: every read and write waits at most until deadline_us */
+static void ctl_answer(int cfd, ctl_handler_fn handler, void *ctx, long long deadline_us) {
+    char req[CTL_REQ_MAX];
+    size_t len = 0;
+    while (len < sizeof(req) - 1 && ctl_wait(cfd, POLLIN, deadline_us) > 0) {
+        ssize_t n = read(cfd, req + len, sizeof(req) - 1 - len);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+        if (memchr(req, '\n', len)) break;
+    }
+    req[len] = 0;
+    char *nl = strchr(req, '\n');
+    if (nl) *nl = 0;
+    if (len == 0) return;
+
+    struct ucred cred;
+    socklen_t clen = sizeof(cred);
+    int privileged = (getsockopt(cfd, SOL_SOCKET, SO_PEERCRED, &cred, &clen) == 0 && cred.uid == 0);
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *out = open_memstream(&body, &body_len);
+    if (!out) return;
+    int rc = handler(ctx, req, privileged, out);
+    fclose(out);
+
+    if (ctl_send_by(cfd, rc == 0 ? "ok\n" : "err ", rc == 0 ? 3 : 4, deadline_us) == 0)
+        ctl_send_by(cfd, body, body_len, deadline_us);
+    free(body);
+}
+
+/* ------------------------ Client ------------------------ */
+
+int ctl_request(const char *req) {
+    struct sockaddr_un sa;
+    if (ctl_addr(&sa) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) { close(fd); return -1; }
+    ctl_set_timeouts(fd, CTL_CLIENT_TIMEOUT_MS);
+
+    char line[CTL_REQ_MAX];
+    int n = snprintf(line, sizeof(line), "%s\n", req);
+    if (n < 0 || (size_t)n >= sizeof(line) || ctl_write_all(fd, line, (size_t)n) != 0) {
+        close(fd);
+        fprintf(stderr, "Control socket: request failed\n");
+        return EXIT_FAILURE;
+    }
+    shutdown(fd, SHUT_WR);
+
+    /* Reply: "ok\n<body>" or "err <body>", the body streamed through to EOF
+       (stats and sensors can be any length) */
+    char buf[4096];
+    size_t len = 0;
+    ssize_t r = 0;
+    while (len < 4 && (r = read(fd, buf + len, sizeof(buf) - len)) > 0) len += (size_t)r;
+    int ok = len >= 3 && memcmp(buf, "ok\n", 3) == 0;
+    if (!ok && (len < 4 || memcmp(buf, "err ", 4) != 0)) {
+        close(fd);
+        if (r < 0) fprintf(stderr, "Control socket: no reply: %s\n", strerror(errno));
+        else fprintf(stderr, "Control socket: no reply\n");
+        return EXIT_FAILURE;
+    }
+    FILE *out = ok ? stdout : stderr;
+    fwrite(buf + (ok ? 3 : 4), 1, len - (ok ? 3 : 4), out);
+    while (r > 0 && (r = read(fd, buf, sizeof(buf))) > 0) fwrite(buf, 1, (size_t)r, out);
+    int e = errno;
+    close(fd);
+    fflush(out);
+    if (r < 0) {
+        fprintf(stderr, "\nControl socket: reply cut short: %s\n", strerror(e));
+        return EXIT_FAILURE;
+    }
+    return ok ? 0 : EXIT_FAILURE;
+}
+
+/* Small helpers */
+static int ctl_addr(struct sockaddr_un *sa) {
+    memset(sa, 0, sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (strlen(CTL_SOCKET_PATH) >= sizeof(sa->sun_path)) { errno = ENAMETOOLONG; return -1; }
+    strcpy(sa->sun_path, CTL_SOCKET_PATH);
+    return 0;
+}
+
+static void ctl_set_timeouts(int fd, int ms) {
+    struct timeval tv = { ms / 1000, (ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/* poll() for events until deadline_us: >0 ready, 0 out of time */
+static int ctl_wait(int fd, short events, long long deadline_us) {
+    for (;;) {
+        long long left = deadline_us - mono_us();
+        if (left <= 0) return 0;
+        struct pollfd pfd = { fd, events, 0 };
+        int r = poll(&pfd, 1, (int)((left + 999) / 1000));
+        if (r < 0 && errno == EINTR) continue;
+        return r;
+    }
+}
+
+static int ctl_send_by(int fd, const char *buf, size_t len, long long deadline_us) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN && ctl_wait(fd, POLLOUT, deadline_us) > 0) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int ctl_write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * ctl.h
+ *
+ * Control socket: the daemon owns the EC, clients ask it over a Unix socket.
+ *
+ * Protocol: one request line per connection ("dump", "dump -v", "set 40",
+ * "set1 40", "set2 40", "auto", "stats"); the reply starts with "ok\n" or "err <why>\n"
+ * followed by text for the client to print.
+ */
+
+#ifndef FAN_CONTROL_CTL_H
+#define FAN_CONTROL_CTL_H
+
+#include <stdio.h>
+
+#ifndef CTL_SOCKET_PATH
+#define CTL_SOCKET_PATH    "/run/fan-control.sock"
+#endif
+#define CTL_REQ_MAX        128
+#define CTL_SERVE_MAX      4      /* connections answered per wakeup ... */
+#define CTL_SERVE_BUDGET_MS 20     /* ... all within this; silent clients are dropped */
+#define CTL_CLIENT_TIMEOUT_MS 2000 /* the daemon answers between control cycles */
+
+/* Handle one request: write the reply body to out; return 0 for "ok".
+   privileged: the peer is root (may change duties). */
+typedef int (*ctl_handler_fn)(void *ctx, const char *req, int privileged, FILE *out);
+
+/* Bind the control socket; -1 with errno EADDRINUSE if a daemon already runs */
+int  ctl_listen(void);
+void ctl_close(int lfd);
+
+/* 1 if a daemon is answering on the control socket */
+int  ctl_probe(void);
+
+/* Accept and answer up to CTL_SERVE_MAX pending connections within
+   CTL_SERVE_BUDGET_MS (non-blocking listen fd); the rest wait for the
+   next wakeup, so clients can never hold up the control loop for long */
+void ctl_serve(int lfd, ctl_handler_fn handler, void *ctx);
+
+/* Client side: send req, print the reply (streamed, any length; one cut
+   off by a read error or timeout is reported as such). Returns the exit
+   code, or -1 if no daemon is listening (caller then talks to the EC itself). */
+int  ctl_request(const char *req);
+
+#endif /* FAN_CONTROL_CTL_H */
@@ -0,0 +1,74 @@
+/*
+ * curve.c
+ *
+ * Curve parsing and table compilation. Runs once per (re)load, never on the
+ * control path.
+ */
+
+#include "curve.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int curve_parse(struct fan_curve *c, const char *spec, char *err, size_t errlen) {
+    const char *p = spec;
+    int n = 0;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p) break;
+
+        char *end;
+        long t = strtol(p, &end, 10);
+        if (end == p || *end != ':') { snprintf(err, errlen, "expected temp:duty at '%s'", p); return -1; }
+        p = end + 1;
+        long d = strtol(p, &end, 10);
+        if (end == p) { snprintf(err, errlen, "expected duty at '%s'", p); return -1; }
+        p = end;
+
+        if (t < 0 || t > 255)  { snprintf(err, errlen, "temperature %ld out of 0..255", t); return -1; }
+        if (d < 0 || d > 100)  { snprintf(err, errlen, "duty %ld out of 0..100", d); return -1; }
+        if (n == CURVE_MAX_POINTS) { snprintf(err, errlen, "more than %d points", CURVE_MAX_POINTS); return -1; }
+        if (n > 0 && t <= c->temp[n - 1]) { snprintf(err, errlen, "temperatures must increase (%ld)", t); return -1; }
+
+        c->temp[n] = (uint8_t)t;
+        c->duty[n] = (uint8_t)d;
+        n++;
+    }
+
+    if (n == 0) { snprintf(err, errlen, "no points"); return -1; }
+    c->npoints = n;
+    return 0;
+}
+
+/* Linear between points, flat beyond the last one */
+static int curve_interp(const struct fan_curve *c, int t) {
+    if (t <= c->temp[0]) return c->duty[0];
+    for (int i = 1; i < c->npoints; i++) {
+        if (t <= c->temp[i]) {
+            double x0 = c->temp[i - 1], y0 = c->duty[i - 1];
+            double x1 = c->temp[i],     y1 = c->duty[i];
+            return (int)(y0 + (y1 - y0) * ((t - x0) / (x1 - x0)) + 0.5);
+        }
+    }
+    return c->duty[c->npoints - 1];
+}
+
+void curve_compile(struct fan_curve *c, int deadband_c, int min_duty_pct, int max_temp_c) {
+    int knee = c->temp[0];
+    c->on_thr  = (uint8_t)clamp(knee + deadband_c, 0, 255);
+    c->off_thr = (uint8_t)clamp(knee - deadband_c, 0, 255);
+
+    for (int t = 0; t < 256; t++) {
+        int run = curve_interp(c, t);
+        if (min_duty_pct > 0 && run > 0 && run < min_duty_pct) run = min_duty_pct;
+        if (t >= max_temp_c) run = 100;    /* hard max, whatever the points say */
+        run = clamp(run, 0, 100);
+
+        /* Stopped: keep off until comfortably above the knee */
+        c->duty_for_temp[0][t] = (uint8_t)((t <= c->on_thr) ? 0 : run);
+        /* Running: turn off only when comfortably below it */
+        c->duty_for_temp[1][t] = (uint8_t)((t < c->off_thr) ? 0 : run);
+    }
+}
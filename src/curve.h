@@ -0,0 +1,42 @@
+/*
+ * curve.h
+ *
+ * Piecewise-linear fan curves, compiled into lookup tables indexed by
+ * temperature in °C (the raw EC byte), with the on/off hysteresis folded in.
+ */
+
+#ifndef FAN_CONTROL_CURVE_H
+#define FAN_CONTROL_CURVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CURVE_MAX_POINTS  16
+
+struct fan_curve {
+    int     npoints;
+    uint8_t temp[CURVE_MAX_POINTS];    /* °C, strictly increasing */
+    uint8_t duty[CURVE_MAX_POINTS];    /* %, at temp[i] */
+
+    /* Compiled by curve_compile() */
+    uint8_t on_thr;                    /* stopped fan starts above this */
+    uint8_t off_thr;                   /* running fan stops below this */
+    uint8_t duty_for_temp[2][256];     /* [fan running][°C] -> target % */
+};
+
+/* Parse "40:20 60:45 80:100" (temp:duty pairs); 0 on success */
+int  curve_parse(struct fan_curve *c, const char *spec, char *err, size_t errlen);
+
+/* Build the tables. Below the first point the fan is off, with deadband_c
+   hysteresis around it; a running fan gets at least min_duty_pct, and
+   100% at/above max_temp_c. */
+void curve_compile(struct fan_curve *c, int deadband_c, int min_duty_pct, int max_temp_c);
+
+/* Hot path: one table lookup */
+static inline int curve_duty(const struct fan_curve *c, int temp_c, int prev_pct) {
+    if (temp_c < 0) temp_c = 0;
+    if (temp_c > 255) temp_c = 255;
+    return c->duty_for_temp[prev_pct != 0][temp_c];
+}
+
+#endif /* FAN_CONTROL_CURVE_H */
@@ -0,0 +1,590 @@
+/*
+ * ec.c
+ *
+ * EC access behind a small transport vtable:
+ *   - ioperm:    legacy ACPI EC ports (0x62 data / 0x66 command+status)
+ *   - ec_sys:    /sys/kernel/debug/ec/ec0/io (modprobe ec_sys [write_support=1]),
+ *                serialized against the kernel's own EC driver
+ *   - acpi_call: /proc/acpi/call, reading through a board ACPI method (EC_ACPI_READ_METHOD)
+ *
+ * Registers, the duty command and the RPM scale come from the board
+ * profile selected at startup (board.h); a read-only profile refuses every
+ * duty write.
+ *
+ * Only the port backend can issue raw EC commands (the duty write);
+ * the others borrow it for ec_io_do() and keep their own path for reads.
+ *
+ * Port status waits are tiered: most handshakes complete within a few
+ * microseconds, so we busy-poll first, then back off exponentially with
+ * nanosleep, and only then fall back to 1 ms sleeps until the deadline.
+ *
+ * ec_snapshot_read() batches every control register into one locked pass;
+ * on ec_sys it is a single pread() of the 256-byte register window.
+ *
+ * The duty registers are shadowed: writes of the value we already set are
+ * dropped, and the snapshot only reads the duties back every
+ * EC_VERIFY_INTERVAL_MS, after an EC error, or while the shadow is unknown.
+ *
+ * A failed wait fails the whole transaction: nothing read after a missed
+ * handshake is trusted, and a snapshot stops at the first failed register.
+ * ec_budget_begin() caps the EC time of one control cycle on top of the
+ * per-wait deadline; once it is spent, transactions fail without touching
+ * the EC.
+ */
+
+#include "ec.h"
+#include "board.h"
+#include "util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/io.h>
+#include <time.h>
+#include <unistd.h>
+
+/* --- EC I/O ports and commands --- */
+#define EC_SC 0x66
+#define EC_DATA 0x62
+#define IBF 1
+#define OBF 0
+#define EC_SC_READ_CMD 0x80
+
+/* --- Kernel interfaces --- */
+#define EC_SYS_IO_PATH        "/sys/kernel/debug/ec/ec0/io"
+#define ACPI_CALL_PATH        "/proc/acpi/call"
+#ifndef EC_ACPI_READ_METHOD
+#define EC_ACPI_READ_METHOD   "\\_SB.PCI0.LPCB.EC0.RDEC"  /* takes the register, returns its value */
+#endif
+
+struct ec_transport {
+    const char *name;
+    int  (*open)(void);
+    void (*close)(void);
+    int  (*read)(uint8_t reg, uint8_t *val);
+    int  (*read_window)(uint8_t regs[EC_REG_SIZE]);              /* NULL: per-register reads */
+    int  (*command)(uint8_t cmd, uint8_t port, uint8_t value);   /* NULL: borrow the port backend */
+};
+
+static int  ec_io_wait(const uint32_t port, const uint32_t flag, const char value);
+static int  ec_command_locked(uint8_t cmd, uint8_t port, uint8_t value);
+static int  duty_write_locked(int fan, int pct);
+static int  shadow_verify_due(void);
+static void shadow_verified(const uint8_t duty_raw[2]);
+static int  ec_tx_begin(void);
+static void ec_tx_end(int rc);
+static int  rpm_from_raw(int hi, int lo);
+static int  duty_pct_from_raw(int raw);
+
+static int  port_open(void);
+static void port_close(void);
+static int  port_read(uint8_t reg, uint8_t *val);
+static int  port_command(uint8_t cmd, uint8_t port, uint8_t value);
+static int  ecsys_open(void);
+static void ecsys_close(void);
+static int  ecsys_read(uint8_t reg, uint8_t *val);
+static int  ecsys_read_window(uint8_t regs[EC_REG_SIZE]);
+static int  acpi_open(void);
+static void acpi_close(void);
+static int  acpi_read(uint8_t reg, uint8_t *val);
+
+static const struct ec_transport g_transports[] = {
+    { "ec_sys",    ecsys_open, ecsys_close, ecsys_read, ecsys_read_window, NULL },
+    { "ioperm",    port_open,  port_close,  port_read,  NULL,              port_command },
+    { "acpi_call", acpi_open,  acpi_close,  acpi_read,  NULL,              NULL },
+};
+#define EC_TRANSPORT_COUNT ((int)(sizeof(g_transports) / sizeof(g_transports[0])))
+
+/* Serializes whole handshakes; the snapshot holds it for the entire pass */
+static pthread_mutex_t            g_ec_lock = PTHREAD_MUTEX_INITIALIZER;
+static const struct ec_transport *g_ec;          /* active backend */
+static int                        g_port_ok;     /* ioperm granted */
+static int                        g_ec_sys_fd = -1;
+static int                        g_acpi_fd = -1;
+
+/* Selected board; until ec_set_board() the read-only common layout */
+static const struct board_profile *g_board;
+
+/* Registers captured by ec_snapshot_read() when there is no window read
+   (the board's, filled in by ec_set_board()) */
+#define EC_SNAPSHOT_REGS 8
+static uint8_t g_snapshot_regs[EC_SNAPSHOT_REGS];
+
+static struct ec_wait_stats g_ec_stats;
+static unsigned long g_tx_polls;     /* polls in the current transaction */
+static int           g_tx_slept;     /* current transaction left the spin tier */
+static long          g_wait_deadline_us = EC_WAIT_DEADLINE_US;
+static unsigned long g_tx_timeouts;  /* timeouts seen when the transaction started */
+static long long     g_budget_end_us; /* ec_budget_begin() deadline, 0 = none */
+
+/* Shadow of what we believe the EC holds (all guarded by g_ec_lock) */
+static struct {
+    int       duty_raw[2];      /* last written/verified raw duty, -1 = unknown */
+    int       rpm[2];           /* last-known RPM */
+    long long verified_us;      /* last read-back, 0 = never */
+    int       verify;           /* forced read-back (EC error) */
+} g_shadow = { { -1, -1 }, { 0, 0 }, 0, 1 };
+static struct ec_shadow_stats g_shadow_stats;
+
+static const unsigned long g_poll_hist_bounds[EC_POLL_HIST_BUCKETS - 1] = { 4, 8, 16, 64, 256 };
+
+/* ---------------------- EC access ----------------------- */
+
+void ec_set_board(const struct board_profile *b) {
+    pthread_mutex_lock(&g_ec_lock);
+    g_board = b;
+    const uint8_t regs[EC_SNAPSHOT_REGS] = {
+        b->cpu_temp,  b->gpu_temp,
+        b->duty[0],   b->duty[1],
+        b->rpm_hi[0], b->rpm_lo[0],
+        b->rpm_hi[1], b->rpm_lo[1],
+    };
+    memcpy(g_snapshot_regs, regs, sizeof(regs));
+    pthread_mutex_unlock(&g_ec_lock);
+}
+
+const struct board_profile *ec_board(void) {
+    return g_board;
+}
+
+/* Open the named backend, or pick one: ec_sys if present, else port I/O */
+int ec_init(const char *transport) {
+    ec_close();
+    if (!g_board) ec_set_board(board_by_name(BOARD_UNKNOWN));
+
+    if (transport == NULL || strcmp(transport, "auto") == 0) {
+        for (int i = 0; i < EC_TRANSPORT_COUNT; i++) {
+            if (strcmp(g_transports[i].name, "acpi_call") == 0) continue;  /* board-specific, opt-in only */
+            if (g_transports[i].open() == 0) { g_ec = &g_transports[i]; return 0; }
+        }
+        return -1;
+    }
+
+    for (int i = 0; i < EC_TRANSPORT_COUNT; i++) {
+        if (strcmp(g_transports[i].name, transport) != 0) continue;
+        if (g_transports[i].open() != 0) return -1;
+        g_ec = &g_transports[i];
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+void ec_close(void) {
+    if (g_ec) g_ec->close();
+    port_close();   /* may have been opened for commands only */
+    g_ec = NULL;
+    g_shadow.duty_raw[0] = g_shadow.duty_raw[1] = -1;
+    g_shadow.verify = 1;
+}
+
+const char *ec_transport_name(void) {
+    return g_ec ? g_ec->name : "none";
+}
+
+const char *ec_transport_name_at(int i) {
+    return (i >= 0 && i < EC_TRANSPORT_COUNT) ? g_transports[i].name : NULL;
+}
+
+int ec_io_read(const uint32_t port) {
+    uint8_t v = 0;
+    int rc = -1;
+    pthread_mutex_lock(&g_ec_lock);
+    if (ec_tx_begin() == 0 && g_ec) rc = g_ec->read((uint8_t)port, &v);
+    ec_tx_end(rc);
+    pthread_mutex_unlock(&g_ec_lock);
+    return (rc == 0) ? v : -1;
+}
+
+int ec_io_do(const uint32_t cmd, const uint32_t port, const uint8_t value) {
+    pthread_mutex_lock(&g_ec_lock);
+    int rc = ec_command_locked((uint8_t)cmd, (uint8_t)port, value);
+    pthread_mutex_unlock(&g_ec_lock);
+    return rc;
+}
+
+/* One command transaction; raw commands borrow port I/O on kernel backends */
+static int ec_command_locked(uint8_t cmd, uint8_t port, uint8_t value) {
+    int rc = -1;
+    if (ec_tx_begin() != 0) {
+        /* budget spent */
+    } else if (g_ec && g_ec->command) {
+        rc = g_ec->command(cmd, port, value);
+    } else if (g_ec && (g_port_ok || port_open() == 0)) {
+        rc = port_command(cmd, port, value);
+    }
+    ec_tx_end(rc);
+    return rc;
+}
+
+/* ----------------------- Snapshot ----------------------- */
+
+int ec_snapshot_read(struct ec_snapshot *snap) {
+    uint8_t regs[EC_REG_SIZE] = {0};
+
+    pthread_mutex_lock(&g_ec_lock);
+    int verify = shadow_verify_due();
+
+    int rc = -1;
+    if (ec_tx_begin() != 0 || !g_ec) {
+        /* budget spent, or no backend */
+    } else if (g_ec->read_window) {
+        rc = g_ec->read_window(regs);
+        verify = 1;                       /* came along for free */
+    } else {
+        rc = 0;
+        for (size_t i = 0; i < sizeof(g_snapshot_regs) && rc == 0; i++) {
+            uint8_t reg = g_snapshot_regs[i];
+            if (!verify && (reg == g_board->duty[0] || reg == g_board->duty[1])) continue;
+            rc = g_ec->read(reg, &regs[reg]);
+        }
+    }
+    ec_tx_end(rc);
+    if (rc != 0) {
+        pthread_mutex_unlock(&g_ec_lock);
+        return -1;                        /* *snap keeps the last good values */
+    }
+
+    if (verify) {
+        uint8_t duty_raw[2] = { regs[g_board->duty[0]], regs[g_board->duty[1]] };
+        shadow_verified(duty_raw);
+    } else {
+        regs[g_board->duty[0]] = (uint8_t)g_shadow.duty_raw[0];
+        regs[g_board->duty[1]] = (uint8_t)g_shadow.duty_raw[1];
+    }
+
+    const struct board_profile *b = g_board;
+    snap->cpu_temp  = regs[b->cpu_temp];
+    snap->gpu_temp  = regs[b->gpu_temp];
+    snap->fan1_duty = duty_pct_from_raw(regs[b->duty[0]]);
+    snap->fan2_duty = duty_pct_from_raw(regs[b->duty[1]]);
+    snap->fan1_rpm  = rpm_from_raw(regs[b->rpm_hi[0]], regs[b->rpm_lo[0]]);
+    snap->fan2_rpm  = rpm_from_raw(regs[b->rpm_hi[1]], regs[b->rpm_lo[1]]);
+    g_shadow.rpm[0] = snap->fan1_rpm;
+    g_shadow.rpm[1] = snap->fan2_rpm;
+    pthread_mutex_unlock(&g_ec_lock);
+    return 0;
+}
+
+/* -------------------- Shadow registers ------------------ */
+
+/* Read-back needed: unknown shadow, EC error, or interval elapsed */
+static int shadow_verify_due(void) {
+    if (g_shadow.verify || g_shadow.duty_raw[0] < 0 || g_shadow.duty_raw[1] < 0) return 1;
+    return mono_us() - g_shadow.verified_us >= (long long)EC_VERIFY_INTERVAL_MS * 1000;
+}
+
+/* Take the hardware's word for it; a diverged shadow means the EC/BIOS moved it */
+static void shadow_verified(const uint8_t duty_raw[2]) {
+    for (int f = 0; f < 2; f++) {
+        if (g_shadow.duty_raw[f] >= 0 && g_shadow.duty_raw[f] != duty_raw[f]) g_shadow_stats.mismatches++;
+        g_shadow.duty_raw[f] = duty_raw[f];
+    }
+    g_shadow.verified_us = mono_us();
+    g_shadow.verify = 0;
+    g_shadow_stats.verifies++;
+}
+
+/* Fan duty write (0..100) via the board's duty command and fan selector */
+static int duty_write_locked(int fan, int pct) {
+    if (g_board->read_only) { errno = EPERM; return -1; }
+    pct = clamp(pct, 0, 100);
+    int v = (int)(pct / 100.0 * g_board->duty_raw_max + 0.5);
+    if (g_shadow.duty_raw[fan] == v && !g_shadow.verify) {
+        g_shadow_stats.writes_dropped++;
+        return 0;
+    }
+
+    int rc = ec_command_locked(g_board->duty_cmd, g_board->duty_port[fan], (uint8_t)v);
+    g_shadow_stats.writes++;
+    if (rc == 0) {
+        g_shadow.duty_raw[fan] = v;
+    } else {
+        g_shadow.duty_raw[fan] = -1;      /* unknown until the next read-back */
+        g_shadow.verify = 1;
+    }
+    return rc;
+}
+
+/* Both fans back to back under one lock; redundant halves are dropped */
+int fans_duty_write(int pct1, int pct2) {
+    pthread_mutex_lock(&g_ec_lock);
+    int rc1 = duty_write_locked(0, pct1);
+    int rc2 = duty_write_locked(1, pct2);
+    pthread_mutex_unlock(&g_ec_lock);
+    return (rc1 == 0 && rc2 == 0) ? 0 : -1;
+}
+
+void ec_shadow_invalidate(void) {
+    pthread_mutex_lock(&g_ec_lock);
+    g_shadow.duty_raw[0] = g_shadow.duty_raw[1] = -1;
+    g_shadow.verify = 1;
+    pthread_mutex_unlock(&g_ec_lock);
+}
+
+void ec_shadow_stats_get(struct ec_shadow_stats *out) {
+    pthread_mutex_lock(&g_ec_lock);
+    *out = g_shadow_stats;
+    pthread_mutex_unlock(&g_ec_lock);
+}
+
+/* ------------------- Port I/O backend ------------------- */
+
+static int port_open(void) {
+    if (g_port_ok) return 0;
+    if (ioperm(EC_DATA, 1, 1) != 0) return -1;
+    if (ioperm(EC_SC,   1, 1) != 0) return -1;
+    g_port_ok = 1;
+    return 0;
+}
+
+static void port_close(void) {
+    if (!g_port_ok) return;
+    ioperm(EC_DATA, 1, 0);
+    ioperm(EC_SC,   1, 0);
+    g_port_ok = 0;
+}
+
+/* 0 once the status bit matches; -1 at the wait deadline or the cycle budget */
+static int ec_io_wait(const uint32_t port, const uint32_t flag, const char value) {
+    /* Tier 1: bounded spin, no syscalls */
+    for (int i = 0; i < EC_WAIT_SPIN_POLLS; i++) {
+        g_tx_polls++;
+        if (((inb(port) >> flag) & 0x1) == value) return 0;
+    }
+
+    /* Tier 2/3: exponential backoff, then plain sleeping, until the deadline */
+    g_tx_slept = 1;
+    long long deadline = mono_us() + g_wait_deadline_us;
+    int budget = (g_budget_end_us > 0 && g_budget_end_us < deadline);
+    if (budget) deadline = g_budget_end_us;
+    long ns = EC_WAIT_BACKOFF_MIN_NS;
+    for (;;) {
+        struct timespec ts = { 0, ns };
+        nanosleep(&ts, NULL);
+
+        g_tx_polls++;
+        if (((inb(port) >> flag) & 0x1) == value) return 0;
+        if (mono_us() >= deadline) break;
+
+        if (ns < EC_WAIT_BACKOFF_MAX_NS) ns *= 2;
+        else ns = EC_WAIT_SLEEP_US * 1000L;
+    }
+
+    if (budget) g_ec_stats.budget_cuts++;
+    else        g_ec_stats.timeouts++;
+    return -1;
+}
+
+static int port_read(uint8_t reg, uint8_t *val) {
+    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
+    outb(EC_SC_READ_CMD, EC_SC);
+
+    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
+    outb(reg, EC_DATA);
+
+    if (ec_io_wait(EC_SC, OBF, 1) != 0) return -1;
+    *val = inb(EC_DATA);
+    return 0;
+}
+
+static int port_command(uint8_t cmd, uint8_t port, uint8_t value) {
+    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
+    outb(cmd, EC_SC);
+
+    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
+    outb(port, EC_DATA);
+
+    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
+    outb(value, EC_DATA);
+
+    return ec_io_wait(EC_SC, IBF, 0);
+}
+
+/* -------------------- ec_sys backend -------------------- */
+
+static int ecsys_open(void) {
+    if (g_ec_sys_fd >= 0) return 0;
+    g_ec_sys_fd = open(EC_SYS_IO_PATH, O_RDONLY | O_CLOEXEC);
+    return (g_ec_sys_fd >= 0) ? 0 : -1;
+}
+
+static void ecsys_close(void) {
+    if (g_ec_sys_fd >= 0) close(g_ec_sys_fd);
+    g_ec_sys_fd = -1;
+}
+
+static int ecsys_read(uint8_t reg, uint8_t *val) {
+    return (pread(g_ec_sys_fd, val, 1, reg) == 1) ? 0 : -1;
+}
+
+/* Whole window in one syscall */
+static int ecsys_read_window(uint8_t regs[EC_REG_SIZE]) {
+    return (pread(g_ec_sys_fd, regs, EC_REG_SIZE, 0) == EC_REG_SIZE) ? 0 : -1;
+}
+
+/* ------------------- acpi_call backend ------------------ */
+
+static int acpi_open(void) {
+    if (g_acpi_fd >= 0) return 0;
+    g_acpi_fd = open(ACPI_CALL_PATH, O_RDWR | O_CLOEXEC);
+    if (g_acpi_fd < 0) return -1;
+
+    /* Probe once so a missing method fails at startup, not in the loop */
+    uint8_t v;
+    if (acpi_read(g_board->cpu_temp, &v) != 0) { acpi_close(); return -1; }
+    return 0;
+}
+
+static void acpi_close(void) {
+    if (g_acpi_fd >= 0) close(g_acpi_fd);
+    g_acpi_fd = -1;
+}
+
+/* Write "<method> <reg>", read back "0x.." (or "Error: ...") */
+static int acpi_read(uint8_t reg, uint8_t *val) {
+    char req[96];
+    int n = snprintf(req, sizeof(req), "%s 0x%02x", EC_ACPI_READ_METHOD, reg);
+    if (n < 0 || (size_t)n >= sizeof(req)) return -1;
+    if (write(g_acpi_fd, req, (size_t)n) != n) return -1;
+
+    char res[64] = {0};
+    ssize_t r = pread(g_acpi_fd, res, sizeof(res) - 1, 0);
+    if (r <= 0 || strncmp(res, "0x", 2) != 0) return -1;
+    *val = (uint8_t)strtoul(res, NULL, 16);
+    return 0;
+}
+
+/* ------------------- Sensing helpers -------------------- */
+
+int cpu_temp_ec(void) {
+    /* EC CPU temp in °C */
+    return ec_io_read(g_board->cpu_temp);
+}
+
+/* Fan duty read (0..100); always hits the EC and refreshes the shadow */
+static int duty_read(int fan) {
+    uint8_t v = 0;
+    int rc = -1;
+    pthread_mutex_lock(&g_ec_lock);
+    if (ec_tx_begin() == 0 && g_ec) rc = g_ec->read(g_board->duty[fan], &v);
+    ec_tx_end(rc);
+    g_shadow.duty_raw[fan] = (rc == 0) ? v : -1;
+    pthread_mutex_unlock(&g_ec_lock);
+    return (rc == 0) ? duty_pct_from_raw(v) : -1;
+}
+
+int fan1_duty_read(void) { return duty_read(0); }
+int fan2_duty_read(void) { return duty_read(1); }
+
+/* Fan RPM read */
+static int rpm_read(uint8_t reg_hi, uint8_t reg_lo) {
+    int hi = ec_io_read(reg_hi);
+    int lo = (hi >= 0) ? ec_io_read(reg_lo) : -1;
+    return (lo >= 0) ? rpm_from_raw(hi, lo) : -1;
+}
+
+int fan1_rpm_read(void) { return rpm_read(g_board->rpm_hi[0], g_board->rpm_lo[0]); }
+int fan2_rpm_read(void) { return rpm_read(g_board->rpm_hi[1], g_board->rpm_lo[1]); }
+
+/* Single-fan duty write (0..100), through the shadow */
+int fan1_duty_write(int pct) {
+    pthread_mutex_lock(&g_ec_lock);
+    int rc = duty_write_locked(0, pct);
+    pthread_mutex_unlock(&g_ec_lock);
+    return rc;
+}
+int fan2_duty_write(int pct) {
+    pthread_mutex_lock(&g_ec_lock);
+    int rc = duty_write_locked(1, pct);
+    pthread_mutex_unlock(&g_ec_lock);
+    return rc;
+}
+
+/* ------------------- Wait statistics -------------------- */
+
+/* -1 (and counted) if this cycle's EC budget is already spent */
+static int ec_tx_begin(void) {
+    g_tx_polls = 0;
+    g_tx_slept = 0;
+    g_tx_timeouts = g_ec_stats.timeouts;
+    if (g_budget_end_us > 0 && mono_us() >= g_budget_end_us) {
+        g_ec_stats.budget_cuts++;
+        return -1;
+    }
+    return 0;
+}
+
+static void ec_tx_end(int rc) {
+    if (rc != 0) {
+        g_ec_stats.failures++;
+        g_shadow.verify = 1;              /* EC hiccup: re-check the shadow */
+    }
+    if (g_ec_stats.timeouts != g_tx_timeouts) g_shadow.verify = 1;
+    g_ec_stats.transactions++;
+    g_ec_stats.polls += g_tx_polls;
+    if (g_tx_polls > g_ec_stats.polls_max) g_ec_stats.polls_max = g_tx_polls;
+    if (g_tx_slept) g_ec_stats.slept++;
+
+    int b = 0;
+    while (b < EC_POLL_HIST_BUCKETS - 1 && g_tx_polls > g_poll_hist_bounds[b]) b++;
+    g_ec_stats.hist[b]++;
+}
+
+void ec_wait_stats_get(struct ec_wait_stats *out) {
+    *out = g_ec_stats;
+}
+
+void ec_set_wait_deadline_us(long us) {
+    g_wait_deadline_us = (us > 0) ? us : EC_WAIT_DEADLINE_US;
+}
+
+void ec_budget_begin(long us) {
+    pthread_mutex_lock(&g_ec_lock);
+    g_budget_end_us = (us > 0) ? mono_us() + us : 0;
+    pthread_mutex_unlock(&g_ec_lock);
+}
+
+void ec_budget_end(void) {
+    ec_budget_begin(0);
+}
+
+void ec_wait_stats_reset(void) {
+    memset(&g_ec_stats, 0, sizeof(g_ec_stats));
+    memset(&g_shadow_stats, 0, sizeof(g_shadow_stats));
+}
+
+void ec_stats_print(FILE *out) {
+    const struct ec_wait_stats *s = &g_ec_stats;
+    double avg = s->transactions ? (double)s->polls / (double)s->transactions : 0.0;
+
+    fprintf(out, "EC: %lu transactions, %.1f polls avg, %lu max, %lu slept, %lu timeouts\n",
+            s->transactions, avg, s->polls_max, s->slept, s->timeouts);
+    fprintf(out, "EC errors: %lu failed transactions, %lu cut by the cycle budget\n",
+            s->failures, s->budget_cuts);
+    fprintf(out, "EC polls/tx:");
+    for (int b = 0; b < EC_POLL_HIST_BUCKETS; b++) {
+        if (b < EC_POLL_HIST_BUCKETS - 1) fprintf(out, "  <=%lu:%lu", g_poll_hist_bounds[b], s->hist[b]);
+        else fprintf(out, "  >%lu:%lu", g_poll_hist_bounds[b - 1], s->hist[b]);
+    }
+    fprintf(out, "\n");
+    fprintf(out, "EC shadow: %lu writes, %lu dropped, %lu read-backs, %lu mismatches\n",
+            g_shadow_stats.writes, g_shadow_stats.writes_dropped,
+            g_shadow_stats.verifies, g_shadow_stats.mismatches);
+}
+
+/* ----------------------- Utils -------------------------- */
+
+static int duty_pct_from_raw(int raw) {
+    int pct = (int)(((double)raw / g_board->duty_raw_max) * 100.0 + 0.5);
+    return clamp(pct, 0, 100);
+}
+
+/* Convert EC raw RPM value (two bytes) to RPM: rpm_k / raw
+   (2156220 on the common layout, from the original project) */
+static int rpm_from_raw(int hi, int lo) {
+    int raw = (hi << 8) | lo;
+    return (raw > 0) ? (int)(g_board->rpm_k / raw) : 0;
+}
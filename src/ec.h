@@ -0,0 +1,120 @@
+/*
+ * ec.h
+ *
+ * Embedded controller access through a pluggable transport
+ * (ioperm port I/O, ec_sys debugfs, acpi_call).
+ */
+
+#ifndef FAN_CONTROL_EC_H
+#define FAN_CONTROL_EC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* --- Common EC register layout (typical Clevo); per model in board.c --- */
+#define EC_REG_SIZE           0x100
+#define EC_REG_CPU_TEMP       0x07
+#define EC_REG_GPU_TEMP       0xCD
+#define EC_REG_FAN1_DUTY      0xCE
+#define EC_REG_FAN2_DUTY      0xCF
+#define EC_REG_FAN1_RPM_HI    0xD0
+#define EC_REG_FAN1_RPM_LO    0xD1
+#define EC_REG_FAN2_RPM_HI    0xD2
+#define EC_REG_FAN2_RPM_LO    0xD3
+
+/* --- Status wait tuning --- */
+#define EC_WAIT_SPIN_POLLS     64      /* tier 1: busy-poll the status port this many times */
+#define EC_WAIT_BACKOFF_MIN_NS 1000    /* tier 2: nanosleep from 1 us, doubling ... */
+#define EC_WAIT_BACKOFF_MAX_NS 512000  /* ... up to ~0.5 ms */
+#define EC_WAIT_SLEEP_US       1000    /* tier 3: then sleep 1 ms between polls */
+#ifndef EC_WAIT_DEADLINE_US
+#define EC_WAIT_DEADLINE_US    100000  /* give up on a single wait after 100 ms (-DFAN_CONTROL_EC_DEADLINE_US) */
+#endif
+
+#define EC_CYCLE_BUDGET_US     150000  /* default EC time per control cycle (config ec_budget_us) */
+
+#define EC_VERIFY_INTERVAL_MS  30000   /* read the duty registers back at least this often */
+
+/* Polls-per-transaction histogram: <=4, <=8, <=16, <=64, <=256, more */
+#define EC_POLL_HIST_BUCKETS   6
+
+struct ec_wait_stats {
+    unsigned long transactions;   /* completed ec_io_read/ec_io_do calls */
+    unsigned long polls;          /* status port reads across all transactions */
+    unsigned long polls_max;      /* worst single transaction */
+    unsigned long slept;          /* transactions that left the spin tier */
+    unsigned long timeouts;       /* waits that hit the deadline */
+    unsigned long failures;       /* transactions that failed (timeout, backend error, budget) */
+    unsigned long budget_cuts;    /* waits cut short or transactions refused by the cycle budget */
+    unsigned long hist[EC_POLL_HIST_BUCKETS];
+};
+
+struct ec_shadow_stats {
+    unsigned long writes;         /* duty writes sent to the EC */
+    unsigned long writes_dropped; /* duty writes already matching the shadow */
+    unsigned long verifies;       /* duty read-backs */
+    unsigned long mismatches;     /* read-backs that disagreed with the shadow */
+};
+
+/* Every control register, captured in one locked pass.
+   Duties come from the shadow unless a read-back is due. */
+struct ec_snapshot {
+    int cpu_temp;      /* °C */
+    int gpu_temp;      /* °C, EC fallback - may be 0 on some models */
+    int fan1_duty;     /* 0..100 */
+    int fan2_duty;     /* 0..100 */
+    int fan1_rpm;
+    int fan2_rpm;
+};
+
+struct board_profile;
+
+/* Register layout for everything after this (once, at startup);
+   ec_init() without it uses the read-only BOARD_UNKNOWN profile */
+void    ec_set_board(const struct board_profile *b);
+const struct board_profile *ec_board(void);
+
+/* Open a backend by name; NULL or "auto" picks ec_sys, then ioperm */
+int     ec_init(const char *transport);
+void    ec_close(void);
+const char *ec_transport_name(void);          /* active backend */
+const char *ec_transport_name_at(int i);      /* i-th known backend, NULL past the end */
+
+/* Register value, or -1 if the transaction failed */
+int     ec_io_read(const uint32_t port);
+int     ec_io_do(const uint32_t cmd, const uint32_t port, const uint8_t value);
+
+/* One batched read of all control registers; 0 on success,
+   -1 (snap untouched) at the first register that fails */
+int     ec_snapshot_read(struct ec_snapshot *snap);
+
+/* Single-register helpers (one EC transaction each); -1 on failure */
+int     cpu_temp_ec(void);
+int     fan1_duty_read(void);
+int     fan2_duty_read(void);
+int     fan1_rpm_read(void);
+int     fan2_rpm_read(void);
+int     fan1_duty_write(int pct);   /* dropped if the shadow already matches */
+int     fan2_duty_write(int pct);
+
+/* Both fans back to back under one lock; 0 if both succeeded */
+int     fans_duty_write(int pct1, int pct2);
+
+/* Forget the shadow: next writes go out, next snapshot reads back */
+void    ec_shadow_invalidate(void);
+
+/* Per-wait deadline (config ec_deadline_us); <= 0 restores EC_WAIT_DEADLINE_US */
+void    ec_set_wait_deadline_us(long us);
+
+/* Cap the EC time of what follows (one control cycle) at us from now; until
+   ec_budget_end() every wait stops at the cap and, past it, transactions
+   fail without touching the EC */
+void    ec_budget_begin(long us);
+void    ec_budget_end(void);
+
+void    ec_wait_stats_get(struct ec_wait_stats *out);
+void    ec_shadow_stats_get(struct ec_shadow_stats *out);
+void    ec_wait_stats_reset(void);   /* wait and shadow counters */
+void    ec_stats_print(FILE *out);
+
+#endif /* FAN_CONTROL_EC_H */
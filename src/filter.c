@@ -0,0 +1,90 @@
+/*
+ * filter.c
+ *
+ * Median, outlier rejection and EMA / one-euro smoothing of the
+ * temperature inputs (filter.h).
+ */
+
+#include "filter.h"
+
+#include <math.h>
+
+static int    median(int *v, int n);
+static double alpha(double dt_s, double cutoff_hz);
+
+void filter_reset(struct filter *f) {
+    f->x = f->dx = 0.0;
+    f->last_us = 0;
+    f->have = 0;
+    f->jump_run = 0;
+    f->rejected = 0;
+}
+
+int filter_step(struct filter *f, const struct filter_params *k, const int *raw, int n, long long now_us) {
+    int v[FILTER_MAX_SAMPLES];
+    int m = 0;
+    for (int i = 0; i < n && i < FILTER_MAX_SAMPLES; i++) {
+        if (raw[i] >= FILTER_MIN_C && raw[i] <= FILTER_MAX_C) v[m++] = raw[i];
+        else f->rejected++;
+    }
+    if (m == 0) return f->have ? (int)lround(f->x) : (n > 0 ? raw[0] : 0);
+    double t = median(v, m);
+
+    if (!f->have) {
+        f->x = t;
+        f->dx = 0.0;
+        f->have = 1;
+        f->last_us = now_us;
+        return (int)lround(f->x);
+    }
+
+    // A jump is believed once it persists; then the filter starts over from it
+    if (k->max_jump_c > 0 && fabs(t - f->x) > k->max_jump_c) {
+        if (++f->jump_run < FILTER_JUMP_CONFIRM) {
+            f->rejected++;
+            return (int)lround(f->x);
+        }
+        f->x = t;
+        f->dx = 0.0;
+        f->jump_run = 0;
+        f->last_us = now_us;
+        return (int)lround(f->x);
+    }
+    f->jump_run = 0;
+
+    double dt = (double)(now_us - f->last_us) / 1e6;
+    f->last_us = now_us;
+    if (dt <= 0.0) return (int)lround(f->x);
+
+    switch (k->kind) {
+    case FILTER_EMA:
+        f->x += (1.0 - exp(-dt / k->ema_tau_s)) * (t - f->x);
+        break;
+    case FILTER_EURO: {
+        double speed = (t - f->x) / dt;
+        f->dx += alpha(dt, FILTER_EURO_D_CUTOFF) * (speed - f->dx);
+        f->x  += alpha(dt, k->euro_cutoff_hz + k->euro_beta * fabs(f->dx)) * (t - f->x);
+        break;
+    }
+    default:
+        f->x = t;
+        break;
+    }
+    return (int)lround(f->x);
+}
+
+/* Insertion sort of a handful of values; v is reordered */
+static int median(int *v, int n) {
+    for (int i = 1; i < n; i++) {
+        int x = v[i], j = i - 1;
+        while (j >= 0 && v[j] > x) { v[j + 1] = v[j]; j--; }
+        v[j + 1] = x;
+    }
+    return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2] + 1) / 2;
+}
+
+/* Smoothing factor of a first-order low-pass at cutoff_hz, sampled every dt_s */
+static double alpha(double dt_s, double cutoff_hz) {
+    double tau = 1.0 / (2.0 * 3.14159265358979323846 * cutoff_hz);
+    return 1.0 / (1.0 + tau / dt_s);
+}
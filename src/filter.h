@@ -0,0 +1,62 @@
+/*
+ * filter.h
+ *
+ * Temperature conditioning between sensing and control: the EC's CPU byte
+ * jumps by several degrees from one read to the next, and each jump across
+ * a curve step is a duty change and an EC write. Per input, every cycle:
+ *
+ *   1. oversampling: the median of up to FILTER_MAX_SAMPLES reads
+ *   2. outlier rejection: readings outside FILTER_MIN_C..FILTER_MAX_C
+ *      (0 and 255 from a confused EC) are dropped, and a jump of more than
+ *      max_jump_c is only believed once it persists for FILTER_JUMP_CONFIRM
+ *      cycles
+ *   3. smoothing across cycles: EMA, or a one-euro filter (smooth when
+ *      steady, little lag when the temperature moves)
+ *
+ * Fixed memory, O(1) work per sample.
+ */
+
+#ifndef FAN_CONTROL_FILTER_H
+#define FAN_CONTROL_FILTER_H
+
+#define FILTER_MAX_SAMPLES     7
+#define FILTER_MIN_C           1       /* plausible range of a reading */
+#define FILTER_MAX_C           125
+#define FILTER_JUMP_CONFIRM    3       /* cycles a big jump must persist */
+#define FILTER_EURO_D_CUTOFF   1.0     /* Hz, smoothing of the one-euro speed estimate */
+
+/* Defaults, overridable in the config file (temp_* keys) */
+#define FILTER_DEFAULT_OVERSAMPLE  3
+#define FILTER_DEFAULT_EMA_TAU_S   2.0
+#define FILTER_DEFAULT_EURO_CUTOFF 0.1     /* Hz at rest */
+#define FILTER_DEFAULT_EURO_BETA   0.2     /* cutoff added per °C/s */
+#define FILTER_DEFAULT_MAX_JUMP    20      /* °C per cycle, 0: no jump check */
+
+enum { FILTER_NONE, FILTER_EMA, FILTER_EURO };
+
+struct filter_params {
+    int    kind;              /* FILTER_* */
+    int    oversample;        /* CPU reads per cycle, 1..FILTER_MAX_SAMPLES */
+    double ema_tau_s;
+    double euro_cutoff_hz;
+    double euro_beta;
+    int    max_jump_c;
+};
+
+struct filter {
+    double    x;              /* filtered temperature */
+    double    dx;             /* one-euro: smoothed °C/s */
+    long long last_us;
+    int       have;           /* x is valid */
+    int       jump_run;       /* consecutive cycles far from x */
+    unsigned long rejected;   /* readings/cycles thrown away */
+};
+
+void filter_reset(struct filter *f);
+
+/* Condition this cycle's n raw readings of one input (n <= FILTER_MAX_SAMPLES);
+   returns the temperature to control on. Nothing usable: the last output,
+   or the first raw reading if there never was one */
+int  filter_step(struct filter *f, const struct filter_params *k, const int *raw, int n, long long now_us);
+
+#endif /* FAN_CONTROL_FILTER_H */
@@ -0,0 +1,394 @@
+/*
+ * gpu.c
+ *
+ * GPU temperature discovery:
+ *   - hwmon registry: scanned once, tempN_input fds kept open and pread() each cycle
+ *   - NVML:           libnvidia-ml.so loaded at runtime, device handle kept open
+ *   - nvidia-smi:     last resort, spawns a process; result cached for NVSMI_CACHE_TTL_MS
+ *
+ * GPU utilization (load feed-forward) comes from amdgpu/i915 gpu_busy_percent
+ * (fds kept open like the hwmon ones) or NVML.
+ *
+ * The registry is rescanned only when a cached sensor is gone (ENODEV/ENOENT)
+ * or a kernel uevent reports that the hwmon set changed (GPU driver
+ * load/unload, hotplug). Any other read error (amdgpu's EPERM while the
+ * dGPU is runtime-suspended) is just no reading this cycle.
+ * A restart can rebuild it from the previous run's paths (state.h) instead
+ * of scanning.
+ */
+
+#include "gpu.h"
+#include "util.h"
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HWMON_ROOT            "/sys/class/hwmon"
+#define HWMON_MAX_TEMPS       10   /* temp1_input .. temp10_input per hwmon */
+#define HWMON_MAX_SENSORS     GPU_MAX_SENSORS
+#define NVSMI_CACHE_TTL_MS    5000 /* re-spawn nvidia-smi at most this often */
+#define DRM_ROOT              "/sys/class/drm"
+#define DRM_MAX_BUSY          4    /* gpu_busy_percent files kept open */
+
+/* --- Minimal NVML ABI (no nvml.h needed at build time) --- */
+typedef int   nvmlReturn_t;
+typedef void *nvmlDevice_t;
+#define NVML_SUCCESS          0
+#define NVML_TEMPERATURE_GPU  0
+typedef struct { unsigned int gpu, memory; } nvmlUtilization_t;
+
+static struct {
+    int fds[HWMON_MAX_SENSORS];  /* open tempN_input fds of matching hwmons */
+    char paths[HWMON_MAX_SENSORS][GPU_SENSOR_PATH_MAX];
+    int count;
+    int scanned;                 /* registry has been built at least once */
+    int dirty;                   /* rescan before the next read */
+    int uevent_fd;               /* kernel uevent socket, -1 if unavailable */
+} g_hwmon = { .uevent_fd = -1 };
+
+static int  hwmon_is_gpu(int hwfd);
+static void hwmon_clear(void);
+static int  hwmon_scan(void);
+static void uevent_open(void);
+static void hwmon_poll_uevents(void);
+static int  hwmon_read_cached(int *best);
+static void busy_scan(void);
+static int  nvml_load(void);
+static int  path_exists(const char *path);
+
+static struct {
+    void        *lib;
+    nvmlDevice_t dev;
+    int          tried;          /* load attempted; never retried once it failed */
+    nvmlReturn_t (*get_temp)(nvmlDevice_t, int, unsigned int *);
+    nvmlReturn_t (*get_util)(nvmlDevice_t, nvmlUtilization_t *);   /* optional */
+} g_nvml;
+
+static struct {
+    int fds[DRM_MAX_BUSY];       /* open <card>/device/gpu_busy_percent */
+    int count;
+    int scanned;
+} g_busy;
+
+static struct {
+    int       value;             /* last result (-1 = failed) */
+    long long stamp_ms;          /* when value was taken, 0 = never */
+} g_nvsmi;
+
+/* -------------------- hwmon registry -------------------- */
+
+int gpu_sysfs_init(void) {
+    uevent_open();
+    return hwmon_scan();
+}
+
+/* Each path must still be a GPU hwmon's tempN_input, else it's a full scan */
+int gpu_sysfs_restore(const char paths[][GPU_SENSOR_PATH_MAX], int n) {
+    uevent_open();
+    hwmon_clear();
+    for (int i = 0; i < n && i < HWMON_MAX_SENSORS; i++) {
+        char dir[GPU_SENSOR_PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s", paths[i]);
+        char *slash = strrchr(dir, '/');
+        if (strncmp(paths[i], HWMON_ROOT "/", sizeof(HWMON_ROOT)) != 0 || !slash) return hwmon_scan();
+        *slash = 0;
+
+        int hwfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        int ok = hwfd >= 0 && hwmon_is_gpu(hwfd);
+        int tfd = ok ? openat(hwfd, slash + 1, O_RDONLY | O_CLOEXEC) : -1;
+        if (hwfd >= 0) close(hwfd);
+        if (tfd < 0) return hwmon_scan();
+        snprintf(g_hwmon.paths[g_hwmon.count], GPU_SENSOR_PATH_MAX, "%s", paths[i]);
+        g_hwmon.fds[g_hwmon.count++] = tfd;
+    }
+    if (g_hwmon.count == 0) return hwmon_scan();
+    g_hwmon.scanned = 1;
+    g_hwmon.dirty = 0;
+    return g_hwmon.count;
+}
+
+int gpu_sysfs_paths(char paths[][GPU_SENSOR_PATH_MAX], int max) {
+    int n = 0;
+    for (; n < g_hwmon.count && n < max; n++) memcpy(paths[n], g_hwmon.paths[n], GPU_SENSOR_PATH_MAX);
+    return n;
+}
+
+static void uevent_open(void) {
+    if (g_hwmon.uevent_fd < 0) {
+        /* Best effort: without uevents we still rescan once a sensor is gone */
+        int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_KOBJECT_UEVENT);
+        if (fd >= 0) {
+            struct sockaddr_nl sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.nl_family = AF_NETLINK;
+            sa.nl_groups = 1;    /* kernel uevent multicast group */
+            if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0) g_hwmon.uevent_fd = fd;
+            else close(fd);
+        }
+    }
+}
+
+int gpu_temp_sysfs(void) {
+    if (!g_hwmon.scanned) gpu_sysfs_init();
+    hwmon_poll_uevents();
+    if (g_hwmon.dirty) hwmon_scan();
+    if (g_hwmon.count == 0) return -1;
+
+    int best = -1;
+    if (hwmon_read_cached(&best) != 0) {
+        /* A sensor went away under us: rebuild once and retry; still gone
+           (mid-hotplug), the uevent that follows marks it dirty again */
+        hwmon_scan();
+        best = -1;
+        if (hwmon_read_cached(&best) != 0 && g_hwmon.uevent_fd < 0) g_hwmon.dirty = 1;
+    }
+    return best;
+}
+
+/* pread() every cached sensor; returns -1 if one of them is gone */
+static int hwmon_read_cached(int *best) {
+    int gone = 0;
+    for (int i = 0; i < g_hwmon.count; i++) {
+        char buf[32];
+        ssize_t r = pread(g_hwmon.fds[i], buf, sizeof(buf) - 1, 0);
+        if (r < 0 && (errno == ENODEV || errno == ENOENT || errno == ENXIO)) { gone = 1; continue; }
+        if (r <= 0) continue;           /* present but not answering: no reading */
+        buf[r] = 0;
+
+        int milli = atoi(buf);          /* millidegC */
+        if (milli > 0) {
+            int c = milli / 1000;       /* °C */
+            if (c > *best) *best = c;   /* pick the hottest as GPU temp */
+        }
+    }
+    return gone ? -1 : 0;
+}
+
+static void hwmon_clear(void) {
+    for (int i = 0; i < g_hwmon.count; i++) close(g_hwmon.fds[i]);
+    g_hwmon.count = 0;
+}
+
+int gpu_hwmon_name_is_gpu(const char *name) {
+    return strstr(name, "nvidia") || strstr(name, "amdgpu") ||
+           strstr(name, "i915")   || strstr(name, "xe") || strstr(name, "nouveau");
+}
+
+/* Does "<hwmon>/name" belong to a GPU driver? */
+static int hwmon_is_gpu(int hwfd) {
+    int namefd = openat(hwfd, "name", O_RDONLY | O_CLOEXEC);
+    if (namefd < 0) return 0;
+
+    char namebuf[64] = {0};
+    ssize_t n = read(namefd, namebuf, sizeof(namebuf) - 1);
+    close(namefd);
+    if (n <= 0) return 0;
+    for (ssize_t i = 0; i < n; i++) if (namebuf[i] == '\n') { namebuf[i] = 0; break; }
+
+    return gpu_hwmon_name_is_gpu(namebuf);
+}
+
+/* (Re)build the registry from /sys/class/hwmon; returns number of sensors */
+static int hwmon_scan(void) {
+    hwmon_clear();
+    g_hwmon.scanned = 1;
+    g_hwmon.dirty = 0;
+
+    DIR *d = opendir(HWMON_ROOT);
+    if (!d) return 0;
+
+    int rootfd = dirfd(d);
+    if (rootfd < 0) { closedir(d); return 0; }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL && g_hwmon.count < HWMON_MAX_SENSORS) {
+        if (strncmp(de->d_name, "hwmon", 5) != 0) continue;
+
+        int hwfd = openat(rootfd, de->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (hwfd < 0) continue;
+        if (!hwmon_is_gpu(hwfd)) { close(hwfd); continue; }
+
+        for (int i = 1; i <= HWMON_MAX_TEMPS && g_hwmon.count < HWMON_MAX_SENSORS; i++) {
+            char fn[32];
+            int m = snprintf(fn, sizeof(fn), "temp%d_input", i);
+            if (m < 0 || (size_t)m >= sizeof(fn)) continue;
+
+            int tfd = openat(hwfd, fn, O_RDONLY | O_CLOEXEC);
+            if (tfd < 0) continue;
+            m = snprintf(g_hwmon.paths[g_hwmon.count], GPU_SENSOR_PATH_MAX, "%s/%s/%s", HWMON_ROOT, de->d_name, fn);
+            if (m < 0 || m >= GPU_SENSOR_PATH_MAX) g_hwmon.paths[g_hwmon.count][0] = 0;   /* not restorable */
+            g_hwmon.fds[g_hwmon.count++] = tfd;
+        }
+
+        close(hwfd);
+    }
+
+    closedir(d);
+    return g_hwmon.count;
+}
+
+/* Drain pending uevents without blocking; any hwmon add/remove marks the registry dirty */
+static void hwmon_poll_uevents(void) {
+    if (g_hwmon.uevent_fd < 0) return;
+
+    char buf[4096];
+    for (;;) {
+        ssize_t n = recv(g_hwmon.uevent_fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) g_hwmon.dirty = 1;   /* dropped events: assume the worst */
+            return;
+        }
+        if (n == 0) return;
+        buf[n] = 0;
+
+        /* Payload: "action@devpath\0KEY=VALUE\0..." */
+        for (ssize_t off = 0; off < n; off += (ssize_t)strlen(buf + off) + 1) {
+            if (strcmp(buf + off, "SUBSYSTEM=hwmon") == 0) { g_hwmon.dirty = 1; break; }
+        }
+    }
+}
+
+/* ------------------------- NVML ------------------------- */
+
+/* dlopen libnvidia-ml, init once and keep the handle of GPU 0; 0 on success */
+static int nvml_load(void) {
+    g_nvml.tried = 1;
+
+    void *lib = dlopen("libnvidia-ml.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) lib = dlopen("libnvidia-ml.so", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) return -1;
+
+    /* dlsym returns void *; the union avoids the object/function pointer cast warning */
+    union { void *p; nvmlReturn_t (*init)(void); } u_init;
+    union { void *p; nvmlReturn_t (*handle)(unsigned int, nvmlDevice_t *); } u_handle;
+    union { void *p; nvmlReturn_t (*temp)(nvmlDevice_t, int, unsigned int *); } u_temp;
+    union { void *p; nvmlReturn_t (*shutdown)(void); } u_shutdown;
+    union { void *p; nvmlReturn_t (*util)(nvmlDevice_t, nvmlUtilization_t *); } u_util;
+
+    u_init.p     = dlsym(lib, "nvmlInit_v2");
+    u_handle.p   = dlsym(lib, "nvmlDeviceGetHandleByIndex_v2");
+    u_temp.p     = dlsym(lib, "nvmlDeviceGetTemperature");
+    u_shutdown.p = dlsym(lib, "nvmlShutdown");
+    u_util.p     = dlsym(lib, "nvmlDeviceGetUtilizationRates");
+    if (!u_init.p || !u_handle.p || !u_temp.p) { dlclose(lib); return -1; }
+
+    if (u_init.init() != NVML_SUCCESS) { dlclose(lib); return -1; }
+
+    nvmlDevice_t dev = NULL;
+    if (u_handle.handle(0, &dev) != NVML_SUCCESS) {
+        if (u_shutdown.p) u_shutdown.shutdown();
+        dlclose(lib);
+        return -1;
+    }
+
+    g_nvml.lib = lib;
+    g_nvml.dev = dev;
+    g_nvml.get_temp = u_temp.temp;
+    g_nvml.get_util = u_util.p ? u_util.util : NULL;
+    return 0;
+}
+
+int gpu_temp_nvml(void) {
+    if (!g_nvml.tried) nvml_load();
+    if (!g_nvml.lib) return -1;
+
+    unsigned int t = 0;
+    if (g_nvml.get_temp(g_nvml.dev, NVML_TEMPERATURE_GPU, &t) != NVML_SUCCESS) return -1;
+    if (t > 0 && t < 130) return (int)t;
+    return -1;
+}
+
+int gpu_util_nvml(void) {
+    if (!g_nvml.tried) nvml_load();
+    if (!g_nvml.lib || !g_nvml.get_util) return -1;
+
+    nvmlUtilization_t u;
+    if (g_nvml.get_util(g_nvml.dev, &u) != NVML_SUCCESS) return -1;
+    return (u.gpu <= 100) ? (int)u.gpu : -1;
+}
+
+/* ------------------- GPU utilization -------------------- */
+
+/* Open every card's gpu_busy_percent once (amdgpu, some i915/xe) */
+static void busy_scan(void) {
+    g_busy.scanned = 1;
+    DIR *d = opendir(DRM_ROOT);
+    if (!d) return;
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL && g_busy.count < DRM_MAX_BUSY) {
+        /* cardN only, not the cardN-<connector> entries */
+        if (strncmp(de->d_name, "card", 4) != 0 || strchr(de->d_name, '-')) continue;
+
+        char path[300];
+        snprintf(path, sizeof(path), DRM_ROOT "/%s/device/gpu_busy_percent", de->d_name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) g_busy.fds[g_busy.count++] = fd;
+    }
+    closedir(d);
+}
+
+int gpu_util_sysfs(void) {
+    if (!g_busy.scanned) busy_scan();
+
+    int best = -1;
+    for (int i = 0; i < g_busy.count; i++) {
+        char buf[16];
+        ssize_t r = pread(g_busy.fds[i], buf, sizeof(buf) - 1, 0);
+        if (r <= 0) continue;
+        buf[r] = 0;
+        int pct = atoi(buf);
+        if (pct > best) best = pct;       /* busiest GPU */
+    }
+    return (best > 100) ? 100 : best;
+}
+
+int gpu_temp_driver(int quiet) {
+    int t = gpu_temp_sysfs();
+    if (t > 0) return t;
+    t = gpu_temp_nvml();
+    if (t > 0) return t;
+    t = quiet ? -1 : gpu_temp_nvidia_smi();
+    return (t > 0) ? t : -1;
+}
+
+int gpu_util(void) {
+    int u = gpu_util_sysfs();
+    if (u >= 0) return u;
+    return gpu_util_nvml();
+}
+
+/* ---------------------- nvidia-smi ---------------------- */
+
+int gpu_temp_nvidia_smi(void) {
+    long long now = mono_ms();
+    if (g_nvsmi.stamp_ms != 0 && now - g_nvsmi.stamp_ms < NVSMI_CACHE_TTL_MS) return g_nvsmi.value;
+    g_nvsmi.stamp_ms = now;
+    g_nvsmi.value = gpu_temp_nvidia_smi_uncached();
+    return g_nvsmi.value;
+}
+
+int gpu_temp_nvidia_smi_uncached(void) {
+    if (!path_exists("/usr/bin/nvidia-smi")) return -1;
+    FILE *p = popen("/usr/bin/nvidia-smi --query-gpu=temperature.gpu --format=csv,noheader,nounits 2>/dev/null", "r");
+    if (!p) return -1;
+    char buf[64] = {0};
+    if (!fgets(buf, sizeof(buf), p)) { pclose(p); return -1; }
+    pclose(p);
+    int t = atoi(buf);
+    if (t > 0 && t < 130) return t;
+    return -1;
+}
+
+/* Small helpers */
+static int path_exists(const char *path) { return access(path, F_OK) == 0; }
@@ -0,0 +1,48 @@
+/*
+ * gpu.h
+ *
+ * GPU temperature sources (driver side). The EC fallback stays in main.c.
+ */
+
+#ifndef FAN_CONTROL_GPU_H
+#define FAN_CONTROL_GPU_H
+
+#define GPU_SENSOR_PATH_MAX   64
+#define GPU_MAX_SENSORS       32   /* hwmon registry size */
+
+/* Is this hwmon "name" a GPU driver's (nvidia, amdgpu, i915, xe, nouveau)?
+   The one classification for this registry and sensor.h's */
+int  gpu_hwmon_name_is_gpu(const char *name);
+
+/* Build the hwmon sensor registry; returns number of cached sensors */
+int  gpu_sysfs_init(void);
+
+/* Same from known sensor paths (a previous run's), scanning only if one of
+   them is gone or no longer a GPU's */
+int  gpu_sysfs_restore(const char paths[][GPU_SENSOR_PATH_MAX], int n);
+
+/* Paths of the cached sensors, up to max; returns the count */
+int  gpu_sysfs_paths(char paths[][GPU_SENSOR_PATH_MAX], int max);
+
+/* Hottest cached hwmon GPU sensor in °C, -1 if none */
+int  gpu_temp_sysfs(void);
+
+/* NVIDIA via libnvidia-ml (dlopen'ed on first use), -1 if unavailable */
+int  gpu_temp_nvml(void);
+
+/* Last resort for NVIDIA: nvidia-smi, cached for NVSMI_CACHE_TTL_MS */
+int  gpu_temp_nvidia_smi(void);
+
+/* Same, but always spawns nvidia-smi */
+int  gpu_temp_nvidia_smi_uncached(void);
+
+/* Hottest driver source: hwmon, then NVML, then nvidia-smi (skipped if quiet);
+   -1 if none. Not thread-safe: one caller at a time (gpumon.h) */
+int  gpu_temp_driver(int quiet);
+
+/* Utilization in %, -1 if unavailable: gpu_busy_percent, then NVML */
+int  gpu_util(void);
+int  gpu_util_sysfs(void);
+int  gpu_util_nvml(void);
+
+#endif /* FAN_CONTROL_GPU_H */
@@ -0,0 +1,153 @@
+/*
+ * gpumon.c
+ *
+ * The slot packs temperature, utilization and a CLOCK_MONOTONIC stamp in
+ * ms (low 32 bits; ages are taken modulo 2^32) into one uint64_t, so a
+ * reader never sees a torn sample and never takes a lock. The sensor
+ * lock only keeps the worker and gpumon_sample_now() out of gpu.c at the
+ * same time; the loop side only ever trylocks it.
+ */
+
+#include "gpumon.h"
+#include "gpu.h"
+#include "util.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+static void *gpumon_main(void *arg);
+static void  gpumon_publish(int temp_c, int util_pct);
+
+static struct {
+    pthread_t       thread;
+    pthread_mutex_t sensors;     /* held while inside gpu.c */
+    pthread_mutex_t lock;        /* protects the fields below, with wake */
+    pthread_cond_t  wake;
+    int             started;
+    int             stop;
+    int             paused;
+    int             period_ms;
+    uint64_t        slot;        /* stamp_ms << 32 | util << 16 | temp, 0 = none */
+} g_mon = {
+    .sensors = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+int gpumon_start(int period_ms) {
+    if (g_mon.started) return 0;
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_mon.wake, &ca);
+    pthread_condattr_destroy(&ca);
+
+    g_mon.stop = 0;
+    g_mon.period_ms = (period_ms > 0) ? period_ms : GPUMON_DEFAULT_PERIOD_MS;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, GPUMON_STACK_SIZE);
+    int rc = pthread_create(&g_mon.thread, &attr, gpumon_main, NULL);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) { pthread_cond_destroy(&g_mon.wake); errno = rc; return -1; }
+    g_mon.started = 1;
+    return 0;
+}
+
+void gpumon_stop(void) {
+    if (!g_mon.started) return;
+    pthread_mutex_lock(&g_mon.lock);
+    g_mon.stop = 1;
+    pthread_cond_signal(&g_mon.wake);
+    pthread_mutex_unlock(&g_mon.lock);
+    pthread_join(g_mon.thread, NULL);   /* at most one sample (nvidia-smi) away */
+    pthread_cond_destroy(&g_mon.wake);
+    g_mon.started = 0;
+}
+
+int gpumon_running(void) { return g_mon.started; }
+
+void gpumon_set_period(int period_ms) {
+    if (!g_mon.started) return;
+    pthread_mutex_lock(&g_mon.lock);
+    g_mon.period_ms = (period_ms > 0) ? period_ms : GPUMON_DEFAULT_PERIOD_MS;
+    pthread_mutex_unlock(&g_mon.lock);
+}
+
+void gpumon_pause(int paused) {
+    if (!g_mon.started) return;
+    pthread_mutex_lock(&g_mon.lock);
+    g_mon.paused = paused;
+    pthread_cond_signal(&g_mon.wake);
+    pthread_mutex_unlock(&g_mon.lock);
+}
+
+long gpumon_read(int *temp_c, int *util_pct) {
+    uint64_t v = __atomic_load_n(&g_mon.slot, __ATOMIC_ACQUIRE);
+    if (v == 0) { *temp_c = *util_pct = -1; return -1; }
+    *temp_c   = (int16_t)(v & 0xffff);
+    *util_pct = (int16_t)((v >> 16) & 0xffff);
+    return (long)(uint32_t)((uint32_t)mono_ms() - (uint32_t)(v >> 32));
+}
+
+int gpumon_sample_now(int quiet, int *temp_c, int *util_pct) {
+    if (pthread_mutex_trylock(&g_mon.sensors) != 0) return -1;
+    *temp_c = gpu_temp_driver(quiet);
+    *util_pct = gpu_util();
+    pthread_mutex_unlock(&g_mon.sensors);
+    return 0;
+}
+
+int gpumon_sensor_paths(char paths[][GPU_SENSOR_PATH_MAX], int max) {
+    if (pthread_mutex_trylock(&g_mon.sensors) != 0) return -1;
+    int n = gpu_sysfs_paths(paths, max);
+    pthread_mutex_unlock(&g_mon.sensors);
+    return n;
+}
+
+static void gpumon_publish(int temp_c, int util_pct) {
+    uint64_t v = ((uint64_t)(uint32_t)mono_ms() << 32) |
+                 ((uint64_t)(uint16_t)(int16_t)util_pct << 16) |
+                 (uint64_t)(uint16_t)(int16_t)temp_c;
+    __atomic_store_n(&g_mon.slot, v, __ATOMIC_RELEASE);
+}
+
+/* Drift-free period on an absolute CLOCK_MONOTONIC deadline; a slow sample
+   (nvidia-smi) skips the deadlines it missed instead of catching up */
+static void *gpumon_main(void *arg) {
+    (void)arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    pthread_mutex_lock(&g_mon.lock);
+    while (!g_mon.stop) {
+        if (g_mon.paused) {
+            pthread_cond_wait(&g_mon.wake, &g_mon.lock);
+            clock_gettime(CLOCK_MONOTONIC, &next);
+            continue;
+        }
+        pthread_mutex_unlock(&g_mon.lock);
+
+        pthread_mutex_lock(&g_mon.sensors);
+        int t = gpu_temp_driver(0);
+        int u = gpu_util();
+        pthread_mutex_unlock(&g_mon.sensors);
+        gpumon_publish(t, u);
+
+        pthread_mutex_lock(&g_mon.lock);
+        long long period_ns = (long long)g_mon.period_ms * 1000000;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long now_ns = (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+        long long next_ns = (long long)next.tv_sec * 1000000000 + next.tv_nsec + period_ns;
+        if (next_ns <= now_ns) next_ns = now_ns + period_ns;
+        next.tv_sec = (time_t)(next_ns / 1000000000);
+        next.tv_nsec = (long)(next_ns % 1000000000);
+        while (!g_mon.stop && !g_mon.paused &&
+               pthread_cond_timedwait(&g_mon.wake, &g_mon.lock, &next) != ETIMEDOUT) { }
+    }
+    pthread_mutex_unlock(&g_mon.lock);
+    return NULL;
+}
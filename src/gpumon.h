@@ -0,0 +1,43 @@
+/*
+ * gpumon.h
+ *
+ * GPU sampling off the control thread. A hwmon rescan, an NVML call or an
+ * nvidia-smi spawn can take far longer than the rest of a cycle, so a
+ * worker thread samples temperature and utilization on its own period and
+ * publishes the latest values with their time through one atomic word.
+ * The control loop reads that without blocking and treats an old sample
+ * as stale (then the EC's GPU temperature stands in).
+ */
+
+#ifndef FAN_CONTROL_GPUMON_H
+#define FAN_CONTROL_GPUMON_H
+
+#include "gpu.h"
+
+#define GPUMON_DEFAULT_PERIOD_MS  500
+#define GPUMON_DEFAULT_STALE_MS   3000     /* older samples are not used */
+#define GPUMON_STACK_SIZE         (256 * 1024)   /* mlockall() locks it whole */
+
+/* Start the worker (gpu_sysfs_init() done); 0 or -1/errno */
+int  gpumon_start(int period_ms);
+void gpumon_stop(void);
+int  gpumon_running(void);
+
+void gpumon_set_period(int period_ms);
+
+/* Paused: no wakeups and no GPU access at all (idle profile) */
+void gpumon_pause(int paused);
+
+/* Latest published sample (temp -1 / util -1 if that source is unavailable);
+   returns its age in ms, -1 if nothing was published yet */
+long gpumon_read(int *temp_c, int *util_pct);
+
+/* Sample on the calling thread (worker paused or not started): quiet skips
+   nvidia-smi. -1 if the worker is still inside a sample - never blocks */
+int  gpumon_sample_now(int quiet, int *temp_c, int *util_pct);
+
+/* gpu_sysfs_paths() with the worker kept out of gpu.c (it may be
+   rescanning); -1 if it is inside a sample right now - never blocks */
+int  gpumon_sensor_paths(char paths[][GPU_SENSOR_PATH_MAX], int max);
+
+#endif /* FAN_CONTROL_GPUMON_H */
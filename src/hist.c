@@ -0,0 +1,36 @@
+/*
+ * hist.c
+ *
+ * Reporting side of the log2 histograms; adding samples is inline in hist.h.
+ */
+
+#include "hist.h"
+
+uint64_t hist_quantile(const struct hist *h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)h->count + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += h->bucket[b];
+        if (seen >= rank) {
+            uint64_t edge = (2ULL << b) - 1;
+            return (edge < h->max) ? edge : h->max;  /* never report past the real max */
+        }
+    }
+    return h->max;
+}
+
+void hist_print_header(FILE *out) {
+    fprintf(out, "%-10s %10s %10s %10s %10s %10s\n", "phase", "n", "avg_us", "p50_us", "p99_us", "max_us");
+}
+
+void hist_print(FILE *out, const char *name, const struct hist *h) {
+    unsigned long long avg = h->count ? (unsigned long long)(h->sum / h->count) : 0;
+    fprintf(out, "%-10s %10llu %10llu %10llu %10llu %10llu\n", name,
+            (unsigned long long)h->count, avg,
+            (unsigned long long)hist_quantile(h, 0.50),
+            (unsigned long long)hist_quantile(h, 0.99),
+            (unsigned long long)h->max);
+}
@@ -0,0 +1,39 @@
+/*
+ * hist.h
+ *
+ * Fixed-size log2 latency histograms for the hot path (no allocation).
+ * Bucket b counts values in [2^b, 2^(b+1)) microseconds; bucket 0 also holds 0.
+ */
+
+#ifndef FAN_CONTROL_HIST_H
+#define FAN_CONTROL_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HIST_BUCKETS 26           /* up to ~33 s, everything above lands in the last one */
+
+struct hist {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint32_t bucket[HIST_BUCKETS];
+};
+
+static inline void hist_add(struct hist *h, uint64_t us) {
+    int b = (us > 1) ? 63 - __builtin_clzll(us) : 0;
+    if (b >= HIST_BUCKETS) b = HIST_BUCKETS - 1;
+    h->bucket[b]++;
+    h->count++;
+    h->sum += us;
+    if (us > h->max) h->max = us;
+}
+
+/* Upper edge of the bucket holding quantile q (0..1), in microseconds */
+uint64_t hist_quantile(const struct hist *h, double q);
+
+/* One aligned row: name, n, avg, p50, p99, max */
+void     hist_print_header(FILE *out);
+void     hist_print(FILE *out, const char *name, const struct hist *h);
+
+#endif /* FAN_CONTROL_HIST_H */
@@ -0,0 +1,79 @@
+/*
+ * load.c
+ *
+ * CPU utilization from the aggregate "cpu" line of /proc/stat: the fd stays
+ * open, each sample is one pread() and the jiffies are diffed against the
+ * previous one. GPU utilization is sampled by the caller (gpumon.h).
+ */
+
+#include "load.h"
+#include "util.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define PROC_STAT_PATH  "/proc/stat"
+
+static int stat_read(int fd, unsigned long long *busy, unsigned long long *total);
+
+int load_init(struct load *l) {
+    l->stat_fd = open(PROC_STAT_PATH, O_RDONLY | O_CLOEXEC);
+    l->busy = l->total = 0;
+    l->last_us = 0;
+    l->cpu_pct = l->gpu_pct = -1;
+    l->cpu_avg = l->gpu_avg = 0.0;
+    if (l->stat_fd >= 0) stat_read(l->stat_fd, &l->busy, &l->total);
+    return (l->stat_fd >= 0) ? 0 : -1;
+}
+
+void load_close(struct load *l) {
+    if (l->stat_fd >= 0) close(l->stat_fd);
+    l->stat_fd = -1;
+}
+
+void load_sample(struct load *l, double tau_s, long long now_us, int gpu_pct) {
+    unsigned long long busy, total;
+    l->cpu_pct = -1;
+    if (l->stat_fd >= 0 && stat_read(l->stat_fd, &busy, &total) == 0) {
+        if (total > l->total && busy >= l->busy)
+            l->cpu_pct = (int)((busy - l->busy) * 100 / (total - l->total));
+        l->busy = busy;
+        l->total = total;
+    }
+    l->gpu_pct = gpu_pct;
+
+    /* Time-based EMA: the period is adaptive, so weight by the real gap */
+    double dt = l->last_us ? (double)(now_us - l->last_us) / 1e6 : 0.0;
+    double alpha = (dt > 0.0) ? dt / (tau_s + dt) : 0.0;
+    if (l->cpu_pct >= 0) l->cpu_avg += alpha * (l->cpu_pct - l->cpu_avg);
+    if (l->gpu_pct >= 0) l->gpu_avg += alpha * (l->gpu_pct - l->gpu_avg);
+    l->last_us = now_us;
+}
+
+int load_ff_duty(const struct ff_params *k, double load_pct, int min_duty_pct) {
+    if (k->weight <= 0.0 || load_pct < k->threshold_pct) return 0;
+
+    double span = 100.0 - k->threshold_pct;
+    double frac = (span > 0.0) ? (load_pct - k->threshold_pct) / span : 1.0;
+    double duty = min_duty_pct + (k->max_duty_pct - min_duty_pct) * frac;
+    return clamp((int)(k->weight * duty + 0.5), 0, 100);
+}
+
+/* "cpu  user nice system idle iowait irq softirq steal ..." -> busy/total */
+static int stat_read(int fd, unsigned long long *busy, unsigned long long *total) {
+    char buf[256];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = 0;
+
+    unsigned long long v[8] = { 0 };
+    if (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 4) return -1;
+
+    unsigned long long sum = 0;
+    for (int i = 0; i < 8; i++) sum += v[i];
+    *total = sum;
+    *busy = sum - v[3] - v[4];    /* minus idle and iowait */
+    return 0;
+}
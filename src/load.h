@@ -0,0 +1,45 @@
+/*
+ * load.h
+ *
+ * CPU/GPU utilization as a feed-forward input: temperature lags load by
+ * seconds, so sustained load pre-spins the fans before the curve reacts.
+ */
+
+#ifndef FAN_CONTROL_LOAD_H
+#define FAN_CONTROL_LOAD_H
+
+/* Defaults, overridable in the config file (ff_* keys) */
+#define FF_DEFAULT_WEIGHT     1.0    /* 0 disables the feed-forward */
+#define FF_DEFAULT_THRESHOLD  40     /* sustained load (%) where pre-spinning starts */
+#define FF_DEFAULT_MAX_DUTY   60     /* duty at 100% sustained load */
+#define FF_DEFAULT_TAU_S      3.0    /* "sustained": EMA time constant */
+
+struct ff_params {
+    double weight;
+    int    threshold_pct;
+    int    max_duty_pct;
+    double tau_s;
+};
+
+struct load {
+    int                stat_fd;       /* /proc/stat, kept open, -1 if unavailable */
+    unsigned long long busy, total;   /* jiffies at the previous sample */
+    long long          last_us;
+    int                cpu_pct;       /* instantaneous, -1 = unknown */
+    int                gpu_pct;
+    double             cpu_avg;       /* sustained (EMA) */
+    double             gpu_avg;
+};
+
+int  load_init(struct load *l);
+void load_close(struct load *l);
+
+/* Diff /proc/stat since the last call, take the GPU utilization sampled by
+   the caller (-1: unknown, keeps the average) and update the sustained
+   averages (time constant tau_s) */
+void load_sample(struct load *l, double tau_s, long long now_us, int gpu_pct);
+
+/* Feed-forward duty for a sustained load (0 below the threshold) */
+int  load_ff_duty(const struct ff_params *k, double load_pct, int min_duty_pct);
+
+#endif /* FAN_CONTROL_LOAD_H */
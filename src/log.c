@@ -0,0 +1,131 @@
+/*
+ * log.c
+ *
+ * Each event is formatted into one buffer and written with a single
+ * write(), so lines from different sources never interleave and the
+ * journal sees exactly one record per event.
+ */
+
+#include "log.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct { int level, format, live; } g_log = { LOG_INFO, LOG_FMT_HUMAN, 0 };
+
+static const char *const g_level_names[] = { "error", "warn", "info", "debug" };
+static const char *const g_format_names[] = { "human", "kv", "json" };
+
+static size_t emit_json_fields(char *out, size_t cap, size_t len, const char *fields);
+static size_t append(char *out, size_t cap, size_t len, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+void log_setup(int level, int format) {
+    g_log.level = level;
+    g_log.format = format;
+}
+
+int log_enabled(int level) { return level <= g_log.level; }
+
+void log_set_live(int on) { g_log.live = on && isatty(STDERR_FILENO); }
+
+int log_level_from_name(const char *name) {
+    for (int i = 0; i < (int)(sizeof(g_level_names) / sizeof(g_level_names[0])); i++)
+        if (strcmp(name, g_level_names[i]) == 0) return i;
+    return -1;
+}
+
+int log_format_from_name(const char *name) {
+    for (int i = 0; i < (int)(sizeof(g_format_names) / sizeof(g_format_names[0])); i++)
+        if (strcmp(name, g_format_names[i]) == 0) return i;
+    return -1;
+}
+
+void log_event(int level, const char *event, const char *fmt, ...) {
+    if (!log_enabled(level)) return;
+
+    char fields[LOG_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(fields, sizeof(fields), fmt, ap);
+    va_end(ap);
+
+    char line[LOG_LINE_MAX * 2];
+    size_t len = g_log.live ? append(line, sizeof(line), 0, "\r\033[K") : 0;
+    if (g_log.format == LOG_FMT_HUMAN) {
+        len = append(line, sizeof(line), len, "%s%s: %s\n",
+                     level <= LOG_WARN ? (level == LOG_ERROR ? "ERROR " : "WARNING ") : "",
+                     event, fields);
+    } else {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        struct tm tm;
+        gmtime_r(&ts.tv_sec, &tm);
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm);
+
+        if (g_log.format == LOG_FMT_KV) {
+            len = append(line, sizeof(line), len, "ts=%s.%03ldZ level=%s event=%s %s\n",
+                         when, ts.tv_nsec / 1000000, g_level_names[level], event, fields);
+        } else {
+            len = append(line, sizeof(line), len, "{\"ts\":\"%s.%03ldZ\",\"level\":\"%s\",\"event\":\"%s\"",
+                         when, ts.tv_nsec / 1000000, g_level_names[level], event);
+            len = emit_json_fields(line, sizeof(line) - 2, len, fields);
+            len = append(line, sizeof(line), len, "}\n");
+        }
+    }
+    if (len > 0 && write(STDERR_FILENO, line, len) < 0) { /* nowhere left to report it */ }
+}
+
+/* key=value key="quoted value" ... -> ,"key":value,... */
+static size_t emit_json_fields(char *out, size_t cap, size_t len, const char *p) {
+    while (*p) {
+        while (*p == ' ') p++;
+        if (!*p) break;
+
+        const char *key = p;
+        while (*p && *p != '=' && *p != ' ') p++;
+        size_t klen = (size_t)(p - key);
+        if (*p != '=') {                         /* bare word: not a field */
+            len = append(out, cap, len, ",\"msg\":\"%.*s\"", (int)klen, key);
+            continue;
+        }
+        p++;
+
+        char val[LOG_LINE_MAX];
+        size_t vlen = 0;
+        int quoted = (*p == '"');
+        if (quoted) {
+            p++;
+            while (*p && *p != '"' && vlen < sizeof(val) - 2) {
+                if (*p == '\\' && p[1]) val[vlen++] = *p++;
+                val[vlen++] = *p++;
+            }
+            if (*p == '"') p++;
+        } else {
+            while (*p && *p != ' ' && vlen < sizeof(val) - 1) val[vlen++] = *p++;
+        }
+        val[vlen] = 0;
+
+        // Plain decimal numbers only: strtod would also take inf, nan, 0x...
+        char *end;
+        strtod(val, &end);
+        int numeric = !quoted && vlen > 0 && *end == 0 && strspn(val, "0123456789.eE+-") == vlen;
+        len = append(out, cap, len, numeric ? ",\"%.*s\":%s" : ",\"%.*s\":\"%s\"", (int)klen, key, val);
+    }
+    return len;
+}
+
+static size_t append(char *out, size_t cap, size_t len, const char *fmt, ...) {
+    if (len >= cap) return len;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(out + len, cap - len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return len;
+    return ((size_t)n < cap - len) ? len + (size_t)n : cap - 1;
+}
@@ -0,0 +1,33 @@
+/*
+ * log.h
+ *
+ * Leveled, structured event log on stderr (the journal under systemd).
+ * Events are "name key=value ..." and can be rendered for humans, as
+ * logfmt-style key=value, or as one JSON object per line.
+ */
+
+#ifndef FAN_CONTROL_LOG_H
+#define FAN_CONTROL_LOG_H
+
+enum { LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG };
+enum { LOG_FMT_HUMAN, LOG_FMT_KV, LOG_FMT_JSON };
+
+#define LOG_LINE_MAX  512
+
+void log_setup(int level, int format);
+int  log_enabled(int level);
+
+/* A live status line ("...\r") is being redrawn on the terminal: clear it
+   before each event so the two don't mix (only if stderr is a TTY too) */
+void log_set_live(int on);
+
+/* fmt renders the fields: "fan=%d from=%d to=%d"; quote values with spaces
+   ("reason=\"%s\""). Numbers stay numbers in JSON. */
+void log_event(int level, const char *event, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Names for the config file; -1 if unknown */
+int  log_level_from_name(const char *name);   /* error, warn, info, debug */
+int  log_format_from_name(const char *name);  /* human, kv, json */
+
+#endif /* FAN_CONTROL_LOG_H */
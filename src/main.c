@@ -5,133 +5,437 @@
  *   set  <0..100>   - Set both fans to the same duty
  *   set1 <0..100>   - Set CPU (fan1/right) duty
  *   set2 <0..100>   - Set GPU (fan2/left) duty
- *   dump            - Show CPU/GPU temps and each fan's duty/RPM
- *   auto            - Auto mode: adjust EACH fan from its own temp (independent)
+ *   dump [-v]       - Show CPU/GPU temps and each fan's duty/RPM (-v: EC wait counters)
+ *   auto            - Auto mode: each fan follows its curve (or a PID loop with
+ *                     --controller=pid) on the hotter of CPU/GPU, or with
+ *                     --independent on its own side's temp and load (plus a
+ *                     coupling share of the other side's excess);
+ *                     period adapts between --min-interval and --max-interval;
+ *                     --realtime[=PRIO] [--cpu=N] for SCHED_FIFO, locked memory, pinning;
+ *                     --profile=idle (automatic on battery) for few, coarse wakeups
+ *   daemon          - Auto mode as the single EC owner, serving the control socket
+ *                     (auto/daemon report state changes through log.h; auto
+ *                     also keeps a live status line when stdout is a TTY)
+ *   stats           - Per-phase loop timings from the running daemon (or SIGUSR1 to it)
+ *   bench           - Latency of EC reads per backend, GPU sensors, timer wakeup
+ *                     jitter and a full auto cycle; read-only unless --writes
+ *   export          - Recorded trace (rec.h, REC_DIR) as CSV, --from/--to a time range
+ *   calibrate       - Sweep each fan's duty and store its duty->RPM table and
+ *                     start/stall thresholds (calib.h) for fan_target = rpm
+ *   simulate        - The control loop against a thermal model (sim.h), driven by
+ *                     synthetic load profiles or a recorded trace; metrics per
+ *                     profile and controller, optionally checked against a baseline
+ *   sensors         - Every temperature sensor (sensor.h) with its reading, and
+ *                     the config's zones (zone.h) built from them
+ *
+ * While a daemon (or auto) runs, dump/set/set1/set2/sensors are answered by it over
+ * CTL_SOCKET_PATH; "auto" then hands manually set fans back to the curve.
+ * Every sample is also published to the /dev/shm telemetry ring (telemetry.h)
+ * and appended to the long-term trace files (rec.h).
+ *
+ * Options (before the command):
+ *   --ec=<backend>  - EC transport: auto (default), ec_sys, ioperm, acpi_call
+ *   --config=<path> - curves and tuning (default CONFIG_PATH, see config.c)
  *
  * DISCLAIMER: Direct EC access can be risky. You assume responsibility.
 
  */
 
-#include <dirent.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/io.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "board.h"
+#include "breaker.h"
+#include "calib.h"
+#include "config.h"
+#include "control.h"
+#include "ctl.h"
+#include "curve.h"
+#include "ec.h"
+#include "filter.h"
+#include "gpu.h"
+#include "gpumon.h"
+#include "hist.h"
+#include "load.h"
+#include "log.h"
+#include "pid.h"
+#include "power.h"
+#include "rec.h"
+#include "rt.h"
+#include "sampler.h"
+#include "sensor.h"
+#include "spin.h"
+#include "state.h"
+#include "sim.h"
+#include "telemetry.h"
+#include "throttle.h"
+#include "util.h"
+#include "zone.h"
+
 /* --- Program name --- */
 #define NAME "fan-cli"
 
-/* --- EC I/O ports and commands --- */
-#define EC_SC 0x66
-#define EC_DATA 0x62
-#define IBF 1
-#define OBF 0
-#define EC_SC_READ_CMD 0x80
-
-/* --- Common EC register layout (typical Clevo) --- */
-#define EC_REG_SIZE           0x100
-#define EC_REG_CPU_TEMP       0x07
-#define EC_REG_GPU_TEMP       0xCD
-#define EC_REG_FAN1_DUTY      0xCE
-#define EC_REG_FAN2_DUTY      0xCF
-#define EC_REG_FAN1_RPM_HI    0xD0
-#define EC_REG_FAN1_RPM_LO    0xD1
-#define EC_REG_FAN2_RPM_HI    0xD2
-#define EC_REG_FAN2_RPM_LO    0xD3
-
-/* --- Conversions / curve params --- */
-#define MAX_FAN_RPM           4400.0
-#define MIN_FAN_DUTY_PCT      20     /* lower end % - anything below 16% and the fan will not start sometimes */
-#define AUTO_MIN_TEMP_C       40     /* run fan above this */
-#define AUTO_MAX_TEMP_C       80     /* 100% at/above this */
-#define AUTO_MAX_STEP         5      /* max % change per cycle for smoothing */
-#define MIN_DEADBAND_C        2      /* hysteresis around AUTO_MIN_TEMP_C */
-#define STEP_PCT              2      /* % per iteration (400 ms) */
+/* --- bench --- */
+#define BENCH_ITERATIONS      200
+#define BENCH_SLOW_DIVISOR    10     /* nvidia-smi etc. run iterations/10 times (at least 3) */
+#define BENCH_WAKEUP_MS       10     /* timer period for the wakeup jitter test */
+#define BENCH_NS_BUF          24     /* fmt_ns(): any long long plus "ns" */
+
+/* --- calibrate --- */
+#define CALIBRATE_POLL_MS     500    /* RPM read interval while settling */
+#define CALIBRATE_SETTLE_MS   8000   /* give up waiting for a steady RPM after this */
+#define CALIBRATE_STABLE_PCT  3      /* steady: within this of the previous read ... */
+#define CALIBRATE_STABLE_READS 3     /* ... this many times in a row */
+#define CALIBRATE_EDGE_MS     4000   /* start/stall search: wait per 1% step */
+
+/* Curves, step, deadband etc. come from the config file (config.h for the defaults) */
+
+/* --- Auto mode --- */
+struct auto_opts {
+    int min_ms, max_ms;      /* sampler bounds, -1 = from the config */
+    int daemon;              /* control socket required, no status line */
+    const char *config;      /* --config, NULL = CONFIG_PATH (optional); watched for changes */
+    int controller;          /* --controller=, -1 = from the config */
+    int independent;         /* --independent, -1 = from the config */
+    int rt_priority;         /* --realtime[=PRIO], 0 = off */
+    int rt_cpu;              /* --cpu=N, -1 = no pinning */
+    int profile;             /* --profile=, -1 = from the config */
+};
+
+/* --- simulate --- */
+struct sim_opts {
+    const char *profile;      /* NULL / "all": every synthetic profile */
+    const char *trace;        /* recorded trace dir instead of the profiles */
+    int64_t from_ms, to_ms;   /* trace range */
+    int controller;           /* -1: both */
+    int independent;
+    double threshold_c;       /* "too hot" for above_s, < 0: max_temp - 5 */
+    int noise;
+    const char *baseline;     /* compare; regressions fail the command */
+    const char *save;         /* write this run as the new baseline */
+};
+
+/* Per-phase timing of the auto loop (fixed size, filled on the hot path) */
+enum { PH_SENSE, PH_DECIDE, PH_ACTUATE, PH_TELEMETRY, PH_OVERSHOOT, PH_CYCLE, PH_COUNT };
+static const char *const g_phase_names[PH_COUNT] = {
+    "sense", "decide", "actuate", "telemetry", "overshoot", "cycle"
+};
+#define AUTO_SLOW_CYCLE_US    100000  /* cycles (sense..telemetry) above this count as slow */
+
+struct auto_stats {
+    struct hist phase[PH_COUNT];
+    uint64_t    slow_cycles;
+    uint64_t    gpu_stale;           /* cycles that fell back to the EC GPU temp */
+    long long   last_step_us;        /* previous decision (rpm trim timing) */
+    long long   started_us;
+    double      rate_hz;             /* current sampling rate */
+};
+
+/* What the event log last reported, so only changes are logged, plus the
+   running summary (cfg->log_summary_s) */
+struct auto_events {
+    int duty[2];             /* last applied duty per fan, -1 = none yet */
+    int hot;                 /* at/above max_temp */
+    int throttling;          /* boost active */
+    int ec_err;              /* EC access failing */
+    int gpu_stale;           /* GPU samples late, EC temp standing in */
+    unsigned long ec_errors; /* failed cycles since start */
+    long long summary_us;    /* start of the current summary interval */
+    unsigned long cycles;
+    int th_min, th_max;
+    long long th_sum;
+    int duty_min[2], duty_max[2];
+};
+
+/* Loop state, also read/changed by control socket requests between cycles */
+struct auto_state {
+    const struct config *cfg;
+    struct control ctl;      /* the decision: controller, per-fan inputs, targets, duties */
+    int profile;             /* PROFILE_* setting */
+    int idle;                /* idle profile in effect (few wakeups, no GPU wakeups, no output) */
+    struct ec_snapshot snap; /* latest sample */
+    int tc, tg;              /* CPU / GPU temp used with it */
+    int gpu_async;           /* GPU sampled by the gpumon worker (normal profile) */
+    int gpu_stale;           /* no fresh GPU sample this cycle: tg is the EC's */
+    struct load load;        /* CPU/GPU utilization */
+    struct throttle thr;     /* CPU throttle counters / clock */
+    struct calib calib;      /* CALIB_PATH, for fan_target = rpm */
+    double trim[2];          /* rpm mode: duty correction per fan (wear, dust) */
+    long long airflow_since[2];   /* rpm mode: when the airflow target last changed */
+    int airflow[2];
+    struct spin spin[2];     /* start kick, stall watch */
+    struct filter filter[2]; /* CPU, GPU temperature conditioning */
+    int tg_driver;           /* this cycle's driver GPU temp, -1 = none (sensor gpu/driver) */
+    int zone_t[ZONE_MAX];    /* per cfg->zone[], filtered; -1 = no reading */
+    struct filter zfilter[ZONE_MAX];
+    int duty[2];             /* applied per fan */
+    int hold[2];             /* manual duty per fan (set/set1/set2), -1 = follow the curve */
+    int ec_err;              /* this cycle's EC read or write failed */
+    int ec_skipped;          /* breaker open: this cycle left the EC alone */
+    struct breaker brk;
+    long long suspended_ms;  /* CLOCK_BOOTTIME - CLOCK_MONOTONIC at the last cycle */
+    long long saved_us;      /* last checkpoint */
+    int state_err;           /* checkpoint write failed (reported once) */
+    struct auto_events ev;
+    struct auto_stats stats;
+};
 
 /* --- Prototypes --- */
-static int   ec_init(void);
-static int   ec_io_wait(const uint32_t port, const uint32_t flag, const char value);
-static uint8_t ec_io_read(const uint32_t port);
-static int   ec_io_do(const uint32_t cmd, const uint32_t port, const uint8_t value);
-
-static int   cpu_temp_ec(void);
-static int   gpu_temp(void);         /* driver (sysfs/nvidia-smi) first, then EC fallback */
-
-static int   fan1_duty_read(void);
-static int   fan2_duty_read(void);
-static int   fan1_rpm_read(void);
-static int   fan2_rpm_read(void);
-static int   fan1_duty_write(int pct);
-static int   fan2_duty_write(int pct);
-
-static int   dump_status(void);
+static int   gpu_temp(const struct ec_snapshot *snap, int quiet);  /* driver (sysfs/NVML/nvidia-smi) first, then EC fallback */
+
+static void  print_status(FILE *out, const struct ec_snapshot *snap, int tg);
+static int   dump_status(int verbose);
 static int   cmd_set_both(int pct);
 static int   cmd_set1(int pct);
 static int   cmd_set2(int pct);
-static int   cmd_auto(void);
-
-static int   clamp(int v, int lo, int hi);
-static int   rpm_from_raw(int hi, int lo);
-static int   path_exists(const char *path);
-static int   gpu_temp_sysfs(void);
-static int   gpu_temp_nvidia_smi(void);
+static void  auto_step(struct auto_state *st, int actuate);
+static void  print_auto_stats(FILE *out, const struct auto_state *st);
+static int   cmd_auto(const struct auto_opts *opts);
+static void  auto_reload(struct auto_state *st, struct sampler *smp, const struct auto_opts *opts);
+static void  auto_profile(struct auto_state *st, struct sampler *smp, const struct auto_opts *opts, int force);
+static void  auto_log(struct auto_state *st, long long now_us);
+static void  auto_log_summary(struct auto_state *st, long long now_us);
+static void  auto_restore(struct auto_state *st, const struct state *ck);
+static void  auto_resume(struct auto_state *st, long long slept_ms);
+static void  auto_checkpoint(struct auto_state *st);
+static void  auto_zones(struct auto_state *st, struct config *cfg);
+static void  print_sensors(FILE *out, const struct config *cfg, const int *zone_t);
+static int   cmd_sensors(struct config *cfg);
+static int   cmd_calibrate(const struct config *cfg, int fan_mask);
+static int   cmd_export(const char *dir, int64_t from_ms, int64_t to_ms);
+static int   parse_when(const char *s, int64_t *out_ms);
+static int   cmd_simulate(const struct config *cfg, const struct sim_opts *so);
+static int   cmd_bench(const struct config *cfg, const char *transport, int iterations, int writes,
+                       int rt_priority, int rt_cpu);
+static void  rt_setup(int priority, int cpu);
+static int   load_config(const char *path, struct config *cfg);
+static const struct board_profile *select_board(const char *name);
+static int   board_writable(const char *cmd);
+static int   ctl_forward(int argc, char *argv[]);
+static int   ctl_handle(void *ctx, const char *req, int privileged, FILE *out);
+
+static struct config g_cfg[2];   /* active + spare: reloads parse into the one not in use */
 
 static volatile sig_atomic_t g_stop = 0;
+static volatile sig_atomic_t g_dump_stats = 0;
 static void on_sigint(int sig){ (void)sig; g_stop = 1; }
+static void on_sigusr1(int sig){ (void)sig; g_dump_stats = 1; }
 
 /* ------------------------- MAIN ------------------------- */
 
 int main(int argc, char *argv[]) {
+    /* Global options before the command */
+    const char *transport = NULL;   /* --ec=<backend>, default auto */
+    const char *config = NULL;      /* --config=<path>, default CONFIG_PATH (optional) */
+    const char *board = NULL;       /* --board=<profile>, default from DMI */
+    while (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strncmp(argv[1], "--ec=", 5) == 0)           transport = argv[1] + 5;
+        else if (strncmp(argv[1], "--config=", 9) == 0)  config = argv[1] + 9;
+        else if (strncmp(argv[1], "--board=", 8) == 0)   board = argv[1] + 8;
+        else { fprintf(stderr, "Unknown option: %s\n", argv[1]); return EXIT_FAILURE; }
+        argv++; argc--;
+    }
+
     if (argc < 2) {
         fprintf(stderr,
-            "Usage: %s <command>\n"
+            "Usage: %s [--ec=auto|ec_sys|ioperm|acpi_call] [--config=PATH] [--board=auto|NAME] <command>\n"
             "Commands:\n"
             "  set  <0..100>   Set BOTH fans\n"
             "  set1 <0..100>   Set CPU fan\n"
             "  set2 <0..100>   Set GPU fan\n"
-            "  dump            Show CPU/GPU temps and fan status\n"
-            "  auto            Auto mode (independent control)\n",
-            NAME);
+            "  dump [-v]       Show CPU/GPU temps and fan status (-v: EC wait stats)\n"
+            "  auto [--min-interval=MS] [--max-interval=MS] [--controller=curve|pid] [--independent]\n"
+            "       [--realtime[=PRIO]] [--cpu=N] [--profile=auto|normal|idle]\n"
+            "                  Auto mode (curves from %s), adaptive period (default 200..5000 ms)\n"
+            "  daemon [...]    Auto mode as the only EC owner, with control socket\n"
+            "  stats           Per-phase loop timings of the running daemon (also: kill -USR1)\n"
+            "  bench [--iterations N] [--writes] [--realtime] [--cpu N]\n"
+            "                  Latency of every sensor/actuator path (read-only unless --writes)\n"
+            "  calibrate [--fan=1|2]\n"
+            "                  Measure duty->RPM and start/stall duty per fan (for fan_target = rpm)\n"
+            "  export [--from=T] [--to=T] [--dir=DIR]\n"
+            "                  Recorded samples as CSV; T: unix time or -30m/-2h/-7d (from now)\n"
+            "  simulate [--profile=step|burst|ramp|game|all] [--trace[=DIR]] [--from=T] [--to=T]\n"
+            "       [--controller=curve|pid] [--independent] [--threshold=C] [--noise]\n"
+            "       [--baseline=FILE] [--save-baseline=FILE]\n"
+            "                  Replay the config's control loop on a thermal model, faster than real time\n"
+            "  sensors         Temperature sensors for zones (zone.NAME in the config), and the zones\n",
+            NAME, CONFIG_PATH);
         return EXIT_FAILURE;
     }
 
-    if (ec_init() != 0) {
+    /* A running daemon owns the EC: answer through it, no EC access here */
+    int fwd = ctl_forward(argc, argv);
+    if (fwd >= 0) return fwd;
+
+    /* EC layout of this model: once, before any EC access */
+    if (strcmp(argv[1], "export") != 0 && strcmp(argv[1], "simulate") != 0) {
+        const struct board_profile *b = select_board(board);
+        if (!b) return EXIT_FAILURE;
+        ec_set_board(b);
+    }
+
+    /* bench opens every backend itself */
+    if (strcmp(argv[1], "bench") == 0) {
+        int iterations = BENCH_ITERATIONS, writes = 0, rt_priority = 0, rt_cpu = -1;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--writes") == 0)                 writes = 1;
+            else if (strcmp(argv[i], "--realtime") == 0)               rt_priority = RT_DEFAULT_PRIORITY;
+            else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc)    rt_cpu = atoi(argv[++i]);
+            else {
+                fprintf(stderr, "Usage: %s bench [--iterations N] [--writes] [--realtime] [--cpu N]\n", NAME);
+                return EXIT_FAILURE;
+            }
+        }
+        if (iterations < 1) { fprintf(stderr, "--iterations must be >= 1\n"); return EXIT_FAILURE; }
+        if (writes && !board_writable("bench --writes")) return EXIT_FAILURE;
+        if (load_config(config, &g_cfg[0]) != 0) return EXIT_FAILURE;
+        return cmd_bench(&g_cfg[0], transport, iterations, writes, rt_priority, rt_cpu);
+    }
+
+    /* export only reads the trace files */
+    if (strcmp(argv[1], "export") == 0) {
+        int64_t from_ms = INT64_MIN, to_ms = INT64_MAX;
+        const char *dir = REC_DIR;
+        int bad = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strncmp(argv[i], "--from=", 7) == 0)      bad |= parse_when(argv[i] + 7, &from_ms);
+            else if (strncmp(argv[i], "--to=", 5) == 0)   bad |= parse_when(argv[i] + 5, &to_ms);
+            else if (strncmp(argv[i], "--dir=", 6) == 0)  dir = argv[i] + 6;
+            else bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "Usage: %s export [--from=T] [--to=T] [--dir=DIR]  (T: unix time, or -N[s|m|h|d] ago)\n", NAME);
+            return EXIT_FAILURE;
+        }
+        return cmd_export(dir, from_ms, to_ms);
+    }
+
+    /* simulate never touches the hardware */
+    if (strcmp(argv[1], "simulate") == 0) {
+        struct sim_opts so = { NULL, NULL, INT64_MIN, INT64_MAX, -1, 0, -1.0, 0, NULL, NULL };
+        int bad = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strncmp(argv[i], "--profile=", 10) == 0)            so.profile = argv[i] + 10;
+            else if (strcmp(argv[i], "--trace") == 0)               so.trace = REC_DIR;
+            else if (strncmp(argv[i], "--trace=", 8) == 0)          so.trace = argv[i] + 8;
+            else if (strncmp(argv[i], "--from=", 7) == 0)           bad |= parse_when(argv[i] + 7, &so.from_ms);
+            else if (strncmp(argv[i], "--to=", 5) == 0)             bad |= parse_when(argv[i] + 5, &so.to_ms);
+            else if (strncmp(argv[i], "--controller=", 13) == 0)    bad |= (so.controller = config_controller(argv[i] + 13)) < 0;
+            else if (strcmp(argv[i], "--independent") == 0)         so.independent = 1;
+            else if (strncmp(argv[i], "--threshold=", 12) == 0)     so.threshold_c = atof(argv[i] + 12);
+            else if (strcmp(argv[i], "--noise") == 0)               so.noise = 1;
+            else if (strncmp(argv[i], "--baseline=", 11) == 0)      so.baseline = argv[i] + 11;
+            else if (strncmp(argv[i], "--save-baseline=", 16) == 0) so.save = argv[i] + 16;
+            else bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "Usage: %s simulate [--profile=step|burst|ramp|game|all] [--trace[=DIR]] [--from=T] [--to=T]\n"
+                            "       [--controller=curve|pid] [--independent] [--threshold=C] [--noise]\n"
+                            "       [--baseline=FILE] [--save-baseline=FILE]\n", NAME);
+            return EXIT_FAILURE;
+        }
+        if (load_config(config, &g_cfg[0]) != 0) return EXIT_FAILURE;
+        return cmd_simulate(&g_cfg[0], &so);
+    }
+
+    if (ec_init(transport) != 0) {
         fprintf(stderr, "EC init failed: %s\n", strerror(errno));
         return EXIT_FAILURE;
     }
-    signal(SIGINT, on_sigint);
-    signal(SIGTERM, on_sigint);
+    /* No SA_RESTART: the auto loop's timerfd read must return on Ctrl+C */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = on_sigusr1;           /* auto/daemon: print loop stats */
+    sigaction(SIGUSR1, &sa, NULL);
+
+    /* Resolve hwmon GPU sensors once; rescanned only on change (auto/daemon
+       start from their checkpoint's paths) */
+    if (strcmp(argv[1], "auto") != 0 && strcmp(argv[1], "daemon") != 0) gpu_sysfs_init();
 
     if (strcmp(argv[1], "dump") == 0) {
-        return dump_status();
+        int verbose = (argc >= 3 && strcmp(argv[2], "-v") == 0);
+        return dump_status(verbose);
     }
 
     if (strcmp(argv[1], "set") == 0) {
+        if (!board_writable(argv[1])) return EXIT_FAILURE;
         if (argc < 3) { fprintf(stderr, "Usage: %s set <0..100>\n", NAME); return EXIT_FAILURE; }
         int pct = atoi(argv[2]);
         return cmd_set_both(pct);
     }
 
     if (strcmp(argv[1], "set1") == 0) {
+        if (!board_writable(argv[1])) return EXIT_FAILURE;
         if (argc < 3) { fprintf(stderr, "Usage: %s set1 <0..100>\n", NAME); return EXIT_FAILURE; }
         int pct = atoi(argv[2]);
         return cmd_set1(pct);
     }
 
     if (strcmp(argv[1], "set2") == 0) {
+        if (!board_writable(argv[1])) return EXIT_FAILURE;
         if (argc < 3) { fprintf(stderr, "Usage: %s set2 <0..100>\n", NAME); return EXIT_FAILURE; }
         int pct = atoi(argv[2]);
         return cmd_set2(pct);
     }
 
-    if (strcmp(argv[1], "auto") == 0) {
-        return cmd_auto();
+    if (strcmp(argv[1], "auto") == 0 || strcmp(argv[1], "daemon") == 0) {
+        struct auto_opts opts = { -1, -1, strcmp(argv[1], "daemon") == 0, config, -1, -1, 0, -1, -1 };
+        int bad = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strncmp(argv[i], "--min-interval=", 15) == 0)
+                bad |= (opts.min_ms = atoi(argv[i] + 15)) < SAMPLER_FLOOR_MS || opts.min_ms > SAMPLER_BASE_MS;
+            else if (strncmp(argv[i], "--max-interval=", 15) == 0)
+                bad |= (opts.max_ms = atoi(argv[i] + 15)) < SAMPLER_BASE_MS || opts.max_ms > SAMPLER_CEIL_MS;
+            else if (strncmp(argv[i], "--controller=", 13) == 0)   bad |= (opts.controller = config_controller(argv[i] + 13)) < 0;
+            else if (strcmp(argv[i], "--independent") == 0)        opts.independent = 1;
+            else if (strcmp(argv[i], "--realtime") == 0)           opts.rt_priority = RT_DEFAULT_PRIORITY;
+            else if (strncmp(argv[i], "--realtime=", 11) == 0)     bad |= (opts.rt_priority = atoi(argv[i] + 11)) < 1 || opts.rt_priority > 99;
+            else if (strncmp(argv[i], "--cpu=", 6) == 0)           bad |= (opts.rt_cpu = atoi(argv[i] + 6)) < 0;
+            else if (strncmp(argv[i], "--profile=", 10) == 0)      bad |= (opts.profile = config_profile(argv[i] + 10)) < 0;
+            else bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "Usage: %s %s [--min-interval=MS] [--max-interval=MS] [--controller=curve|pid] [--independent]\n"
+                            "       [--realtime[=1..99]] [--cpu=N] [--profile=auto|normal|idle]\n"
+                            "       (--min-interval %d..%d, --max-interval %d..%d)\n", NAME, argv[1],
+                    SAMPLER_FLOOR_MS, SAMPLER_BASE_MS, SAMPLER_BASE_MS, SAMPLER_CEIL_MS);
+            return EXIT_FAILURE;
+        }
+        if (load_config(config, &g_cfg[0]) != 0) return EXIT_FAILURE;
+        return cmd_auto(&opts);
+    }
+
+    if (strcmp(argv[1], "calibrate") == 0) {
+        if (!board_writable(argv[1])) return EXIT_FAILURE;
+        int mask = 3;
+        if (argc >= 3 && strcmp(argv[2], "--fan=1") == 0)      mask = 1;
+        else if (argc >= 3 && strcmp(argv[2], "--fan=2") == 0) mask = 2;
+        else if (argc >= 3) { fprintf(stderr, "Usage: %s calibrate [--fan=1|2]\n", NAME); return EXIT_FAILURE; }
+        if (load_config(config, &g_cfg[0]) != 0) return EXIT_FAILURE;
+        return cmd_calibrate(&g_cfg[0], mask);
+    }
+
+    if (strcmp(argv[1], "sensors") == 0) {
+        if (load_config(config, &g_cfg[0]) != 0) return EXIT_FAILURE;
+        return cmd_sensors(&g_cfg[0]);
+    }
+
+    if (strcmp(argv[1], "stats") == 0) {
+        fprintf(stderr, "No fan-control daemon is running (%s)\n", CTL_SOCKET_PATH);
+        return EXIT_FAILURE;
     }
 
     fprintf(stderr, "Unknown command: %s\n", argv[1]);
@@ -140,298 +444,1197 @@ int main(int argc, char *argv[]) {
 
 /* ---------------------- Commands ------------------------ */
 
-static int dump_status(void) {
-    int tc = cpu_temp_ec();
-    int tg = gpu_temp();  /* may come from driver; EC fallback if needed */
-
-    int d1 = fan1_duty_read();
-    int r1 = fan1_rpm_read();
+static void print_status(FILE *out, const struct ec_snapshot *snap, int tg) {
+    fprintf(out, "CPU: %d°C - Fan: %d%% %dRPM\n", snap->cpu_temp, snap->fan1_duty, snap->fan1_rpm);
+    fprintf(out, "GPU: %d°C - Fan: %d%% %dRPM\n", tg, snap->fan2_duty, snap->fan2_rpm);
+}
 
-    int d2 = fan2_duty_read();
-    int r2 = fan2_rpm_read();
+static int dump_status(int verbose) {
+    struct ec_snapshot snap;
+    if (ec_snapshot_read(&snap) != 0) {
+        fprintf(stderr, "EC read failed (%s)\n", ec_transport_name());
+        if (verbose) ec_stats_print(stderr);
+        return EXIT_FAILURE;
+    }
+    int tg = gpu_temp(&snap, 0);  /* may come from driver; EC fallback if needed */
 
-    printf("CPU: %d°C - Fan: %d%% %dRPM\n", tc, d1, r1);
-    printf("GPU: %d°C - Fan: %d%% %dRPM\n", tg, d2, r2);
+    print_status(stdout, &snap, tg);
+    if (verbose) {
+        printf("Board: %s%s\n", ec_board()->name, ec_board()->read_only ? " (read-only)" : "");
+        ec_stats_print(stdout);
+    }
     return 0;
 }
 
 static int cmd_set_both(int pct) {
     if (pct < 0 || pct > 100) { fprintf(stderr, "Duty must be 0..100\n"); return EXIT_FAILURE; }
-    if (fan1_duty_write(pct) != 0) { fprintf(stderr, "Failed to set fan1\n"); return EXIT_FAILURE; }
-    if (fan2_duty_write(pct) != 0) { fprintf(stderr, "Failed to set fan2\n"); return EXIT_FAILURE; }
+    if (fans_duty_write(pct, pct) != 0) { fprintf(stderr, "Failed to set fans\n"); return EXIT_FAILURE; }
     usleep(1000 * 1000);
-    return dump_status();
+    return dump_status(0);
 }
 
 static int cmd_set1(int pct) {
     if (pct < 0 || pct > 100) { fprintf(stderr, "Duty must be 0..100\n"); return EXIT_FAILURE; }
     if (fan1_duty_write(pct) != 0) { fprintf(stderr, "Failed to set fan1\n"); return EXIT_FAILURE; }
     usleep(500 * 1000);
-    return dump_status();
+    return dump_status(0);
 }
 
 static int cmd_set2(int pct) {
     if (pct < 0 || pct > 100) { fprintf(stderr, "Duty must be 0..100\n"); return EXIT_FAILURE; }
     if (fan2_duty_write(pct) != 0) { fprintf(stderr, "Failed to set fan2\n"); return EXIT_FAILURE; }
     usleep(500 * 1000);
-    return dump_status();
+    return dump_status(0);
 }
 
-static int target_duty_from_temp_hot(int temp_c, int prev_pct)
-{
-    // Hard max: immediate full speed for safety
-    if (temp_c >= AUTO_MAX_TEMP_C) return 100;
+static int cmd_auto(const struct auto_opts *opts) {
 
-    // Hysteresis around AUTO_MIN_TEMP_C: keep off until clearly above; turn off only when clearly below
-    const int on_thr  = AUTO_MIN_TEMP_C + MIN_DEADBAND_C;
-    const int off_thr = AUTO_MIN_TEMP_C - MIN_DEADBAND_C;
+    /* Single owner: refuse to run next to another instance */
+    int lfd = ctl_listen();
+    if (lfd < 0 && (errno == EADDRINUSE || opts->daemon)) {
+        fprintf(stderr, "Control socket %s: %s%s\n", CTL_SOCKET_PATH, strerror(errno),
+                errno == EADDRINUSE ? " (another fan-control owns the EC)" : "");
+        return EXIT_FAILURE;
+    }
 
-    if (prev_pct == 0) {
-        if (temp_c <= on_thr) return 0;              // remain off until comfortably above min
-    } else {
-        if (temp_c < off_thr) return 0;              // turn off only when comfortably below min
+    struct auto_state st = { .cfg = &g_cfg[0], .hold = { -1, -1 }, .ev.duty = { -1, -1 } };
+    log_setup(st.cfg->log_level, st.cfg->log_format);
+    st.profile = (opts->profile >= 0) ? opts->profile : st.cfg->profile;
+    power_init();
+    breaker_init(&st.brk);
+    if (ec_snapshot_read(&st.snap) != 0)  /* primes the duty shadow */
+        log_event(LOG_WARN, "ec_error", "transport=%s phase=start", ec_transport_name());
+    control_init(&st.ctl, (opts->controller >= 0) ? opts->controller : st.cfg->controller,
+                 (opts->independent >= 0) ? opts->independent : st.cfg->independent,
+                 st.snap.fan1_duty, st.snap.fan2_duty);
+    calib_load(CALIB_PATH, &st.calib);
+    spin_init(&st.spin[0], st.snap.fan1_duty, mono_us());
+    spin_init(&st.spin[1], st.snap.fan2_duty, mono_us());
+    filter_reset(&st.filter[0]);
+    filter_reset(&st.filter[1]);
+    auto_zones(&st, &g_cfg[0]);
+    struct state ck;
+    if (state_load(STATE_PATH, &ck) == 0) auto_restore(&st, &ck);
+    else gpu_sysfs_init();
+    st.ctl.prime = 1;                /* first decision goes straight to the target */
+    st.tg = gpu_temp(&st.snap, 0);
+    st.suspended_ms = state_suspended_ms();
+    for (int f = 0; f < 2; f++) {
+        const struct fan_calib *fc = &st.calib.fan[f];
+        if (st.cfg->fan_target == FAN_TARGET_RPM && !fc->valid)
+            log_event(LOG_WARN, "not_calibrated", "fan=%d action=\"duty control\" hint=\"run fan-cli calibrate\"", f + 1);
+        else if (fc->valid && st.cfg->fan_target == FAN_TARGET_DUTY && st.cfg->min_duty_pct < fc->start_pct)
+            log_event(LOG_WARN, "min_duty_low", "fan=%d min_duty=%d start_duty=%d", f + 1, st.cfg->min_duty_pct, fc->start_pct);
+    }
+    load_init(&st.load);
+    throttle_init(&st.thr);
+    if (gpumon_start(st.cfg->gpu_interval_ms) != 0)
+        log_event(LOG_WARN, "gpu_worker_unavailable", "error=\"%s\" action=\"sampling inline\"", strerror(errno));
+
+    struct sampler smp;
+    sampler_init(&smp, opts->min_ms > 0 ? opts->min_ms : st.cfg->min_interval_ms,
+                       opts->max_ms > 0 ? opts->max_ms : st.cfg->max_interval_ms);
+    auto_profile(&st, &smp, opts, 1);
+
+    const char *cfg_path = opts->config ? opts->config : CONFIG_PATH;
+    int wfd = config_watch(cfg_path);
+    if (wfd < 0) log_event(LOG_WARN, "config_unwatched", "path=\"%s\" error=\"%s\"", cfg_path, strerror(errno));
+
+    if (telem_open_writer() != 0) {
+        log_event(LOG_WARN, "telemetry_unavailable", "path=\"/dev/shm%s\" error=\"%s\"", TELEM_SHM_NAME, strerror(errno));
     }
 
-    // Linear middle: MIN temp -> MIN duty, MAX temp -> 100% (using your variables)
-    if (temp_c <= AUTO_MIN_TEMP_C) return MIN_FAN_DUTY_PCT;
+    struct rec_writer rec = { .running = 0 };
+    int rec_err = 0;                 /* recording stalled (next window not ready), errno */
+    unsigned long rec_dropped = 0;
+    if (st.cfg->record && rec_open(&rec, REC_DIR, st.cfg->record_files, st.cfg->record_file_mb) != 0) {
+        log_event(LOG_WARN, "recorder_unavailable", "dir=%s error=\"%s\"", REC_DIR, strerror(errno));
+    }
+
+    /* Last, so everything opened above is locked and faulted in (of the
+       recorder, only its current window: rec.h) */
+    if (opts->rt_priority > 0 || opts->rt_cpu >= 0) rt_setup(opts->rt_priority, opts->rt_cpu);
+
+    // Live line only for a person watching; everything else goes to the event log
+    int live = !opts->daemon && isatty(STDOUT_FILENO);
+    log_set_live(live);
+    log_event(LOG_INFO, "start", "inputs=%s controller=%s profile=%s ec=%s board=%s",
+              st.ctl.independent ? "independent" : "hotter",
+              st.ctl.controller == CONTROLLER_PID ? "pid" : "curve",
+              st.idle ? "idle" : "normal", ec_transport_name(), ec_board()->name);
+    // Unknown board: watch and record, but leave the fans to the EC
+    int actuate = !ec_board()->read_only;
+    if (!actuate)
+        log_event(LOG_WARN, "read_only", "board=%s action=\"monitoring only\" hint=\"--board=NAME\"", ec_board()->name);
+    st.stats.started_us = st.ev.summary_us = mono_us();
+    while (!g_stop) {
+        // Between cycles: pick up an edited config before sensing
+        if (config_changed(wfd, cfg_path)) auto_reload(&st, &smp, opts);
+        auto_profile(&st, &smp, opts, 0);   /* AC plugged/unplugged? */
+
+        // Woke up from suspend: the temps, the EC and the fans moved on without us
+        long long susp = state_suspended_ms();
+        if (susp - st.suspended_ms >= STATE_RESUME_JUMP_MS) auto_resume(&st, susp - st.suspended_ms);
+        st.suspended_ms = susp;
+
+        long long t0 = mono_us();
+        auto_step(&st, actuate);
+        long long t_tel = mono_us();
+        auto_log(&st, t_tel);
+        if (t_tel - st.saved_us >= STATE_SAVE_MS * 1000LL) auto_checkpoint(&st);
+
+        struct timespec now_mono, now_real;
+        clock_gettime(CLOCK_MONOTONIC, &now_mono);
+        clock_gettime(CLOCK_REALTIME, &now_real);
+        struct telem_sample ts = {
+            .mono_ns     = (uint64_t)now_mono.tv_sec * 1000000000u + (uint64_t)now_mono.tv_nsec,
+            .real_ns     = (uint64_t)now_real.tv_sec * 1000000000u + (uint64_t)now_real.tv_nsec,
+            .cpu_temp_c  = (int16_t)st.tc,
+            .gpu_temp_c  = (int16_t)st.tg,
+            .hot_temp_c  = (int16_t)st.ctl.th,
+            .target_duty = (uint8_t)st.ctl.target[0],
+            .duty1       = (uint8_t)st.duty[0],
+            .duty2       = (uint8_t)st.duty[1],
+            .target_duty2 = (uint8_t)st.ctl.target[1],
+            .cpu_load_pct = (uint8_t)(st.load.cpu_pct >= 0 ? st.load.cpu_pct : 255),
+            .gpu_load_pct = (uint8_t)(st.load.gpu_pct >= 0 ? st.load.gpu_pct : 255),
+            .throttle_events  = (uint32_t)st.thr.events,
+            .throttle_per_min = (uint16_t)(st.thr.rate_per_min < 65535.0 ? st.thr.rate_per_min + 0.5 : 65535.0),
+            .cpu_mhz          = (uint16_t)st.thr.cpu_mhz,
+            .throttle_boost   = (uint8_t)(st.thr.boost + 0.5),
+            .rpm1        = (uint16_t)st.snap.fan1_rpm,
+            .rpm2        = (uint16_t)st.snap.fan2_rpm,
+            .cycle_us    = (uint32_t)(mono_us() - t0),
+        };
+        telem_publish(&ts);
+        if (rec_append(&rec, &ts) != 0) {
+            // The worker retries; say so once, and again when it is back
+            if (!rec_err) {
+                rec_err = errno ? errno : EAGAIN;
+                log_event(LOG_WARN, "recorder_stalled", "error=\"%s\" action=\"dropping records, retrying\"", strerror(rec_err));
+            }
+            rec_dropped++;
+        } else if (rec_err) {
+            log_event(LOG_INFO, "recorder_resumed", "dropped=%lu", rec_dropped);
+            rec_err = 0;
+            rec_dropped = 0;
+        }
 
-    double x0 = (double)AUTO_MIN_TEMP_C, y0 = (double)MIN_FAN_DUTY_PCT;
-    double x1 = (double)AUTO_MAX_TEMP_C, y1 = 100.0;
-    double duty = y0 + (y1 - y0) * ((temp_c - x0) / (x1 - x0));
-    int pct = (int)(duty + 0.5);
-    return clamp(pct, 0, 100);
+        // Sample faster on spikes / near the knees (lowest curve start or the
+        // PID setpoint, and the hard max), slower when stable
+        sampler_update(&smp, st.ctl.th, control_knee(&st.ctl, st.cfg), st.cfg->max_temp_c,
+                       control_settled(&st.ctl) && !spin_busy(&st.spin[0]) && !spin_busy(&st.spin[1]));
+        st.stats.rate_hz = sampler_rate_hz(&smp);
+
+        if (live && !st.idle) {
+            printf("CPU=%d°C  GPU=%d°C  IN=%d/%d°C  Load=%.0f/%.0f%%  -> Duty=%d/%d%%  (F1=%d RPM, F2=%d RPM)  %.1fHz    \r",
+                   st.tc, st.tg, st.ctl.tin[0], st.ctl.tin[1], st.load.cpu_avg, st.load.gpu_avg, st.ctl.last[0], st.ctl.last[1],
+                   st.snap.fan1_rpm, st.snap.fan2_rpm, st.stats.rate_hz);
+            fflush(stdout);
+        }
+
+        long long t_end = mono_us();
+        hist_add(&st.stats.phase[PH_TELEMETRY], (uint64_t)(t_end - t_tel));
+        hist_add(&st.stats.phase[PH_CYCLE], (uint64_t)(t_end - t0));
+        if (t_end - t0 > AUTO_SLOW_CYCLE_US) st.stats.slow_cycles++;
+
+        // Sleep until the next sample, answering clients (and SIGUSR1) in between;
+        // a bounded batch per wakeup, and sampler_wait() checks the timer first
+        for (;;) {
+            int r = sampler_wait(&smp, lfd);
+            if (r == 1) { ctl_serve(lfd, ctl_handle, &st); continue; }
+            if (r < 0 && !g_stop) {
+                if (g_dump_stats) { g_dump_stats = 0; print_auto_stats(stderr, &st); }
+                continue;
+            }
+            break;
+        }
+        long long late = mono_us() - smp.deadline_us;
+        hist_add(&st.stats.phase[PH_OVERSHOOT], (uint64_t)(late > 0 ? late : 0));
+
+    }
+    if (wfd >= 0) close(wfd);
+    gpumon_stop();
+    if (st.idle) power_set_timer_slack_us(0);
+    power_close();
+    load_close(&st.load);
+    throttle_close(&st.thr);
+    sensor_close();
+    sampler_close(&smp);
+    telem_close_writer();
+    rec_close(&rec);
+    auto_checkpoint(&st);
+    ctl_close(lfd);
+    log_event(LOG_INFO, "stop", "cycles=%llu ec_errors=%lu",
+              (unsigned long long)st.stats.phase[PH_CYCLE].count, st.ev.ec_errors);
+    log_set_live(0);
+    return 0;
 }
 
-static inline int step_toward(int last_pct, int target_pct)
-{
-    int delta = target_pct - last_pct;
-    if (delta > 0)       return last_pct + (delta < STEP_PCT ? delta : STEP_PCT);
-    else if (delta < 0)  return last_pct - ((-delta) < STEP_PCT ? -delta : STEP_PCT);
-    else                 return last_pct;
+/* Parse the changed config into the spare slot; swap only if it is valid,
+   so the loop never runs without a complete set of tables */
+static void auto_reload(struct auto_state *st, struct sampler *smp, const struct auto_opts *opts) {
+    struct config *next = (st->cfg == &g_cfg[0]) ? &g_cfg[1] : &g_cfg[0];
+    const char *path = opts->config ? opts->config : CONFIG_PATH;
+    char err[256];
+    if (config_load(path, opts->config == NULL, next, err, sizeof(err)) != 0) {
+        log_event(LOG_ERROR, "config_rejected", "error=\"%s\" action=\"keeping the previous settings\"", err);
+        return;
+    }
+    ec_set_wait_deadline_us(next->ec_deadline_us);
+    log_setup(next->log_level, next->log_format);
+    auto_zones(st, next);   /* also picks up sensors that appeared since the last scan */
+    gpumon_set_period(next->gpu_interval_ms);
+    st->cfg = next;
+    st->ctl.controller = (opts->controller >= 0) ? opts->controller : next->controller;
+    st->ctl.independent = (opts->independent >= 0) ? opts->independent : next->independent;
+    st->profile = (opts->profile >= 0) ? opts->profile : next->profile;
+    auto_profile(st, smp, opts, 1);
+    log_event(LOG_INFO, "config_reloaded", "path=\"%s\"", path);
 }
 
-static int cmd_auto(void) {
+/* Pick normal/idle (auto: idle on battery) and apply its sampling setup;
+   force re-applies even if the profile didn't change (config reload) */
+static void auto_profile(struct auto_state *st, struct sampler *smp, const struct auto_opts *opts, int force) {
+    const struct config *cfg = st->cfg;
+    int idle = (st->profile == PROFILE_IDLE) ||
+               (st->profile == PROFILE_AUTO && power_on_ac() == 0);
+    if (idle == st->idle && !force) return;
 
-    int last = clamp(fan1_duty_read(), 0, 100);
-    fan2_duty_write(last); // keep both fans in sync at start
+    if (idle != st->idle) {
+        log_event(LOG_INFO, "profile", "profile=%s on_ac=%d", idle ? "idle" : "normal", power_on_ac());
+    }
+    st->idle = idle;
+    st->gpu_async = gpumon_running() && !idle;   /* idle: few wakeups, sampled inline */
+    gpumon_pause(idle);
+    if (idle) {
+        sampler_set_bounds(smp, cfg->idle_min_interval_ms, cfg->idle_max_interval_ms);
+        sampler_set_align(smp, cfg->idle_align_ms);
+        power_set_timer_slack_us(cfg->idle_timer_slack_us);
+    } else {
+        sampler_set_bounds(smp, opts->min_ms > 0 ? opts->min_ms : cfg->min_interval_ms,
+                                opts->max_ms > 0 ? opts->max_ms : cfg->max_interval_ms);
+        sampler_set_align(smp, 0);
+        power_set_timer_slack_us(0);
+    }
+}
 
-    printf("Auto mode (hotter-of CPU/GPU) running (Ctrl+C to stop)\n");
-    while (!g_stop) {
-        int tc = cpu_temp_ec();
-        int tg = gpu_temp();
-        int th = (tc > tg) ? tc : tg;  // ***only the hotter temp***
+/* One control cycle: sense, decide, and (if actuate) write the duties */
+static void auto_step(struct auto_state *st, int actuate) {
+    long long t0 = mono_us();
+    // Breaker open: the fans sit at the safe duty, the EC is left alone
+    st->ec_skipped = !breaker_allow(&st->brk, t0);
+    if (st->ec_skipped) {
+        st->spin[0].event = st->spin[1].event = SPIN_EV_NONE;
+        return;
+    }
 
-        int target = target_duty_from_temp_hot(th, last);
+    ec_budget_begin(st->cfg->ec_budget_us);
+    st->ec_err = ec_snapshot_read(&st->snap) != 0;  /* one batched pass: temps, duties, RPMs */
+
+    // Oversample the noisy EC CPU byte; the snapshot was the first read
+    int raw[FILTER_MAX_SAMPLES] = { st->snap.cpu_temp };
+    int nraw = st->ec_err ? 1 : st->cfg->filter.oversample;
+    for (int i = 1; i < nraw; i++) raw[i] = cpu_temp_ec();   /* -1 on failure: rejected */
+    st->tc = filter_step(&st->filter[0], &st->cfg->filter, raw, nraw, t0);
+    // GPU: the worker's latest sample, never waiting for it; inline in the
+    // idle profile, where a runtime-suspended dGPU is left alone entirely
+    int tg = -1, gpu_util = -1;
+    int dgpu_off = st->idle && power_dgpu_suspended() == 1;
+    st->gpu_stale = 0;
+    if (dgpu_off) {
+        gpu_util = 0;                       /* asking would wake it up */
+    } else if (st->gpu_async) {
+        long age = gpumon_read(&tg, &gpu_util);
+        if (age < 0 || age > st->cfg->gpu_stale_ms) { tg = gpu_util = -1; st->gpu_stale = 1; }
+    } else if (gpumon_sample_now(st->idle, &tg, &gpu_util) != 0) {
+        st->gpu_stale = 1;                  /* worker still inside its last sample */
+    }
+    if (st->gpu_stale) st->stats.gpu_stale++;
+    int tg_raw = (tg > 0) ? tg : st->snap.gpu_temp;   /* EC fallback, may be 0 on some models */
+    st->tg = filter_step(&st->filter[1], &st->cfg->filter, &tg_raw, 1, t0);
+    st->tg_driver = tg;
+    // Zones: pread() of the sensors they use (no sysfs walk), then per zone
+    // one aggregate through its own filter
+    int nz = st->cfg->nzones;
+    if (nz > 0) {
+        sensor_update(st->ec_err ? -1 : st->snap.cpu_temp, st->ec_err ? -1 : st->snap.gpu_temp, tg,
+                      dgpu_off ? SENSOR_SKIP_GPU : 0);
+        for (int z = 0; z < nz; z++) {
+            int zt = zone_temp(&st->cfg->zone[z]);
+            st->zone_t[z] = filter_step(&st->zfilter[z], &st->cfg->filter, &zt, 1, t0);
+        }
+    }
+    load_sample(&st->load, st->cfg->ff.tau_s, t0, gpu_util);
+    throttle_sample(&st->thr, &st->cfg->throttle, t0);
+    long long t1 = mono_us();
+
+    struct control_input in = {
+        .tc = st->tc, .tg = st->tg,
+        .cpu_load = st->load.cpu_avg, .gpu_load = st->load.gpu_avg,
+        .throttle_boost = st->thr.boost,
+        .nzones = nz,
+        .now_us = t1,
+    };
+    memcpy(in.zone_t, st->zone_t, sizeof(in.zone_t));
+    control_step(&st->ctl, st->cfg, &in);
+
+    for (int f = 0; f < 2; f++) {
+        int want = st->ctl.last[f];
+        // RPM mode: the decision is airflow; the calibrated table gives the duty,
+        // the trim learns what the table no longer gets right
+        const struct fan_calib *fc = &st->calib.fan[f];
+        if (st->cfg->fan_target == FAN_TARGET_RPM && fc->valid) {
+            int rpm = f ? st->snap.fan2_rpm : st->snap.fan1_rpm;
+            if (want != st->airflow[f]) { st->airflow[f] = want; st->airflow_since[f] = t1; }
+            else if (t1 - st->airflow_since[f] >= CALIB_TRIM_SETTLE_MS * 1000LL &&
+                     st->hold[f] < 0 && st->spin[f].state == SPIN_RUN)
+                calib_trim_update(fc, &st->trim[f], want, rpm, (double)(t1 - st->stats.last_step_us) / 1e6);
+            want = calib_duty(fc, want, st->trim[f], rpm > 0);
+        }
+        // Manually held fans keep their duty; redundant writes are dropped by the EC shadow.
+        // Either way a start gets its kick and a fan at 0 RPM is noticed
+        want = (st->hold[f] >= 0) ? st->hold[f] : want;
+        int rpm = st->ec_err ? -1 : (f ? st->snap.fan2_rpm : st->snap.fan1_rpm);
+        st->duty[f] = spin_step(&st->spin[f], &st->cfg->spin, want, rpm, t1);
+        // Probing after a trip, or this cycle's read failed: don't trust the temps
+        if ((st->brk.state != BREAKER_CLOSED || st->ec_err) && st->duty[f] < st->cfg->ec_safe_duty)
+            st->duty[f] = st->cfg->ec_safe_duty;
+    }
+    st->stats.last_step_us = t1;
+    long long t2 = mono_us();
+
+    if (actuate && fans_duty_write(st->duty[0], st->duty[1]) != 0) st->ec_err = 1;
+    ec_budget_end();
+    long long t3 = mono_us();
+
+    breaker_result(&st->brk, !st->ec_err, t3);
+    if (st->brk.event == BREAKER_EV_TRIP && actuate) {
+        // Last word before backing off: a fresh budget for the safe duty
+        ec_budget_begin(st->cfg->ec_budget_us);
+        fans_duty_write(st->cfg->ec_safe_duty, st->cfg->ec_safe_duty);
+        ec_budget_end();
+    }
 
-        // Safety: if we're already at/above MAX_TEMP, jump straight to 100%
-        int newduty = (th >= AUTO_MAX_TEMP_C) ? 100 : step_toward(last, target);
-        newduty = clamp(newduty, 0, 100);
+    hist_add(&st->stats.phase[PH_SENSE],   (uint64_t)(t1 - t0));
+    hist_add(&st->stats.phase[PH_DECIDE],  (uint64_t)(t2 - t1));
+    hist_add(&st->stats.phase[PH_ACTUATE], (uint64_t)(t3 - t2));
+}
 
-        if (newduty != last) {
-            fan1_duty_write(newduty);
-            fan2_duty_write(newduty);
-            last = newduty;
+/* Log what changed since the last cycle: duties (debug), fans starting or
+   stopping, max_temp and throttling crossings, stale GPU samples, EC
+   failures; then the summary */
+static void auto_log(struct auto_state *st, long long now_us) {
+    struct auto_events *ev = &st->ev;
+    const struct config *cfg = st->cfg;
+
+    for (int f = 0; f < 2; f++) {
+        int d = st->duty[f];
+        if (d == ev->duty[f]) continue;
+        if (ev->duty[f] >= 0 && (d > 0) != (ev->duty[f] > 0)) {
+            log_event(LOG_INFO, d > 0 ? "fan_start" : "fan_stop", "fan=%d duty=%d temp=%d%s",
+                      f + 1, d, st->ctl.tin[f], st->hold[f] >= 0 ? " manual=1" : "");
+        } else {
+            log_event(LOG_DEBUG, "duty", "fan=%d from=%d to=%d target=%d temp=%d",
+                      f + 1, ev->duty[f], d, st->ctl.target[f], st->ctl.tin[f]);
         }
+        ev->duty[f] = d;
+    }
 
-        int r1 = fan1_rpm_read();
-        int r2 = fan2_rpm_read();
+    int hot = st->ctl.th >= cfg->max_temp_c;
+    if (hot != ev->hot) {
+        log_event(hot ? LOG_WARN : LOG_INFO, "max_temp", "state=%s temp=%d limit=%d",
+                  hot ? "above" : "below", st->ctl.th, cfg->max_temp_c);
+        ev->hot = hot;
+    }
 
-        printf("CPU=%d°C  GPU=%d°C  HOT=%d°C  -> Duty=%d%%  (F1=%d RPM, F2=%d RPM)    \r",
-               tc, tg, th, newduty, r1, r2);
-        fflush(stdout);
+    for (int f = 0; f < 2; f++) {
+        const struct spin *sp = &st->spin[f];
+        switch (sp->event) {
+        case SPIN_EV_KICK:
+            log_event(LOG_DEBUG, "fan_kick", "fan=%d duty=%d ms=%d target=%d",
+                      f + 1, st->duty[f], cfg->spin.kick_ms, st->ctl.last[f]);
+            break;
+        case SPIN_EV_STALL:
+            log_event(LOG_WARN, "fan_stall", "fan=%d rpm=0 kick=%d stalls=%lu", f + 1, sp->kicks, sp->stalls);
+            break;
+        case SPIN_EV_STALLED:
+            log_event(LOG_ERROR, "fan_stalled", "fan=%d rpm=0 kicks=%d action=\"retry every %ds\"",
+                      f + 1, sp->kicks, SPIN_RETRY_MS / 1000);
+            break;
+        case SPIN_EV_RECOVERED:
+            log_event(LOG_INFO, "fan_recovered", "fan=%d rpm=%d stalls=%lu",
+                      f + 1, f ? st->snap.fan2_rpm : st->snap.fan1_rpm, sp->stalls);
+            break;
+        }
+    }
 
-        usleep(1000 * 1000); // 1000 ms
+    int throttling = st->thr.boost > 0;
+    if (throttling != ev->throttling) {
+        if (throttling)
+            log_event(LOG_WARN, "throttle", "state=start events=%llu mhz=%d boost=%.0f",
+                      (unsigned long long)st->thr.events, st->thr.cpu_mhz, st->thr.boost);
+        else
+            log_event(LOG_INFO, "throttle", "state=end events=%llu", (unsigned long long)st->thr.events);
+        ev->throttling = throttling;
+    }
 
+    if (st->gpu_stale != ev->gpu_stale) {
+        if (st->gpu_stale)
+            log_event(LOG_WARN, "gpu_stale", "max_age_ms=%d fallback=ec", cfg->gpu_stale_ms);
+        else
+            log_event(LOG_INFO, "gpu_fresh", "stale_cycles=%llu", (unsigned long long)st->stats.gpu_stale);
+        ev->gpu_stale = st->gpu_stale;
     }
-    printf("\nStopped.\n");
-    return 0;
-}
 
-/* ---------------------- EC access ----------------------- */
+    if (st->ec_err && !st->ec_skipped) ev->ec_errors++;
+    if (st->brk.event == BREAKER_EV_TRIP)
+        log_event(LOG_ERROR, "ec_breaker", "state=open fails=%d duty=%d retry_ms=%d",
+                  st->brk.fails, st->cfg->ec_safe_duty, st->brk.backoff_ms);
+    else if (st->brk.event == BREAKER_EV_RESET)
+        log_event(LOG_INFO, "ec_breaker", "state=closed skipped=%lu", st->brk.skipped);
+    st->brk.event = BREAKER_EV_NONE;
+    if (st->ec_err != ev->ec_err) {
+        if (st->ec_err)
+            log_event(LOG_ERROR, "ec_error", "transport=%s errors=%lu", ec_transport_name(), ev->ec_errors);
+        else
+            log_event(LOG_INFO, "ec_recovered", "errors=%lu", ev->ec_errors);
+        ev->ec_err = st->ec_err;
+    }
 
-static int ec_init(void) {
-    if (ioperm(EC_DATA, 1, 1) != 0) return -1;
-    if (ioperm(EC_SC,   1, 1) != 0) return -1;
-    return 0;
+    // Summary accumulators (reset by auto_log_summary)
+    if (ev->cycles == 0) {
+        ev->th_min = ev->th_max = st->ctl.th;
+        for (int f = 0; f < 2; f++) ev->duty_min[f] = ev->duty_max[f] = st->duty[f];
+    }
+    ev->cycles++;
+    ev->th_sum += st->ctl.th;
+    if (st->ctl.th < ev->th_min) ev->th_min = st->ctl.th;
+    if (st->ctl.th > ev->th_max) ev->th_max = st->ctl.th;
+    for (int f = 0; f < 2; f++) {
+        if (st->duty[f] < ev->duty_min[f]) ev->duty_min[f] = st->duty[f];
+        if (st->duty[f] > ev->duty_max[f]) ev->duty_max[f] = st->duty[f];
+    }
+    if (cfg->log_summary_s > 0 && now_us - ev->summary_us >= (long long)cfg->log_summary_s * 1000000)
+        auto_log_summary(st, now_us);
 }
 
-static int ec_io_wait(const uint32_t port, const uint32_t flag, const char value) {
-    uint8_t data = inb(port);
-    int i = 0;
-    while ((((data >> flag) & 0x1) != value) && (i++ < 100)) {
-        usleep(1000);
-        data = inb(port);
+static void auto_log_summary(struct auto_state *st, long long now_us) {
+    struct auto_events *ev = &st->ev;
+    if (ev->cycles > 0) {
+        log_event(LOG_INFO, "summary",
+                  "period_s=%lld cycles=%lu temp_min=%d temp_avg=%.1f temp_max=%d "
+                  "duty1_min=%d duty1_max=%d duty2_min=%d duty2_max=%d rpm1=%d rpm2=%d "
+                  "throttle_events=%llu ec_errors=%lu rate_hz=%.1f",
+                  (now_us - ev->summary_us) / 1000000, ev->cycles,
+                  ev->th_min, (double)ev->th_sum / (double)ev->cycles, ev->th_max,
+                  ev->duty_min[0], ev->duty_max[0], ev->duty_min[1], ev->duty_max[1],
+                  st->snap.fan1_rpm, st->snap.fan2_rpm,
+                  (unsigned long long)st->thr.events, ev->ec_errors, st->stats.rate_hz);
     }
-    return (i >= 100) ? -1 : 0;
+    ev->cycles = 0;
+    ev->th_sum = 0;
+    ev->summary_us = now_us;
 }
 
-static uint8_t ec_io_read(const uint32_t port) {
-    ec_io_wait(EC_SC, IBF, 0);
-    outb(EC_SC_READ_CMD, EC_SC);
+/* Start from a checkpoint: always the trims of the same calibration; the
+   control state and sensor paths only from this boot, recently */
+static void auto_restore(struct auto_state *st, const struct state *ck) {
+    int trims = 0;
+    for (int f = 0; f < 2; f++) {
+        if (!st->calib.fan[f].valid || ck->calib_stamp != st->calib.stamp) continue;
+        st->trim[f] = ck->trim[f];
+        trims = 1;
+    }
+    int fresh = state_fresh(ck);
+    if (!fresh) {
+        gpu_sysfs_init();
+        log_event(LOG_INFO, "state_stale", "age_s=%lld trims=%d", (long long)time(NULL) - ck->stamp, trims);
+        return;
+    }
 
-    ec_io_wait(EC_SC, IBF, 0);
-    outb(port, EC_DATA);
+    long long now = mono_us();
+    int sensors = gpu_sysfs_restore(ck->sensors, ck->nsensors);
+    for (int f = 0; f < 2; f++) {
+        // The decided duty also puts the curve on the right side of its hysteresis
+        st->ctl.last[f] = st->ctl.target[f] = ck->duty[f];
+        st->filter[f].x = ck->filt_x[f];
+        st->filter[f].dx = ck->filt_dx[f];
+        st->filter[f].have = ck->filt_x[f] > 0;
+        st->filter[f].last_us = now;
+        if (ck->controller == CONTROLLER_PID && st->ctl.controller == CONTROLLER_PID) {
+            struct pid_state *p = &st->ctl.pid[f];
+            p->integ = ck->pid_integ[f];
+            p->t_filt = ck->pid_t_filt[f];
+            p->duty = ck->pid_duty[f];
+            p->applied = ck->duty[f];
+            p->last_us = now;
+        }
+    }
+    log_event(LOG_INFO, "state_restored", "age_s=%lld duty1=%d duty2=%d sensors=%d trims=%d",
+              (long long)time(NULL) - ck->stamp, ck->duty[0], ck->duty[1], sensors, trims);
+}
 
-    ec_io_wait(EC_SC, OBF, 1);
-    return inb(EC_DATA);
+/* After suspend: keep the decisions, drop what aged (filter history, PID
+   timing, the duty shadow) and decide from scratch in the next cycle */
+static void auto_resume(struct auto_state *st, long long slept_ms) {
+    long long now = mono_us();
+    log_event(LOG_INFO, "resume", "slept_s=%lld", slept_ms / 1000);
+    ec_shadow_invalidate();                 /* the EC may have reset the duties */
+    for (int f = 0; f < 2; f++) {
+        filter_reset(&st->filter[f]);
+        pid_reset(&st->ctl.pid[f]);
+        spin_init(&st->spin[f], 0, now);    /* a fan the EC stopped gets its kick */
+    }
+    for (int z = 0; z < ZONE_MAX; z++) filter_reset(&st->zfilter[z]);
+    st->ctl.prime = 1;
 }
 
-static int ec_io_do(const uint32_t cmd, const uint32_t port, const uint8_t value) {
-    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
-    outb(cmd, EC_SC);
+static void auto_checkpoint(struct auto_state *st) {
+    struct state ck;
+    memset(&ck, 0, sizeof(ck));
+    // The worker may be rescanning the registry: try again next cycle
+    // (at exit it is already stopped)
+    ck.nsensors = gpumon_sensor_paths(ck.sensors, GPU_MAX_SENSORS);
+    if (ck.nsensors < 0) return;
+    ck.stamp = (long long)time(NULL);
+    state_boot_id(ck.boot_id);
+    ck.controller = st->ctl.controller;
+    for (int f = 0; f < 2; f++) {
+        ck.duty[f] = st->ctl.last[f];
+        ck.filt_x[f] = st->filter[f].have ? st->filter[f].x : 0.0;
+        ck.filt_dx[f] = st->filter[f].dx;
+        ck.pid_integ[f] = st->ctl.pid[f].integ;
+        ck.pid_t_filt[f] = st->ctl.pid[f].t_filt;
+        ck.pid_duty[f] = st->ctl.pid[f].duty;
+        ck.trim[f] = st->trim[f];
+    }
+    ck.calib_stamp = st->calib.stamp;
 
-    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
-    outb(port, EC_DATA);
+    st->saved_us = mono_us();
+    (void)mkdir(REC_DIR, 0755);
+    if (state_save(STATE_PATH, &ck) != 0 && !st->state_err) {
+        log_event(LOG_WARN, "state_unsaved", "path=%s error=\"%s\"", STATE_PATH, strerror(errno));
+        st->state_err = 1;
+    }
+}
 
-    if (ec_io_wait(EC_SC, IBF, 0) != 0) return -1;
-    outb(value, EC_DATA);
+/* Enumerate the sensors and bind cfg's zones to them (start, reload): the
+   only sysfs walk zones do. Without zones there is no registry at all */
+static void auto_zones(struct auto_state *st, struct config *cfg) {
+    for (int z = 0; z < ZONE_MAX; z++) {
+        filter_reset(&st->zfilter[z]);
+        st->zone_t[z] = -1;
+    }
+    if (cfg->nzones == 0) { sensor_close(); return; }
 
-    return ec_io_wait(EC_SC, IBF, 0);
+    int n = sensor_scan();
+    config_bind_zones(cfg);
+    for (int z = 0; z < cfg->nzones; z++) {
+        if (cfg->zone[z].nmembers == 0)
+            log_event(LOG_WARN, "zone_empty", "zone=%s hint=\"fan-cli sensors\"", cfg->zone[z].name);
+    }
+    log_event(LOG_INFO, "zones", "zones=%d sensors=%d", cfg->nzones, n);
 }
 
-/* ------------------- Sensing helpers -------------------- */
+static void print_auto_stats(FILE *out, const struct auto_state *st) {
+    const struct auto_stats *s = &st->stats;
+    fprintf(out, "uptime %llds, %llu cycles, %llu slow (>%dms), sampling at %.1f Hz\n",
+            (mono_us() - s->started_us) / 1000000,
+            (unsigned long long)s->phase[PH_CYCLE].count, (unsigned long long)s->slow_cycles,
+            AUTO_SLOW_CYCLE_US / 1000, s->rate_hz);
+    if (st->cfg->fan_target == FAN_TARGET_RPM)
+        fprintf(out, "RPM target: fan1 %s trim %+.1f%%, fan2 %s trim %+.1f%%\n",
+                st->calib.fan[0].valid ? "calibrated" : "uncalibrated", st->trim[0],
+                st->calib.fan[1].valid ? "calibrated" : "uncalibrated", st->trim[1]);
+    fprintf(out, "Spin-up: fan1 %lu kicked starts, %lu stalls%s; fan2 %lu kicked starts, %lu stalls%s\n",
+            st->spin[0].starts, st->spin[0].stalls, st->spin[0].failed ? " (STALLED)" : "",
+            st->spin[1].starts, st->spin[1].stalls, st->spin[1].failed ? " (STALLED)" : "");
+    fprintf(out, "EC breaker: %s, %lu trips, %lu cycles skipped, backoff %d ms\n",
+            st->brk.state == BREAKER_CLOSED ? "closed" : (st->brk.state == BREAKER_OPEN ? "OPEN" : "probing"),
+            st->brk.trips, st->brk.skipped, st->brk.backoff_ms);
+    fprintf(out, "Temp filter: %s, %d CPU reads/cycle, %lu CPU / %lu GPU readings rejected\n",
+            st->cfg->filter.kind == FILTER_EURO ? "one-euro" : (st->cfg->filter.kind == FILTER_EMA ? "ema" : "median only"),
+            st->cfg->filter.oversample, st->filter[0].rejected, st->filter[1].rejected);
+    for (int z = 0; z < st->cfg->nzones; z++) {
+        const struct zone *zn = &st->cfg->zone[z];
+        char agg[8];
+        fprintf(out, "Zone %s: %d°C, %s of %d sensors -> %s, %lu readings rejected\n", zn->name, st->zone_t[z],
+                zone_agg_name(zn, agg, sizeof(agg)), zn->nmembers,
+                zn->fans == 3 ? "both fans" : (zn->fans == 1 ? "fan1" : "fan2"), st->zfilter[z].rejected);
+    }
+    fprintf(out, "GPU: %s, %llu stale cycles (EC fallback)\n", st->gpu_async ? "worker thread" : "inline",
+            (unsigned long long)st->stats.gpu_stale);
+    fprintf(out, "CPU throttle: %llu events, %.1f/min, boost %.0f%%, %d MHz\n",
+            (unsigned long long)st->thr.events, st->thr.rate_per_min, st->thr.boost, st->thr.cpu_mhz);
+    hist_print_header(out);
+    for (int p = 0; p < PH_COUNT; p++) hist_print(out, g_phase_names[p], &s->phase[p]);
+    ec_stats_print(out);
+}
+
+/* ------------------- Board profile ---------------------- */
 
-static int cpu_temp_ec(void) {
-    /* EC CPU temp in °C */
-    return (int)ec_io_read(EC_REG_CPU_TEMP);
+/* --board=NAME, or DMI for NULL/"auto"; NULL (reported) if NAME is unknown */
+static const struct board_profile *select_board(const char *name) {
+    if (name && strcmp(name, "auto") != 0) {
+        const struct board_profile *b = board_by_name(name);
+        if (!b) {
+            fprintf(stderr, "Unknown board '%s'; known:", name);
+            for (int i = 0; board_at(i); i++) fprintf(stderr, " %s", board_at(i)->name);
+            fprintf(stderr, "\n");
+        }
+        return b;
+    }
+    struct board_dmi d;
+    board_dmi_read(&d);
+    return board_match(&d);
 }
 
-/* Prefer driver temps for GPU; fall back to EC if nothing else */
-static int gpu_temp(void) {
-    int t = gpu_temp_sysfs();
-    if (t > 0) return t;
-    t = gpu_temp_nvidia_smi();
-    if (t > 0) return t;
-    return (int)ec_io_read(EC_REG_GPU_TEMP); /* may be 0 on some models */
+/* Writing commands refuse to run on a read-only (unknown) board */
+static int board_writable(const char *cmd) {
+    if (!ec_board()->read_only) return 1;
+    struct board_dmi d;
+    board_dmi_read(&d);
+    fprintf(stderr, "%s: no board profile for \"%s\" / \"%s\" / \"%s\" (DMI vendor/product/board), "
+                    "EC is read-only. Use --board=NAME if one fits:",
+            cmd, d.sys_vendor, d.product_name, d.board_name);
+    for (int i = 0; board_at(i); i++)
+        if (!board_at(i)->read_only) fprintf(stderr, " %s", board_at(i)->name);
+    fprintf(stderr, "\n");
+    return 0;
 }
 
-/* Fan duty read (0..100) */
-static int fan1_duty_read(void) {
-    int raw = (int)ec_io_read(EC_REG_FAN1_DUTY);
-    int pct = (int)((raw / 255.0) * 100.0 + 0.5);
-    return clamp(pct, 0, 100);
+/* ------------------- Control socket --------------------- */
+
+/* Client side of dump/set/set1/set2/auto/stats/sensors; -1 if no daemon is running */
+static int ctl_forward(int argc, char *argv[]) {
+    char req[CTL_REQ_MAX];
+    const char *cmd = argv[1];
+
+    if (strcmp(cmd, "dump") == 0) {
+        int verbose = (argc >= 3 && strcmp(argv[2], "-v") == 0);
+        snprintf(req, sizeof(req), "dump%s", verbose ? " -v" : "");
+    } else if (strcmp(cmd, "set") == 0 || strcmp(cmd, "set1") == 0 || strcmp(cmd, "set2") == 0) {
+        if (argc < 3) return -1;     /* usage error is reported by the local path */
+        snprintf(req, sizeof(req), "%s %d", cmd, atoi(argv[2]));
+    } else if (strcmp(cmd, "auto") == 0 || strcmp(cmd, "stats") == 0 || strcmp(cmd, "sensors") == 0) {
+        snprintf(req, sizeof(req), "%s", cmd);
+    } else {
+        return -1;
+    }
+    return ctl_request(req);
 }
 
-static int fan2_duty_read(void) {
-    int raw = (int)ec_io_read(EC_REG_FAN2_DUTY);
-    int pct = (int)((raw / 255.0) * 100.0 + 0.5);
-    return clamp(pct, 0, 100);
+/* Daemon side: runs between cycles, answers from the latest snapshot */
+static int ctl_handle(void *ctx, const char *req, int privileged, FILE *out) {
+    struct auto_state *st = ctx;
+    char cmd[16], arg[16] = "", extra[2];
+    int n = sscanf(req, "%15s %15s %1s", cmd, arg, extra);
+    if (n < 1) { fprintf(out, "Empty request\n"); return -1; }
+    if (n > 2) { fprintf(out, "Too many arguments: %s\n", req); return -1; }
+
+    if (strcmp(cmd, "dump") == 0) {
+        if (n == 2 && strcmp(arg, "-v") != 0) { fprintf(out, "Unknown option: %s\n", arg); return -1; }
+        print_status(out, &st->snap, st->tg);
+        if (n == 2) ec_stats_print(out);
+        return 0;
+    }
+
+    if (strcmp(cmd, "stats") == 0) {
+        print_auto_stats(out, st);
+        return 0;
+    }
+
+    if (strcmp(cmd, "sensors") == 0) {
+        // Without zones the loop keeps no registry: build one just for the listing
+        if (sensor_count() == 0) sensor_scan();
+        int dgpu_off = st->idle && power_dgpu_suspended() == 1;
+        sensor_update(st->ec_err ? -1 : st->snap.cpu_temp, st->ec_err ? -1 : st->snap.gpu_temp, st->tg_driver,
+                      SENSOR_READ_ALL | (dgpu_off ? SENSOR_SKIP_GPU : 0));
+        print_sensors(out, st->cfg, st->zone_t);
+        return 0;
+    }
+
+    int set1 = strcmp(cmd, "set1") == 0 || strcmp(cmd, "set") == 0;
+    int set2 = strcmp(cmd, "set2") == 0 || strcmp(cmd, "set") == 0;
+    int resume = strcmp(cmd, "auto") == 0;
+    if (!set1 && !set2 && !resume) { fprintf(out, "Unknown request: %s\n", cmd); return -1; }
+    if (!privileged) { fprintf(out, "Permission denied (changing duties needs root)\n"); return -1; }
+
+    if (resume) {
+        st->hold[0] = st->hold[1] = -1;
+        fprintf(out, "Automatic control resumed\n");
+        return 0;
+    }
+
+    char *end;
+    long pct = (n == 2) ? strtol(arg, &end, 10) : -1;
+    if (n < 2 || *end || pct < 0 || pct > 100) { fprintf(out, "Duty must be 0..100\n"); return -1; }
+
+    /* Apply now rather than at the next cycle; the hold only once it took */
+    int hold1 = set1 ? (int)pct : st->hold[0];
+    int hold2 = set2 ? (int)pct : st->hold[1];
+    int d1 = (hold1 >= 0) ? hold1 : st->snap.fan1_duty;
+    int d2 = (hold2 >= 0) ? hold2 : st->snap.fan2_duty;
+    if (fans_duty_write(d1, d2) != 0) { fprintf(out, "Failed to set fans: %s\n", strerror(errno)); return -1; }
+    st->hold[0] = hold1;
+    st->hold[1] = hold2;
+    st->snap.fan1_duty = d1;
+    st->snap.fan2_duty = d2;
+
+    print_status(out, &st->snap, st->tg);
+    return 0;
 }
 
-/* Fan RPM read */
-static int fan1_rpm_read(void) {
-    int hi = (int)ec_io_read(EC_REG_FAN1_RPM_HI);
-    int lo = (int)ec_io_read(EC_REG_FAN1_RPM_LO);
-    return rpm_from_raw(hi, lo);
+/* ----------------------- sensors ----------------------- */
+
+/* The registry with the latest readings, then each zone: zone_t[] as the
+   loop sees it (filtered), or NULL for the raw aggregate */
+static void print_sensors(FILE *out, const struct config *cfg, const int *zone_t) {
+    for (int i = 0; i < sensor_count(); i++) {
+        const struct sensor *s = sensor_at(i);
+        if (s->milli > 0) fprintf(out, "%-32s %6.1f°C  %s\n", s->id, s->milli / 1000.0, s->path);
+        else              fprintf(out, "%-32s      -    %s\n", s->id, s->path);
+    }
+    for (int z = 0; z < cfg->nzones; z++) {
+        const struct zone *zn = &cfg->zone[z];
+        char agg[8];
+        int t = zone_t ? zone_t[z] : zone_temp(zn);
+        fprintf(out, "zone %s (%s -> %s): ", zn->name, zone_agg_name(zn, agg, sizeof(agg)),
+                zn->fans == 3 ? "both fans" : (zn->fans == 1 ? "fan1" : "fan2"));
+        if (t >= 0) fprintf(out, "%d°C from", t);
+        else        fprintf(out, "no reading from");
+        for (int m = 0; m < zn->nmembers; m++) fprintf(out, " %s", sensor_at(zn->member[m])->id);
+        fprintf(out, "%s\n", zn->nmembers ? "" : " no sensors (check the patterns)");
+    }
 }
 
-static int fan2_rpm_read(void) {
-    int hi = (int)ec_io_read(EC_REG_FAN2_RPM_HI);
-    int lo = (int)ec_io_read(EC_REG_FAN2_RPM_LO);
-    return rpm_from_raw(hi, lo);
+static int cmd_sensors(struct config *cfg) {
+    struct ec_snapshot snap;
+    int ec_ok = ec_snapshot_read(&snap) == 0;
+    int tg = gpu_temp_driver(0);
+    sensor_scan();
+    config_bind_zones(cfg);
+    sensor_update(ec_ok ? snap.cpu_temp : -1, ec_ok ? snap.gpu_temp : -1, tg, SENSOR_READ_ALL);
+    print_sensors(stdout, cfg, NULL);
+    sensor_close();
+    return 0;
 }
 
-/* Fan duty write (0..100) via EC command 0x99; port 0x01=fan1, 0x02=fan2 */
-static int fan1_duty_write(int pct) {
-    pct = clamp(pct, 0, 100);
-    int v = (int)(pct / 100.0 * 255.0 + 0.5);
-    return ec_io_do(0x99, 0x01, (uint8_t)v);
+/* ------------------------ bench ------------------------ */
+
+static long long raw_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
-static int fan2_duty_write(int pct) {
-    pct = clamp(pct, 0, 100);
-    int v = (int)(pct / 100.0 * 255.0 + 0.5);
-    return ec_io_do(0x99, 0x02, (uint8_t)v);
+
+static int cmp_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
 }
 
-/* ----------------------- Utils -------------------------- */
+static const char *fmt_ns(char *buf, size_t len, long long ns) {
+    if (ns < 10000)           snprintf(buf, len, "%lldns", ns);
+    else if (ns < 10000000)   snprintf(buf, len, "%.1fus", (double)ns / 1e3);
+    else                      snprintf(buf, len, "%.1fms", (double)ns / 1e6);
+    return buf;
+}
 
-static int clamp(int v, int lo, int hi) {
-    if (v < lo) return lo;
-    if (v > hi) return hi;
-    return v;
+static void bench_print(const char *what, long long *ns, int n) {
+    char a[BENCH_NS_BUF], b[BENCH_NS_BUF], c[BENCH_NS_BUF], d[BENCH_NS_BUF];
+    qsort(ns, (size_t)n, sizeof(ns[0]), cmp_ll);
+    int p99 = (int)((n * 99 + 99) / 100) - 1;   /* ceil(0.99 n) - 1 */
+    printf("  %-12s n=%-5d min=%-9s median=%-9s p99=%-9s max=%s\n", what, n,
+           fmt_ns(a, sizeof(a), ns[0]), fmt_ns(b, sizeof(b), ns[n / 2]),
+           fmt_ns(c, sizeof(c), ns[p99]), fmt_ns(d, sizeof(d), ns[n - 1]));
 }
 
-/* Convert EC raw RPM value (two bytes) to RPM.
-   The original project used: RPM = 2156220 / raw */
-static int rpm_from_raw(int hi, int lo) {
-    int raw = (hi << 8) | lo;
-    return (raw > 0) ? (2156220 / raw) : 0;
+/* Time n calls of fn (which returns < 0 when the source is unavailable) */
+static void bench_sensor(const char *what, int (*fn)(void), long long *ns, int n) {
+    if (fn() < 0) { printf("  %-12s unavailable\n", what); return; }
+    for (int i = 0; i < n; i++) {
+        long long t0 = raw_ns();
+        (void)fn();
+        ns[i] = raw_ns() - t0;
+    }
+    bench_print(what, ns, n);
 }
 
-/* --------------- GPU temp discovery helpers ------------- */
+/* After bench_print (ns sorted): spread around the median */
+static void bench_jitter(const long long *ns, int n) {
+    char a[BENCH_NS_BUF], b[BENCH_NS_BUF];
+    int p99 = (int)((n * 99 + 99) / 100) - 1;
+    printf("  %-12s p99-median=%-9s max-min=%s\n", "jitter",
+           fmt_ns(a, sizeof(a), ns[p99] - ns[n / 2]), fmt_ns(b, sizeof(b), ns[n - 1] - ns[0]));
+}
 
-/* Scan /sys/class/hwmon for GPU temps (nvidia/amdgpu/i915/xe) */
-static int gpu_temp_sysfs(void) {
-    DIR *d = opendir("/sys/class/hwmon");
-    if (!d) return -1;
+static void bench_ec_counters(void) {
+    struct ec_wait_stats w;
+    ec_wait_stats_get(&w);
+    double rate = w.transactions ? 100.0 * (double)w.timeouts / (double)w.transactions : 0.0;
+    printf("  timeout rate %.2f%% (%lu of %lu transactions)\n", rate, w.timeouts, w.transactions);
+    ec_stats_print(stdout);
+}
 
-    int best = -1;
-    int rootfd = dirfd(d);
-    if (rootfd < 0) { closedir(d); return -1; }
+/* Per backend: EC read, snapshot (and duty rewrite with --writes);
+   then GPU sensors and a full auto cycle on the default backend */
+static int cmd_bench(const struct config *cfg, const char *transport, int iterations, int writes,
+                     int rt_priority, int rt_cpu) {
+    if (ctl_probe()) {
+        fprintf(stderr, "A fan-control daemon owns the EC (%s); stop it before benchmarking\n", CTL_SOCKET_PATH);
+        return EXIT_FAILURE;
+    }
 
-    struct dirent *de;
-    while ((de = readdir(d)) != NULL) {
-        if (strncmp(de->d_name, "hwmon", 5) != 0) continue;
+    long long *ns = malloc((size_t)iterations * sizeof(*ns));
+    if (!ns) { fprintf(stderr, "Out of memory\n"); return EXIT_FAILURE; }
+    int slow = iterations / BENCH_SLOW_DIVISOR;
+    if (slow < 3) slow = 3;
+    if (slow > iterations) slow = iterations;
+    int any = 0;
+
+    if (rt_priority > 0 || rt_cpu >= 0) rt_setup(rt_priority, rt_cpu);
+    printf("bench: %d iterations, %s%s\n", iterations, writes ? "WRITES ENABLED" : "read-only",
+           rt_priority > 0 ? ", SCHED_FIFO" : "");
+    for (int t = 0; ec_transport_name_at(t) != NULL; t++) {
+        const char *name = ec_transport_name_at(t);
+        if (transport && strcmp(transport, "auto") != 0 && strcmp(transport, name) != 0) continue;
+        if (ec_init(name) != 0) {
+            printf("%s: unavailable (%s)\n", name, strerror(errno));
+            continue;
+        }
+        any = 1;
+        ec_wait_stats_reset();
+        printf("%s:\n", name);
+
+        for (int i = 0; i < iterations; i++) {
+            long long t0 = raw_ns();
+            (void)ec_io_read(ec_board()->cpu_temp);
+            ns[i] = raw_ns() - t0;
+        }
+        bench_print("ec read", ns, iterations);
 
-        int hwfd = openat(rootfd, de->d_name, O_RDONLY | O_DIRECTORY);
-        if (hwfd < 0) continue;
+        for (int i = 0; i < iterations; i++) {
+            struct ec_snapshot snap;
+            long long t0 = raw_ns();
+            ec_snapshot_read(&snap);
+            ns[i] = raw_ns() - t0;
+        }
+        bench_print("snapshot", ns, iterations);
+
+        if (writes) {
+            /* Rewrite the duty fan1 already has, bypassing the shadow */
+            int d1 = fan1_duty_read();
+            if (d1 < 0) {
+                printf("  duty write: skipped, fan1 duty unreadable\n");
+            } else {
+                for (int i = 0; i < iterations; i++) {
+                    ec_shadow_invalidate();
+                    long long t0 = raw_ns();
+                    fan1_duty_write(d1);
+                    ns[i] = raw_ns() - t0;
+                }
+                bench_print("duty write", ns, iterations);
+            }
+        }
 
-        /* Read "<hwmon>/name" */
-        int namefd = openat(hwfd, "name", O_RDONLY);
-        if (namefd < 0) { close(hwfd); continue; }
+        bench_ec_counters();
+        ec_close();
+    }
+    printf("sensors:\n");
+    gpu_sysfs_init();
+    bench_sensor("hwmon", gpu_temp_sysfs, ns, iterations);
+    bench_sensor("nvml", gpu_temp_nvml, ns, iterations);
+    bench_sensor("nvidia-smi", gpu_temp_nvidia_smi_uncached, ns, slow);
+    bench_sensor("gpu busy", gpu_util_sysfs, ns, iterations);
+    bench_sensor("nvml util", gpu_util_nvml, ns, iterations);
+
+    /* The loop's own wait path (absolute timerfd deadlines), at a fixed short period */
+    printf("timer (%d ms period):\n", BENCH_WAKEUP_MS);
+    struct sampler smp;
+    sampler_init(&smp, BENCH_WAKEUP_MS, SAMPLER_MAX_MS);
+    smp.period_ms = BENCH_WAKEUP_MS;     /* no sampler_update(): stays fixed */
+    for (int i = 0; i < iterations; i++) {
+        while (sampler_wait(&smp, -1) < 0) { }
+        ns[i] = (mono_us() - smp.deadline_us) * 1000;
+    }
+    sampler_close(&smp);
+    bench_print("wakeup late", ns, iterations);
+
+    if (any && ec_init(transport) == 0) {
+        printf("auto cycle (%s, %s):\n", ec_transport_name(), writes ? "actuating" : "dry run");
+        ec_wait_stats_reset();
+        struct auto_state st = { .cfg = cfg, .hold = { -1, -1 } };
+        breaker_init(&st.brk);
+        ec_snapshot_read(&st.snap);
+        control_init(&st.ctl, cfg->controller, cfg->independent, st.snap.fan1_duty, st.snap.fan2_duty);
+        load_init(&st.load);
+        throttle_init(&st.thr);
+        for (int i = 0; i < iterations; i++) {
+            long long t0 = raw_ns();
+            auto_step(&st, writes);
+            ns[i] = raw_ns() - t0;
+        }
+        bench_print("cycle", ns, iterations);
+        bench_jitter(ns, iterations);
+        load_close(&st.load);
+        throttle_close(&st.thr);
+        bench_ec_counters();
+        ec_close();
+    }
 
-        char namebuf[64] = {0};
-        ssize_t n = read(namefd, namebuf, sizeof(namebuf) - 1);
-        close(namefd);
-        if (n <= 0) { close(hwfd); continue; }
-        for (ssize_t i = 0; i < n; i++) if (namebuf[i] == '\n') { namebuf[i] = 0; break; }
+    free(ns);
+    return any ? 0 : EXIT_FAILURE;
+}
 
-        if (!(strstr(namebuf, "nvidia") || strstr(namebuf, "amdgpu") ||
-              strstr(namebuf, "i915")   || strstr(namebuf, "xe"))) {
-            close(hwfd);
-            continue;
+/* ---------------------- Calibrate ----------------------- */
+
+/* Set the duty and wait for a steady RPM; -1 on Ctrl+C, or when the CPU
+   reaches max_temp or the EC fails (the fans are then left at 100%) */
+static int calibrate_settle(const struct config *cfg, int fan, int duty, int max_ms, int *rpm_out) {
+    if ((fan ? fan2_duty_write(duty) : fan1_duty_write(duty)) != 0) return -1;
+    int prev = -1, stable = 0, rpm = 0;
+    for (int waited = 0; waited < max_ms && !g_stop; waited += CALIBRATE_POLL_MS) {
+        usleep(CALIBRATE_POLL_MS * 1000);
+        int tc = cpu_temp_ec();
+        if (tc >= cfg->max_temp_c) {
+            fans_duty_write(100, 100);
+            fprintf(stderr, "\nCPU at max_temp (%d°C): aborted, fans at 100%%\n", cfg->max_temp_c);
+            return -1;
+        }
+        rpm = fan ? fan2_rpm_read() : fan1_rpm_read();
+        if (tc < 0 || rpm < 0) {
+            fans_duty_write(100, 100);
+            fprintf(stderr, "\nEC read failed: aborted, fans at 100%%\n");
+            return -1;
         }
+        int tol = prev * CALIBRATE_STABLE_PCT / 100;
+        stable = (prev >= 0 && abs(rpm - prev) <= tol) ? stable + 1 : 0;
+        prev = rpm;
+        if (stable >= CALIBRATE_STABLE_READS) break;
+    }
+    *rpm_out = rpm;
+    return g_stop ? -1 : 0;
+}
+
+/* Stopped-fan start: raise 1% at a time; the stall edge the other way */
+static int calibrate_fan(const struct config *cfg, int fan, struct fan_calib *fc) {
+    memset(fc, 0, sizeof(*fc));
+    printf("fan%d: duty -> RPM\n", fan + 1);
+    for (int i = CALIB_POINTS - 1; i >= 0; i--) {
+        if (calibrate_settle(cfg, fan, i * CALIB_STEP_PCT, CALIBRATE_SETTLE_MS, &fc->rpm[i]) != 0) return -1;
+        printf("  %3d%%  %5d RPM\n", i * CALIB_STEP_PCT, fc->rpm[i]);
+        fflush(stdout);
+    }
+    if (calib_max_rpm(fc) <= 0) { fprintf(stderr, "fan%d never turned\n", fan + 1); return -1; }
+
+    // Stall: down from the lowest table point that still turned
+    int lo = CALIB_POINTS - 1;
+    while (lo > 0 && fc->rpm[lo - 1] > 0) lo--;
+    int rpm = 1, d = lo * CALIB_STEP_PCT;
+    if (calibrate_settle(cfg, fan, d, CALIBRATE_SETTLE_MS, &rpm) != 0) return -1;
+    for (; d > 0 && rpm > 0; d--)
+        if (calibrate_settle(cfg, fan, d - 1, CALIBRATE_EDGE_MS, &rpm) != 0) return -1;
+    fc->stall_pct = d + 1;
+
+    // Start: from standstill, up until it turns
+    if (calibrate_settle(cfg, fan, 0, CALIBRATE_SETTLE_MS, &rpm) != 0) return -1;
+    for (d = fc->stall_pct; d <= 100; d++) {
+        if (calibrate_settle(cfg, fan, d, CALIBRATE_EDGE_MS, &rpm) != 0) return -1;
+        if (rpm > 0) break;
+    }
+    fc->start_pct = d;
+    fc->valid = 1;
+    printf("  stalls below %d%%, starts at %d%%\n", fc->stall_pct, fc->start_pct);
+    return 0;
+}
+
+/* fan_mask: bit 0 fan1, bit 1 fan2; the duties are restored afterwards */
+static int cmd_calibrate(const struct config *cfg, int fan_mask) {
+    if (ctl_probe()) {
+        fprintf(stderr, "A fan-control daemon owns the EC (%s); stop it before calibrating\n", CTL_SOCKET_PATH);
+        return EXIT_FAILURE;
+    }
+    struct calib c;
+    calib_load(CALIB_PATH, &c);   /* keep the fan that isn't measured now */
+    int orig[2] = { fan1_duty_read(), fan2_duty_read() };
+    if (orig[0] < 0 || orig[1] < 0) {
+        fprintf(stderr, "EC read failed (%s)\n", ec_transport_name());
+        return EXIT_FAILURE;
+    }
+    printf("Calibrating (a few minutes per fan, Ctrl+C to abort)\n");
+
+    int rc = 0;
+    for (int f = 0; f < 2 && rc == 0; f++) {
+        if (!(fan_mask & (1 << f))) continue;
+        struct fan_calib fc;
+        rc = calibrate_fan(cfg, f, &fc);
+        if (rc == 0) c.fan[f] = fc;
+    }
+    // After max_temp the fans stay at 100%
+    if (rc == 0 || g_stop) fans_duty_write(orig[0], orig[1]);
+    if (rc != 0) {
+        fprintf(stderr, "Aborted, nothing saved\n");
+        return EXIT_FAILURE;
+    }
+
+    c.stamp = (long long)time(NULL);
+    (void)mkdir(REC_DIR, 0755);   /* a failure shows up in calib_save */
+    if (calib_save(CALIB_PATH, &c) != 0) {
+        fprintf(stderr, "%s: %s\n", CALIB_PATH, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("Saved to %s (use with fan_target = rpm)\n", CALIB_PATH);
+    return 0;
+}
+
+/* ------------------------ Export ------------------------ */
+
+/* Every recorded sample in [from_ms, to_ms] (wall clock), oldest first */
+static int cmd_export(const char *dir, int64_t from_ms, int64_t to_ms) {
+    struct rec_reader r;
+    if (rec_reader_open(&r, dir) != 0) {
+        fprintf(stderr, "No trace files in %s: %s\n", dir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("time,cpu_temp,gpu_temp,duty1,duty2,rpm1,rpm2,cpu_load,cycle_us,throttle\n");
+    struct rec_sample s;
+    unsigned long n = 0;
+    while (rec_next(&r, &s) == 1) {
+        if (s.real_ms < from_ms || s.real_ms > to_ms) continue;
+        printf("%lld.%03d,%d,%d,%d,%d,%d,%d,", (long long)(s.real_ms / 1000), (int)(s.real_ms % 1000),
+               s.cpu_temp, s.gpu_temp, s.duty1, s.duty2, s.rpm1, s.rpm2);
+        if (s.cpu_load >= 0) printf("%d", s.cpu_load);
+        printf(",%d,%d\n", s.cycle_us, (s.flags & REC_F_THROTTLE) ? 1 : 0);
+        n++;
+    }
+    rec_reader_close(&r);
+    fprintf(stderr, "%lu samples\n", n);
+    return 0;
+}
 
-        /* Try temp1_input .. temp10_input */
-        for (int i = 1; i <= 10; i++) {
-            char fn[32];
-            int m = snprintf(fn, sizeof(fn), "temp%d_input", i);
-            if (m < 0 || (size_t)m >= sizeof(fn)) continue;
+/* Unix seconds, or -N[s|m|h|d] before now; 0 on success */
+static int parse_when(const char *s, int64_t *out_ms) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s) return 1;
+    if (*s != '-') {
+        if (*end) return 1;
+        *out_ms = (int64_t)(v * 1000.0);
+        return 0;
+    }
+    double unit = 1;
+    if (*end == 'm') unit = 60;
+    else if (*end == 'h') unit = 3600;
+    else if (*end == 'd') unit = 86400;
+    else if (*end && *end != 's') return 1;
+    if (*end && end[1]) return 1;
+    *out_ms = (int64_t)time(NULL) * 1000 + (int64_t)(v * unit * 1000.0);
+    return 0;
+}
 
-            int tfd = openat(hwfd, fn, O_RDONLY);
-            if (tfd < 0) continue;
+/* ----------------------- Simulate ----------------------- */
 
-            char buf[32] = {0};
-            ssize_t r = read(tfd, buf, sizeof(buf) - 1);
-            close(tfd);
-            if (r <= 0) continue;
+/* Every input x controller; EXIT_FAILURE on regressions against the baseline */
+static int cmd_simulate(const struct config *cfg, const struct sim_opts *so) {
+    double threshold = so->threshold_c >= 0 ? so->threshold_c : cfg->max_temp_c - 5;
+    FILE *save = NULL;
+    if (so->save && !(save = fopen(so->save, "we"))) {
+        fprintf(stderr, "%s: %s\n", so->save, strerror(errno));
+        return EXIT_FAILURE;
+    }
 
-            int milli = atoi(buf);          /* millidegC */
-            if (milli > 0) {
-                int c = milli / 1000;       /* °C */
-                if (c > best) best = c;     /* pick the hottest as GPU temp */
+    printf("threshold %.0f°C, %s%s\n", threshold, so->independent ? "independent fans" : "hotter-of",
+           so->noise ? ", +-1°C sensor noise" : "");
+    // The model has a CPU and a GPU side only, no per-sensor temps
+    if (cfg->nzones > 0) printf("(%d zones not simulated: the fans follow the CPU/GPU sides)\n", cfg->nzones);
+    printf("%-8s %-6s %8s %7s %6s %9s %9s %7s %7s %13s\n", "input", "ctl", "above_s", "peak_c", "mean_c",
+           "mean_duty", "duty_int", "changes", "cycles", "latency avg/max");
+
+    int regressions = 0, rc = EXIT_SUCCESS;
+    for (int i = 0; ; i++) {
+        struct sim_input in;
+        const char *name;
+        if (so->trace) {
+            if (i > 0) break;
+            name = "trace";
+            if (sim_trace(&in, so->trace, so->from_ms, so->to_ms) != 0) {
+                fprintf(stderr, "No recorded samples in %s: %s\n", so->trace, strerror(errno));
+                rc = EXIT_FAILURE;
+                break;
+            }
+        } else if (so->profile && strcmp(so->profile, "all") != 0) {
+            if (i > 0) break;
+            name = so->profile;
+            if (sim_profile(&in, name) != 0) {
+                fprintf(stderr, "Unknown profile: %s\n", name);
+                rc = EXIT_FAILURE;
+                break;
             }
+        } else {
+            if (!(name = sim_profile_name_at(i))) break;
+            sim_profile(&in, name);
         }
 
-        close(hwfd);
+        for (int ctl = CONTROLLER_CURVE; ctl <= CONTROLLER_PID; ctl++) {
+            if (so->controller >= 0 && ctl != so->controller) continue;
+            const char *ctl_name = ctl == CONTROLLER_PID ? "pid" : "curve";
+            struct sim_metrics m;
+            sim_run(cfg, ctl, so->independent, &in, threshold, so->noise, &m);
+
+            char lat[32];
+            snprintf(lat, sizeof(lat), "%.1f/%.1fs%s", m.latency_avg_s, m.latency_max_s,
+                     m.responded < m.steps ? "*" : "");
+            printf("%-8s %-6s %8.1f %7.1f %6.1f %8.1f%% %9.0f %7lu %7lu %13s\n", name, ctl_name,
+                   m.above_s, m.peak_c, m.mean_temp_c, m.mean_duty, m.duty_integral, m.changes, m.cycles, lat);
+
+            char key[64];
+            snprintf(key, sizeof(key), "%s.%s", name, ctl_name);
+            if (save) sim_baseline_write(save, key, &m);
+            if (so->baseline) {
+                int r = sim_baseline_check(so->baseline, key, &m, stdout);
+                if (r < 0) printf("  (no baseline for %s)\n", key);
+                else regressions += r;
+            }
+        }
+        sim_free(&in);
     }
+    if (save) fclose(save);
+    if (so->baseline) printf("%d regression%s against %s\n", regressions, regressions == 1 ? "" : "s", so->baseline);
+    return (regressions > 0) ? EXIT_FAILURE : rc;
+}
+
+/* ----------------------- Realtime ----------------------- */
 
-    closedir(d);
-    return best;
+/* Best effort, each step reported: the loop still runs without them */
+static void rt_setup(int priority, int cpu) {
+    if (priority > 0) {
+        if (rt_lock_memory() != 0) fprintf(stderr, "mlockall: %s\n", strerror(errno));
+        rt_prefault();
+    }
+    if (cpu >= 0 && rt_pin_cpu(cpu) != 0) fprintf(stderr, "Pinning to CPU %d: %s\n", cpu, strerror(errno));
+    if (priority > 0 && rt_set_fifo(priority) != 0) fprintf(stderr, "SCHED_FIFO %d: %s\n", priority, strerror(errno));
 }
 
-/* Fallback for NVIDIA: parse nvidia-smi (if installed) */
-static int gpu_temp_nvidia_smi(void) {
-    if (!path_exists("/usr/bin/nvidia-smi")) return -1;
-    FILE *p = popen("/usr/bin/nvidia-smi --query-gpu=temperature.gpu --format=csv,noheader,nounits 2>/dev/null", "r");
-    if (!p) return -1;
-    char buf[64] = {0};
-    if (!fgets(buf, sizeof(buf), p)) { pclose(p); return -1; }
-    pclose(p);
-    int t = atoi(buf);
-    if (t > 0 && t < 130) return t;
-    return -1;
+/* ------------------------ Config ------------------------ */
+
+/* path NULL: CONFIG_PATH if it exists, else the built-in defaults */
+static int load_config(const char *path, struct config *cfg) {
+    char err[256];
+    if (config_load(path ? path : CONFIG_PATH, path == NULL, cfg, err, sizeof(err)) != 0) {
+        fprintf(stderr, "Config: %s\n", err);
+        return -1;
+    }
+    ec_set_wait_deadline_us(cfg->ec_deadline_us);   /* 0: build default */
+    return 0;
 }
 
-/* Small helpers */
-static int path_exists(const char *path) { return access(path, F_OK) == 0; }
+/* ------------------- Sensing helpers -------------------- */
+
+/* Prefer driver temps for GPU; fall back to the EC value from the snapshot.
+   quiet: never spawn nvidia-smi (idle profile) */
+static int gpu_temp(const struct ec_snapshot *snap, int quiet) {
+    int t = gpu_temp_driver(quiet);
+    if (t > 0) return t;
+    return snap->gpu_temp; /* may be 0 on some models */
+}
@@ -0,0 +1,83 @@
+/*
+ * pid.c
+ *
+ * Positional PID on the hotter temperature with:
+ *   - derivative on the measurement (no kick on setpoint changes), low-pass
+ *     filtered with d_tau_s so one noisy EC reading can't spike the fans
+ *   - conditional integration as anti-windup: the integral only grows while
+ *     the output isn't saturated in that direction, and stays within 0..100
+ *   - bumpless start: the integral is primed so the first output equals the
+ *     fan's current duty
+ *   - asymmetric rate limits in %/s, scaled by the actual (adaptive) period
+ */
+
+#include "pid.h"
+#include "util.h"
+
+#define PID_MAX_DT_S  10.0   /* longer gaps (suspend, stalls) count as this */
+
+static double clamp_d(double v, double lo, double hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void pid_reset(struct pid_state *p) {
+    p->integ = 0.0;
+    p->t_filt = 0.0;
+    p->last_us = 0;
+    p->out = 0.0;
+    p->duty = 0.0;
+    p->applied = 0;
+}
+
+int pid_update(struct pid_state *p, const struct pid_params *k,
+               int temp_c, int prev_pct, int min_duty_pct, long long now_us) {
+    double t = (double)temp_c;
+    double err = t - k->setpoint_c;
+
+    if (p->last_us == 0) {
+        p->t_filt = t;
+        p->integ = clamp_d((double)prev_pct - k->kp * err, 0.0, 100.0);
+        p->last_us = now_us;
+        p->out = clamp_d(k->kp * err + p->integ, 0.0, 100.0);
+        p->duty = prev_pct;
+        p->applied = prev_pct;
+        return prev_pct;
+    }
+
+    double dt = (double)(now_us - p->last_us) / 1e6;
+    if (dt <= 0.0) { p->applied = prev_pct; return prev_pct; }
+    if (dt > PID_MAX_DT_S) dt = PID_MAX_DT_S;
+    p->last_us = now_us;
+
+    /* Filtered derivative of the measurement */
+    double alpha = dt / (k->d_tau_s + dt);
+    double prev_filt = p->t_filt;
+    p->t_filt += alpha * (t - p->t_filt);
+    double dtemp = (p->t_filt - prev_filt) / dt;
+
+    double u = k->kp * err + p->integ + k->kd * dtemp;
+
+    /* Anti-windup: integrate unless it would push further into saturation */
+    double di = k->ki * err * dt;
+    if ((u < 100.0 || di < 0.0) && (u > 0.0 || di > 0.0)) {
+        p->integ = clamp_d(p->integ + di, 0.0, 100.0);
+        u = k->kp * err + p->integ + k->kd * dtemp;
+    }
+    p->out = clamp_d(u, 0.0, 100.0);
+
+    /* Slew from the fractional duty so sub-% steps per cycle still add up;
+       resync if someone else moved the fan */
+    if (prev_pct != p->applied) p->duty = prev_pct;
+    double up = k->rate_up * dt, down = k->rate_down * dt;
+    double next = p->out;
+    if (next > p->duty + up)   next = p->duty + up;
+    if (next < p->duty - down) next = p->duty - down;
+    p->duty = next;
+
+    /* Start at min_duty, stop only well below it */
+    int duty = (int)(next + 0.5);
+    if (prev_pct == 0 && duty < min_duty_pct) duty = 0;
+    else if (duty < min_duty_pct) duty = (next >= min_duty_pct / 2.0) ? min_duty_pct : 0;
+    p->applied = clamp(duty, 0, 100);
+    return p->applied;
+}
@@ -0,0 +1,45 @@
+/*
+ * pid.h
+ *
+ * PID duty controller for auto mode (--controller=pid): holds the hotter
+ * temperature at a setpoint instead of following the curve.
+ */
+
+#ifndef FAN_CONTROL_PID_H
+#define FAN_CONTROL_PID_H
+
+/* Defaults, overridable in the config file (pid_* keys) */
+#define PID_DEFAULT_SETPOINT_C  65.0
+#define PID_DEFAULT_KP          4.0    /* % per °C above the setpoint */
+#define PID_DEFAULT_KI          0.1    /* % per °C·s */
+#define PID_DEFAULT_KD          8.0    /* % per °C/s of (filtered) rise */
+#define PID_DEFAULT_D_TAU_S     2.0    /* derivative low-pass time constant */
+#define PID_DEFAULT_RATE_UP     25.0   /* max ramp-up, %/s: react to spikes */
+#define PID_DEFAULT_RATE_DOWN   2.0    /* max ramp-down, %/s: no audible pumping */
+
+struct pid_params {
+    double setpoint_c;
+    double kp, ki, kd;
+    double d_tau_s;
+    double rate_up, rate_down;   /* %/s */
+};
+
+struct pid_state {
+    double    integ;       /* integral term, % (clamped, see anti-windup) */
+    double    t_filt;      /* low-passed temperature for the D term */
+    long long last_us;     /* previous update, 0 = not primed */
+    double    out;         /* unlimited output of the last update, % */
+    double    duty;        /* rate-limited output, fractional % */
+    int       applied;     /* what the last update returned */
+};
+
+/* Forget the history; the next update starts bumpless from the fan's duty */
+void pid_reset(struct pid_state *p);
+
+/* One step at now_us. prev_pct is the duty currently applied; returns the
+   next duty after rate limiting (0, or min_duty_pct..100). p->out holds the
+   unlimited controller output. */
+int  pid_update(struct pid_state *p, const struct pid_params *k,
+                int temp_c, int prev_pct, int min_duty_pct, long long now_us);
+
+#endif /* FAN_CONTROL_PID_H */
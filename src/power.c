@@ -0,0 +1,125 @@
+/*
+ * power.c
+ *
+ *   - AC: /sys/class/power_supply/<type Mains>/online
+ *   - dGPU: /sys/bus/pci/devices/<display class, not boot_vga>/power/runtime_status
+ *     ("suspended" while the driver has powered it down)
+ *
+ * Files are found once and the fds kept open; each query is one pread().
+ * Touching hwmon, NVML or gpu_busy_percent of a suspended dGPU resumes it,
+ * so the idle profile asks here first.
+ */
+
+#include "power.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+#define POWER_SUPPLY_ROOT     "/sys/class/power_supply"
+#define PCI_DEVICES_ROOT      "/sys/bus/pci/devices"
+#define POWER_MAX_FDS         4
+
+static struct {
+    int ac_fds[POWER_MAX_FDS];     /* Mains "online" */
+    int n_ac;
+    int gpu_fds[POWER_MAX_FDS];    /* dGPU power/runtime_status */
+    int n_gpu;
+    int scanned;
+} g_power;
+
+static int read_small(int fd, char *buf, size_t len);
+static int read_file(const char *path, char *buf, size_t len);
+
+int power_init(void) {
+    power_close();
+    g_power.scanned = 1;
+
+    char path[512], buf[32];
+    DIR *d = opendir(POWER_SUPPLY_ROOT);
+    if (d) {
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL && g_power.n_ac < POWER_MAX_FDS) {
+            if (de->d_name[0] == '.') continue;
+            snprintf(path, sizeof(path), POWER_SUPPLY_ROOT "/%s/type", de->d_name);
+            if (read_file(path, buf, sizeof(buf)) <= 0 || strcmp(buf, "Mains") != 0) continue;
+            snprintf(path, sizeof(path), POWER_SUPPLY_ROOT "/%s/online", de->d_name);
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) g_power.ac_fds[g_power.n_ac++] = fd;
+        }
+        closedir(d);
+    }
+
+    d = opendir(PCI_DEVICES_ROOT);
+    if (d) {
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL && g_power.n_gpu < POWER_MAX_FDS) {
+            if (de->d_name[0] == '.') continue;
+            /* Display controllers (class 0x03xxxx) that did not boot the console */
+            snprintf(path, sizeof(path), PCI_DEVICES_ROOT "/%s/class", de->d_name);
+            if (read_file(path, buf, sizeof(buf)) <= 0 || strncmp(buf, "0x03", 4) != 0) continue;
+            snprintf(path, sizeof(path), PCI_DEVICES_ROOT "/%s/boot_vga", de->d_name);
+            if (read_file(path, buf, sizeof(buf)) > 0 && strcmp(buf, "1") == 0) continue;
+
+            snprintf(path, sizeof(path), PCI_DEVICES_ROOT "/%s/power/runtime_status", de->d_name);
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) g_power.gpu_fds[g_power.n_gpu++] = fd;
+        }
+        closedir(d);
+    }
+    return g_power.n_ac + g_power.n_gpu;
+}
+
+void power_close(void) {
+    for (int i = 0; i < g_power.n_ac; i++)  close(g_power.ac_fds[i]);
+    for (int i = 0; i < g_power.n_gpu; i++) close(g_power.gpu_fds[i]);
+    g_power.n_ac = g_power.n_gpu = 0;
+    g_power.scanned = 0;
+}
+
+int power_on_ac(void) {
+    if (!g_power.scanned) power_init();
+    int known = 0;
+    for (int i = 0; i < g_power.n_ac; i++) {
+        char buf[8];
+        if (read_small(g_power.ac_fds[i], buf, sizeof(buf)) <= 0) continue;
+        if (buf[0] == '1') return 1;       /* any adapter online */
+        known = 1;
+    }
+    return known ? 0 : -1;
+}
+
+int power_dgpu_suspended(void) {
+    if (!g_power.scanned) power_init();
+    if (g_power.n_gpu == 0) return -1;
+    for (int i = 0; i < g_power.n_gpu; i++) {
+        char buf[16];
+        if (read_small(g_power.gpu_fds[i], buf, sizeof(buf)) <= 0) return -1;
+        if (strcmp(buf, "suspended") != 0) return 0;
+    }
+    return 1;
+}
+
+int power_set_timer_slack_us(long us) {
+    return prctl(PR_SET_TIMERSLACK, (unsigned long)(us > 0 ? us * 1000 : 0), 0, 0, 0);
+}
+
+/* pread into a NUL-terminated buffer without the trailing newline */
+static int read_small(int fd, char *buf, size_t len) {
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    if (n <= 0) return (int)n;
+    buf[n] = 0;
+    if (buf[n - 1] == '\n') buf[--n] = 0;
+    return (int)n;
+}
+
+static int read_file(const char *path, char *buf, size_t len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int n = read_small(fd, buf, len);
+    close(fd);
+    return n;
+}
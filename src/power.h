@@ -0,0 +1,25 @@
+/*
+ * power.h
+ *
+ * Power source and dGPU runtime-PM state for the low-power idle profile.
+ * Everything read here is a PM-core or power_supply attribute: reading it
+ * never wakes the device.
+ */
+
+#ifndef FAN_CONTROL_POWER_H
+#define FAN_CONTROL_POWER_H
+
+/* Cache the mains "online" and dGPU runtime_status fds; returns the number found */
+int  power_init(void);
+void power_close(void);
+
+/* 1 on AC, 0 on battery, -1 unknown (no mains supply found) */
+int  power_on_ac(void);
+
+/* 1 if every discrete GPU is runtime-suspended, 0 if any is active, -1 unknown */
+int  power_dgpu_suspended(void);
+
+/* prctl(PR_SET_TIMER_SLACK); 0 restores the default; 0 on success */
+int  power_set_timer_slack_us(long us);
+
+#endif /* FAN_CONTROL_POWER_H */
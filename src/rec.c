@@ -0,0 +1,462 @@
+/*
+ * rec.c
+ *
+ * Trace recorder and reader (format in rec.h). Files are allocated in full
+ * when created - by the worker, ahead of the rotation - so a full disk
+ * shows up as a failed preparation, never as SIGBUS in the middle of a
+ * cycle.
+ */
+
+#include "rec.h"
+#include "util.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Both record layouts tile the slot array */
+typedef char rec_delta_size_check[sizeof(struct rec_delta) == REC_SLOT_SIZE ? 1 : -1];
+typedef char rec_key_size_check[sizeof(struct rec_key) == 2 * REC_SLOT_SIZE ? 1 : -1];
+
+static int  rec_path(char *buf, size_t len, const char *dir, int file);
+static int  rec_read_header(const char *dir, int file, struct rec_header *out, size_t *size);
+static int  rec_room(struct rec_writer *w, unsigned nslots);
+static int  rec_swap(struct rec_writer *w);
+static void rec_put(struct rec_writer *w, const void *rec, unsigned nslots);
+static void rec_header_init(struct rec_header *h, uint64_t seq, uint64_t slots);
+static int  rec_window_map(const struct rec_writer *w, int file, uint64_t first,
+                           struct rec_header *h, struct rec_window *out);
+static void rec_window_unmap(struct rec_window *win, int header);
+static void rec_next_window(const struct rec_writer *w, const struct rec_window *win, int *file, uint64_t *first);
+static void *rec_worker(void *arg);
+static int  reader_map(struct rec_reader *r);
+
+/* ---------------------- Writer ------------------------ */
+
+int rec_open(struct rec_writer *w, const char *dir, int files, int file_mb) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->dir, sizeof(w->dir), "%s", dir);
+    w->files = clamp(files, 1, REC_MAX_FILES);
+    w->size  = (size_t)clamp(file_mb, 1, 4096) << 20;
+    w->slots = (w->size - REC_HEADER_SIZE) / REC_SLOT_SIZE;
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+
+    /* Continue in the newest file if it still has the configured size */
+    int newest = -1;
+    uint64_t seq = 0;
+    for (int i = 0; i < w->files; i++) {
+        struct rec_header h;
+        size_t size;
+        if (rec_read_header(dir, i, &h, &size) == 0 && h.seq > seq) { seq = h.seq; newest = i; }
+    }
+    int resumed = 0;
+    if (newest >= 0) {
+        struct rec_header h;
+        size_t size;
+        resumed = rec_read_header(dir, newest, &h, &size) == 0 && size == w->size && h.used + 2 <= h.slots &&
+                  rec_window_map(w, newest, h.used - h.used % REC_WINDOW_SLOTS, NULL, &w->cur) == 0;
+    }
+    /* Nothing usable (or full, or resized): next generation in the file after the newest */
+    if (!resumed) {
+        if (rec_window_map(w, (newest + 1) % w->files, 0, NULL, &w->cur) != 0) return -1;
+        rec_header_init(w->cur.h, seq + 1, w->slots);
+    }
+    w->need_key = 1;
+    w->ahead = w->cur;
+    w->spare_state = REC_SPARE_WANTED;
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_cond_init(&w->wake, &ca);
+    pthread_condattr_destroy(&ca);
+    pthread_mutex_init(&w->lock, NULL);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, REC_STACK_SIZE);
+    int rc = pthread_create(&w->thread, &attr, rec_worker, w);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        pthread_cond_destroy(&w->wake);
+        pthread_mutex_destroy(&w->lock);
+        rec_window_unmap(&w->cur, 1);
+        errno = rc;
+        return -1;
+    }
+    w->running = 1;
+    return 0;
+}
+
+int rec_append(struct rec_writer *w, const struct telem_sample *s) {
+    if (!w->cur.h) return 0;
+
+    struct rec_sample cur = {
+        .real_ms  = (int64_t)(s->real_ns / 1000000),
+        .cpu_temp = clamp(s->cpu_temp_c, 0, 255),
+        .gpu_temp = clamp(s->gpu_temp_c, 0, 255),
+        .duty1    = s->duty1,
+        .duty2    = s->duty2,
+        .rpm1     = s->rpm1,
+        .rpm2     = s->rpm2,
+        .cpu_load = s->cpu_load_pct,
+        .cycle_us = s->cycle_us < 65535 ? (int)s->cycle_us : 65535,
+        .flags    = s->throttle_boost > 0 ? REC_F_THROTTLE : 0,
+    };
+    int64_t mono_ms = (int64_t)(s->mono_ns / 1000000);
+
+    int64_t dt   = mono_ms - w->prev_mono_ms;
+    int d_cpu    = cur.cpu_temp - w->prev.cpu_temp;
+    int d_gpu    = cur.gpu_temp - w->prev.gpu_temp;
+    /* Round against the reconstructed value, so the error stays < REC_RPM_UNIT/2 */
+    int d_rpm1   = (cur.rpm1 - w->prev.rpm1 + (cur.rpm1 >= w->prev.rpm1 ? REC_RPM_UNIT / 2 : -REC_RPM_UNIT / 2)) / REC_RPM_UNIT;
+    int d_rpm2   = (cur.rpm2 - w->prev.rpm2 + (cur.rpm2 >= w->prev.rpm2 ? REC_RPM_UNIT / 2 : -REC_RPM_UNIT / 2)) / REC_RPM_UNIT;
+    int fits = !w->need_key && w->since_key < REC_KEY_EVERY && dt >= 0 && dt <= 65535 &&
+               d_cpu >= -128 && d_cpu <= 127 && d_gpu >= -128 && d_gpu <= 127 &&
+               d_rpm1 >= -128 && d_rpm1 <= 127 && d_rpm2 >= -128 && d_rpm2 <= 127;
+
+    if (fits) {
+        struct rec_delta d = {
+            .flags = (uint8_t)cur.flags,
+            .duty1 = (uint8_t)cur.duty1, .duty2 = (uint8_t)cur.duty2,
+            .d_cpu = (int8_t)d_cpu, .d_gpu = (int8_t)d_gpu,
+            .cpu_load = (uint8_t)cur.cpu_load,
+            .dt_ms = (uint16_t)dt,
+            .cycle_us = (uint16_t)cur.cycle_us,
+            .d_rpm1 = (int8_t)d_rpm1, .d_rpm2 = (int8_t)d_rpm2,
+        };
+        if (rec_room(w, 1) != 0) return -1;
+        if (w->need_key) return rec_append(w, s);   /* rotated: new file, keyframe first */
+        rec_put(w, &d, 1);
+        cur.real_ms = w->prev.real_ms + dt;
+        cur.rpm1 = w->prev.rpm1 + d_rpm1 * REC_RPM_UNIT;
+        cur.rpm2 = w->prev.rpm2 + d_rpm2 * REC_RPM_UNIT;
+        w->since_key++;
+    } else {
+        struct rec_key k = {
+            .flags = (uint8_t)(REC_F_KEY | cur.flags),
+            .duty1 = (uint8_t)cur.duty1, .duty2 = (uint8_t)cur.duty2,
+            .cpu = (uint8_t)cur.cpu_temp, .gpu = (uint8_t)cur.gpu_temp,
+            .cpu_load = (uint8_t)cur.cpu_load,
+            .cycle_us = (uint16_t)cur.cycle_us,
+            .rpm1 = (uint16_t)cur.rpm1, .rpm2 = (uint16_t)cur.rpm2,
+            .real_ms = (uint64_t)cur.real_ms,
+        };
+        if (rec_room(w, 2) != 0) return -1;
+        rec_put(w, &k, 2);
+        w->since_key = 0;
+        w->need_key = 0;
+    }
+    w->prev = cur;
+    w->prev_mono_ms = mono_ms;
+    return 0;
+}
+
+void rec_close(struct rec_writer *w) {
+    if (w->running) {
+        pthread_mutex_lock(&w->lock);
+        w->quit = 1;
+        pthread_cond_signal(&w->wake);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);   /* at most one file allocation away */
+        pthread_cond_destroy(&w->wake);
+        pthread_mutex_destroy(&w->lock);
+        w->running = 0;
+        if (w->have_retired) rec_window_unmap(&w->retired, w->retired.h != w->cur.h);
+        if (w->spare_state == REC_SPARE_READY) rec_window_unmap(&w->spare, w->spare.h != w->cur.h);
+        w->have_retired = 0;
+        w->spare_state = REC_SPARE_WANTED;
+    }
+    if (w->cur.h) rec_window_unmap(&w->cur, 1);
+}
+
+/* Make room for nslots at used: swap in the next window (or file) once
+   the record would start past this one - or not fit the file at all */
+static int rec_room(struct rec_writer *w, unsigned nslots) {
+    uint64_t used = w->cur.h->used;
+    int last = w->cur.first + REC_WINDOW_SLOTS >= w->slots;
+    int past = last ? used + nslots > w->slots : used >= w->cur.first + REC_WINDOW_SLOTS;
+    return past ? rec_swap(w) : 0;
+}
+
+/* Control loop: never blocks, no syscalls but the wakeup */
+static int rec_swap(struct rec_writer *w) {
+    int state = __atomic_load_n(&w->spare_state, __ATOMIC_ACQUIRE);
+    if (state != REC_SPARE_READY) {
+        errno = (state == REC_SPARE_FAILED && w->spare_err) ? w->spare_err : EAGAIN;
+        return -1;
+    }
+    if (pthread_mutex_trylock(&w->lock) != 0) { errno = EAGAIN; return -1; }
+    struct rec_window old = w->cur;
+    w->cur = w->spare;
+    if (w->cur.first == 0) {
+        /* New generation: the header is the writer's to rewrite */
+        rec_header_init(w->cur.h, old.h->seq + 1, w->slots);
+        w->need_key = 1;
+    }
+    w->retired = old;
+    w->have_retired = 1;
+    __atomic_store_n(&w->spare_state, REC_SPARE_WANTED, __ATOMIC_RELEASE);
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+/* Copy a record in and publish it by bumping used (readers may be mapping too) */
+static void rec_put(struct rec_writer *w, const void *rec, unsigned nslots) {
+    uint64_t used = w->cur.h->used;
+    memcpy(w->cur.slots + (used - w->cur.first) * REC_SLOT_SIZE, rec, nslots * REC_SLOT_SIZE);
+    __atomic_store_n(&w->cur.h->used, used + nslots, __ATOMIC_RELEASE);
+}
+
+static void rec_header_init(struct rec_header *h, uint64_t seq, uint64_t slots) {
+    __atomic_store_n(&h->used, 0, __ATOMIC_RELEASE);   /* first: a reader never sees stale records */
+    h->version   = REC_VERSION;
+    h->slot_size = REC_SLOT_SIZE;
+    h->seq       = seq;
+    h->slots     = slots;
+    memcpy(h->magic, REC_MAGIC, sizeof(h->magic));   /* last: marks the header complete */
+}
+
+/* Map slots [first, first + REC_WINDOW_SLOTS] of trace.<file>, and its header
+   page unless h is given (a later window of the same file). A file without
+   the configured size is (re)allocated in full first */
+static int rec_window_map(const struct rec_writer *w, int file, uint64_t first,
+                          struct rec_header *h, struct rec_window *out) {
+    char path[320];
+    if (rec_path(path, sizeof(path), w->dir, file) != 0) { errno = ENAMETOOLONG; return -1; }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) { int e = errno; close(fd); errno = e; return -1; }
+    if ((size_t)sb.st_size != w->size) {
+        int rc = ftruncate(fd, 0) == 0 ? posix_fallocate(fd, 0, (off_t)w->size) : errno;
+        if (rc == EOPNOTSUPP || rc == EINVAL) rc = ftruncate(fd, (off_t)w->size) == 0 ? 0 : errno;
+        if (rc != 0) { close(fd); errno = rc; return -1; }
+    }
+
+    void *hp = NULL;
+    if (!h) {
+        hp = mmap(NULL, REC_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (hp == MAP_FAILED) { int e = errno; close(fd); errno = e; return -1; }
+        h = hp;
+    }
+    /* From the page the window starts in (not every page size divides 48 KB) */
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    off_t  off  = (off_t)(REC_HEADER_SIZE + first * REC_SLOT_SIZE);
+    off_t  base = off - off % (off_t)page;
+    size_t len  = (size_t)(off - base) + (REC_WINDOW_SLOTS + 1) * REC_SLOT_SIZE;
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+    int e = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        if (hp) munmap(hp, REC_HEADER_SIZE);
+        errno = e;
+        return -1;
+    }
+    *out = (struct rec_window){
+        .h = h, .slots = (uint8_t *)p + (off - base), .map = p, .len = len, .first = first, .file = file,
+    };
+    return 0;
+}
+
+static void rec_window_unmap(struct rec_window *win, int header) {
+    if (win->map) munmap(win->map, win->len);
+    if (header && win->h) munmap(win->h, REC_HEADER_SIZE);
+    win->map = NULL;
+    win->h = NULL;
+}
+
+/* The window after win: the same file further on, else the next file's first */
+static void rec_next_window(const struct rec_writer *w, const struct rec_window *win, int *file, uint64_t *first) {
+    if (win->first + REC_WINDOW_SLOTS < w->slots) {
+        *file = win->file;
+        *first = win->first + REC_WINDOW_SLOTS;
+    } else {
+        *file = (win->file + 1) % w->files;
+        *first = 0;
+    }
+}
+
+/* Keeps one window ready ahead of the writer and unmaps the ones it is done with */
+static void *rec_worker(void *arg) {
+    struct rec_writer *w = arg;
+    struct timespec retry = { 0, 0 };
+
+    pthread_mutex_lock(&w->lock);
+    while (!w->quit) {
+        int want = w->spare_state == REC_SPARE_WANTED;
+        if (w->spare_state == REC_SPARE_FAILED) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            want = now.tv_sec > retry.tv_sec || (now.tv_sec == retry.tv_sec && now.tv_nsec >= retry.tv_nsec);
+        }
+        if (!want && !w->have_retired) {
+            if (w->spare_state == REC_SPARE_FAILED) pthread_cond_timedwait(&w->wake, &w->lock, &retry);
+            else pthread_cond_wait(&w->wake, &w->lock);
+            continue;
+        }
+        struct rec_window old = w->retired, ahead = w->ahead;
+        int unmap = w->have_retired;
+        w->have_retired = 0;
+        pthread_mutex_unlock(&w->lock);
+
+        // The writer moved on from old: its header page stays if the file did not change
+        if (unmap) rec_window_unmap(&old, old.h != ahead.h);
+
+        struct rec_window win;
+        int rc = 0, file = 0;
+        uint64_t first = 0;
+        if (want) {
+            rec_next_window(w, &ahead, &file, &first);
+            rc = rec_window_map(w, file, first, first ? ahead.h : NULL, &win);
+        }
+        int e = errno;
+
+        pthread_mutex_lock(&w->lock);
+        if (want && rc == 0) {
+            w->spare = win;
+            w->ahead = win;
+            __atomic_store_n(&w->spare_state, REC_SPARE_READY, __ATOMIC_RELEASE);
+        } else if (want) {
+            w->spare_err = e;
+            __atomic_store_n(&w->spare_state, REC_SPARE_FAILED, __ATOMIC_RELEASE);
+            clock_gettime(CLOCK_MONOTONIC, &retry);
+            retry.tv_sec += REC_RETRY_MS / 1000;
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+static int rec_path(char *buf, size_t len, const char *dir, int file) {
+    int n = snprintf(buf, len, "%s/" REC_FILE_PREFIX "%d", dir, file);
+    return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+/* 0 if trace.<file> exists and has a header this build understands */
+static int rec_read_header(const char *dir, int file, struct rec_header *out, size_t *size) {
+    char path[320];
+    if (rec_path(path, sizeof(path), dir, file) != 0) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat sb;
+    ssize_t n = pread(fd, out, sizeof(*out), 0);
+    int ok = fstat(fd, &sb) == 0 && n == (ssize_t)sizeof(*out) &&
+             memcmp(out->magic, REC_MAGIC, sizeof(out->magic)) == 0 &&
+             out->version == REC_VERSION && out->slot_size == REC_SLOT_SIZE &&
+             (uint64_t)sb.st_size >= REC_HEADER_SIZE + out->slots * REC_SLOT_SIZE &&
+             out->used <= out->slots;
+    close(fd);
+    *size = ok ? (size_t)sb.st_size : 0;
+    return ok ? 0 : -1;
+}
+
+/* ---------------------- Reader ------------------------ */
+
+int rec_reader_open(struct rec_reader *r, const char *dir) {
+    memset(r, 0, sizeof(*r));
+    snprintf(r->dir, sizeof(r->dir), "%s", dir);
+
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    uint64_t seqs[REC_MAX_FILES];
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && r->nfiles < REC_MAX_FILES) {
+        if (strncmp(e->d_name, REC_FILE_PREFIX, strlen(REC_FILE_PREFIX)) != 0) continue;
+        char *end;
+        long file = strtol(e->d_name + strlen(REC_FILE_PREFIX), &end, 10);
+        if (*end || file < 0 || file >= REC_MAX_FILES) continue;
+
+        struct rec_header h;
+        size_t size;
+        if (rec_read_header(dir, (int)file, &h, &size) != 0) continue;
+        /* Insertion sort by generation */
+        int i = r->nfiles++;
+        while (i > 0 && seqs[i - 1] > h.seq) { seqs[i] = seqs[i - 1]; r->order[i] = r->order[i - 1]; i--; }
+        seqs[i] = h.seq;
+        r->order[i] = (int)file;
+    }
+    closedir(d);
+    if (r->nfiles == 0) { errno = ENOENT; return -1; }
+    r->cur = -1;
+    return 0;
+}
+
+int rec_next(struct rec_reader *r, struct rec_sample *out) {
+    for (;;) {
+        if (!r->map || r->pos >= r->used) {
+            if (r->map) munmap((void *)r->map, r->size);
+            r->map = NULL;
+            if (++r->cur >= r->nfiles) return 0;
+            if (reader_map(r) != 0) continue;
+            r->have_key = 0;    /* every file starts over */
+        }
+
+        const uint8_t *slot = r->map + REC_HEADER_SIZE + r->pos * REC_SLOT_SIZE;
+        if (slot[0] & REC_F_KEY) {
+            if (r->pos + 2 > r->used) { r->pos = r->used; continue; }
+            struct rec_key k;
+            memcpy(&k, slot, sizeof(k));
+            r->pos += 2;
+            r->prev = (struct rec_sample){
+                .real_ms = (int64_t)k.real_ms,
+                .cpu_temp = k.cpu, .gpu_temp = k.gpu,
+                .duty1 = k.duty1, .duty2 = k.duty2,
+                .rpm1 = k.rpm1, .rpm2 = k.rpm2,
+                .cpu_load = k.cpu_load == 255 ? -1 : k.cpu_load,
+                .cycle_us = k.cycle_us,
+                .flags = k.flags & ~REC_F_KEY,
+            };
+            r->have_key = 1;
+        } else {
+            struct rec_delta d;
+            memcpy(&d, slot, sizeof(d));
+            r->pos++;
+            if (!r->have_key) continue;
+            r->prev.real_ms  += d.dt_ms;
+            r->prev.cpu_temp += d.d_cpu;
+            r->prev.gpu_temp += d.d_gpu;
+            r->prev.duty1     = d.duty1;
+            r->prev.duty2     = d.duty2;
+            r->prev.rpm1     += d.d_rpm1 * REC_RPM_UNIT;
+            r->prev.rpm2     += d.d_rpm2 * REC_RPM_UNIT;
+            r->prev.cpu_load  = d.cpu_load == 255 ? -1 : d.cpu_load;
+            r->prev.cycle_us  = d.cycle_us;
+            r->prev.flags     = d.flags;
+        }
+        *out = r->prev;
+        return 1;
+    }
+}
+
+void rec_reader_close(struct rec_reader *r) {
+    if (r->map) munmap((void *)r->map, r->size);
+    r->map = NULL;
+}
+
+static int reader_map(struct rec_reader *r) {
+    struct rec_header h;
+    if (rec_read_header(r->dir, r->order[r->cur], &h, &r->size) != 0) return -1;
+    char path[320];
+    rec_path(path, sizeof(path), r->dir, r->order[r->cur]);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    void *p = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+    r->map = p;
+    r->pos = 0;
+    /* The writer may still be appending: take used as of now */
+    r->used = __atomic_load_n(&((const struct rec_header *)p)->used, __ATOMIC_ACQUIRE);
+    return 0;
+}
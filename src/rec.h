@@ -0,0 +1,164 @@
+/*
+ * rec.h
+ *
+ * Long-term trace recorder: every auto cycle is appended to a rotating set
+ * of pre-allocated, mmap'd files in REC_DIR (trace.0 .. trace.N-1), weeks
+ * of history in a few tens of MB. "fan-cli export" turns them into CSV.
+ *
+ * File layout:
+ *
+ *   struct rec_header    (magic, version, generation, capacity, used)
+ *   padding up to REC_HEADER_SIZE
+ *   12-byte slots        [slots]
+ *
+ * A record is one delta slot (values relative to the previous record), or
+ * a keyframe of two slots with absolute values and the wall clock. Every
+ * file starts with a keyframe, and so does every append after a restart,
+ * a value that doesn't fit a delta, or REC_KEY_EVERY records.
+ * Deltas are taken against what the decoder will reconstruct, so the
+ * RPM quantization (REC_RPM_UNIT) never accumulates.
+ */
+
+#ifndef FAN_CONTROL_REC_H
+#define FAN_CONTROL_REC_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+#ifndef REC_DIR
+#define REC_DIR             "/var/lib/fan-control"
+#endif
+#define REC_FILE_PREFIX     "trace."
+#define REC_MAGIC           "FCTRACE"          /* 8 bytes with the NUL */
+#define REC_VERSION         1
+#define REC_HEADER_SIZE     4096               /* slots start page-aligned */
+#define REC_SLOT_SIZE       12
+#define REC_KEY_EVERY       1024               /* records between forced keyframes */
+#define REC_RPM_UNIT        16                 /* delta RPM resolution */
+#define REC_MAX_FILES       64
+
+#define REC_DEFAULT_FILES   4
+#define REC_DEFAULT_FILE_MB 16                 /* ~1.4M records: 16 days at 1 Hz per file */
+
+/* Record flags (first byte of every record) */
+#define REC_F_KEY           0x80               /* keyframe: this slot and the next */
+#define REC_F_THROTTLE      0x01               /* CPU throttle boost active */
+
+struct rec_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t seq;           /* file generation; the newest file has the highest */
+    uint64_t slots;         /* capacity */
+    uint64_t used;          /* slots written so far */
+};
+
+/* One slot: everything relative to the previous record */
+struct rec_delta {
+    uint8_t  flags;
+    uint8_t  duty1, duty2;  /* %, absolute (a byte either way) */
+    int8_t   d_cpu, d_gpu;  /* °C */
+    uint8_t  cpu_load;      /* %, 255 = unknown */
+    uint16_t dt_ms;         /* CLOCK_MONOTONIC since the previous record */
+    uint16_t cycle_us;      /* saturates at 65535 */
+    int8_t   d_rpm1, d_rpm2;   /* REC_RPM_UNIT steps */
+};
+
+/* Two slots: absolute values */
+struct rec_key {
+    uint8_t  flags;         /* REC_F_KEY | ... */
+    uint8_t  duty1, duty2;
+    uint8_t  cpu, gpu;      /* °C */
+    uint8_t  cpu_load;
+    uint16_t cycle_us;
+    uint16_t rpm1, rpm2;
+    uint32_t reserved;
+    uint64_t real_ms;       /* CLOCK_REALTIME */
+};
+
+/* Decoded record */
+struct rec_sample {
+    int64_t real_ms;
+    int cpu_temp, gpu_temp;
+    int duty1, duty2;
+    int rpm1, rpm2;
+    int cpu_load;           /* -1 = unknown */
+    int cycle_us;
+    int flags;
+};
+
+/* --- Writer (control loop): appending is a memcpy, no syscalls ---
+ *
+ * Only the header page and a REC_WINDOW_SLOTS window of slots are mapped,
+ * so mlockall() (rt.h) pins a few pages instead of the whole file. A worker
+ * thread maps the next window - or allocates the next file, at rotation -
+ * ahead of the writer, which swaps it in and hands the old one back. Not
+ * ready (or failed: a full disk) means the record is dropped and the
+ * worker retries every REC_RETRY_MS.
+ */
+#define REC_WINDOW_SLOTS    4096               /* 48 KB; page-aligned offsets */
+#define REC_RETRY_MS        30000
+#define REC_STACK_SIZE      (64 * 1024)        /* mlockall() locks it whole */
+
+enum { REC_SPARE_WANTED, REC_SPARE_READY, REC_SPARE_FAILED };
+
+struct rec_window {
+    struct rec_header *h;   /* header page of trace.<file> */
+    uint8_t *slots;         /* slot [first]; one slot past the window mapped too */
+    void    *map;           /* the window mapping ... */
+    size_t   len;           /* ... and its length */
+    uint64_t first;
+    int      file;
+};
+
+struct rec_writer {
+    char  dir[256];
+    int   files;
+    size_t size;            /* per file, header included */
+    uint64_t slots;         /* per file */
+    struct rec_window cur;  /* cur.h NULL: not recording */
+    struct rec_sample prev; /* as the decoder will see it */
+    int64_t prev_mono_ms;
+    unsigned since_key;
+    int   need_key;
+
+    /* Shared with the worker, under lock (spare_state also read atomically) */
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    int   running, quit;
+    int   spare_state;      /* REC_SPARE_* */
+    int   spare_err;        /* errno of the failed preparation */
+    struct rec_window spare, ahead;   /* prepared / last one handed out */
+    struct rec_window retired;        /* swapped out, for the worker to unmap */
+    int   have_retired;
+};
+
+/* Continue in the newest file of dir (creating dir and files as needed) and
+   start the worker; 0 or -1/errno */
+int  rec_open(struct rec_writer *w, const char *dir, int files, int file_mb);
+/* 0, or -1/errno if the record was dropped (EAGAIN: next window not ready) */
+int  rec_append(struct rec_writer *w, const struct telem_sample *s);
+void rec_close(struct rec_writer *w);   /* also fine on a zeroed, never opened w */
+
+/* --- Reader: all files of dir, oldest first --- */
+struct rec_reader {
+    char   dir[256];
+    int    nfiles;
+    int    order[REC_MAX_FILES];   /* file numbers by generation */
+    int    cur;                    /* index into order */
+    const uint8_t *map;
+    size_t size;
+    uint64_t pos, used;            /* slots */
+    struct rec_sample prev;
+    int    have_key;               /* deltas before the first keyframe are skipped */
+};
+
+int  rec_reader_open(struct rec_reader *r, const char *dir);   /* -1 if no trace files */
+int  rec_next(struct rec_reader *r, struct rec_sample *out);  /* 1: got one, 0: end */
+void rec_reader_close(struct rec_reader *r);
+
+#endif /* FAN_CONTROL_REC_H */
@@ -0,0 +1,52 @@
+/*
+ * rt.c
+ *
+ * Under full load a SCHED_OTHER process sleeping between samples gets
+ * starved, and its page faults queue behind heavy I/O. The usual remedy:
+ * lock everything, fault it in once, then run at a low real-time priority.
+ */
+
+#define _GNU_SOURCE
+#include "rt.h"
+
+#include <malloc.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int rt_lock_memory(void) {
+    /* Freed memory stays in the (locked) heap; no mmap'ed chunks that come and go */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    return mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+
+void rt_prefault(void) {
+    /* volatile: the compiler must not drop the stores */
+    volatile char stack[RT_PREFAULT_STACK];
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+    for (size_t i = 0; i < sizeof(stack); i += (size_t)page) stack[i] = 0;
+
+    char *heap = malloc(RT_PREFAULT_HEAP);
+    if (heap) {
+        memset(heap, 0, RT_PREFAULT_HEAP);
+        free(heap);       /* kept by the allocator, see rt_lock_memory() */
+    }
+}
+
+int rt_set_fifo(int priority) {
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = priority;
+    return sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &sp);
+}
+
+int rt_pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
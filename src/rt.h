@@ -0,0 +1,29 @@
+/*
+ * rt.h
+ *
+ * Real-time setup for the control loop (--realtime): SCHED_FIFO, locked
+ * and pre-faulted memory, optional pinning to a housekeeping CPU.
+ * Each step is separate so the caller can report what failed.
+ */
+
+#ifndef FAN_CONTROL_RT_H
+#define FAN_CONTROL_RT_H
+
+#define RT_DEFAULT_PRIORITY   10          /* modest: above SCHED_OTHER, below IRQ threads (50) */
+#define RT_PREFAULT_STACK     (256 * 1024)
+#define RT_PREFAULT_HEAP      (512 * 1024)
+
+/* mlockall(MCL_CURRENT | MCL_FUTURE) and keep freed heap instead of
+   returning it to the kernel; 0 on success */
+int rt_lock_memory(void);
+
+/* Touch stack and heap up front so the loop never page-faults on them */
+void rt_prefault(void);
+
+/* SCHED_FIFO at priority, not inherited by children (nvidia-smi); 0 on success */
+int rt_set_fifo(int priority);
+
+/* Pin the calling thread to cpu; 0 on success */
+int rt_pin_cpu(int cpu);
+
+#endif /* FAN_CONTROL_RT_H */
@@ -0,0 +1,138 @@
+/*
+ * sampler.c
+ *
+ * Picks the auto-mode period from how fast the temperature moves and how
+ * close it is to a curve knee:
+ *   - moving fast or near a knee  -> min period right away
+ *   - stable, far, duty settled   -> period grows by 1.5x per cycle up to max
+ *   - anything else               -> back toward the base period
+ *
+ * Wakeups use an absolute timerfd deadline so the period does not drift by
+ * the time spent doing EC I/O. The wait can also watch one extra fd (the
+ * control socket) without moving the deadline. Deadlines can optionally be
+ * aligned to a coarse grid to batch wakeups with the rest of the system.
+ */
+
+#include "sampler.h"
+#include "util.h"
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static int abs_i(int v) { return v < 0 ? -v : v; }
+
+int sampler_init(struct sampler *s, int min_ms, int max_ms) {
+    s->period_ms = SAMPLER_BASE_MS;
+    sampler_set_bounds(s, min_ms, max_ms);
+    s->rate_c_s = 0.0;
+    s->last_temp = 0;
+    s->last_us = 0;
+    s->deadline_us = 0;
+    s->armed = 0;
+    s->align_ms = 0;
+
+    s->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    return (s->fd >= 0) ? 0 : -1;   /* sampler_wait() still works without it */
+}
+
+void sampler_set_bounds(struct sampler *s, int min_ms, int max_ms) {
+    s->min_ms = clamp(min_ms, SAMPLER_FLOOR_MS, SAMPLER_BASE_MS);
+    s->max_ms = (max_ms < SAMPLER_BASE_MS) ? SAMPLER_BASE_MS : max_ms;
+    s->period_ms = clamp(s->period_ms, s->min_ms, s->max_ms);
+}
+
+void sampler_set_align(struct sampler *s, int align_ms) {
+    s->align_ms = (align_ms > 0) ? align_ms : 0;
+}
+
+void sampler_close(struct sampler *s) {
+    if (s->fd >= 0) close(s->fd);
+    s->fd = -1;
+}
+
+void sampler_update(struct sampler *s, int temp_c, int knee_lo_c, int knee_hi_c, int settled) {
+    sampler_update_at(s, mono_us(), temp_c, knee_lo_c, knee_hi_c, settled);
+}
+
+void sampler_update_at(struct sampler *s, long long now, int temp_c, int knee_lo_c, int knee_hi_c, int settled) {
+    if (s->last_us != 0 && now > s->last_us) {
+        double dt = (double)(now - s->last_us) / 1e6;
+        double rate = fabs((double)(temp_c - s->last_temp)) / dt;
+        s->rate_c_s = 0.5 * s->rate_c_s + 0.5 * rate;   /* EMA: one noisy sample can't pin the period */
+    }
+    s->last_temp = temp_c;
+    s->last_us = now;
+
+    int knee = abs_i(temp_c - knee_lo_c);
+    if (abs_i(temp_c - knee_hi_c) < knee) knee = abs_i(temp_c - knee_hi_c);
+
+    int p = s->period_ms;
+    if (s->rate_c_s >= SAMPLER_FAST_RATE_C_S || knee <= SAMPLER_KNEE_NEAR_C) {
+        p = s->min_ms;
+    } else if (settled && s->rate_c_s <= SAMPLER_STABLE_RATE_C_S && knee > SAMPLER_KNEE_FAR_C) {
+        p = p + p / 2;
+    } else if (p > SAMPLER_BASE_MS) {
+        p = SAMPLER_BASE_MS;
+    } else if (p < SAMPLER_BASE_MS) {
+        p = p * 2;
+    }
+    s->period_ms = clamp(p, s->min_ms, s->max_ms);
+}
+
+int sampler_wait(struct sampler *s, int extra_fd) {
+    if (!s->armed) {
+        long long now = mono_us();
+        if (s->deadline_us == 0) s->deadline_us = now;
+        s->deadline_us += (long long)s->period_ms * 1000;
+        if (s->deadline_us < now) s->deadline_us = now;   /* overran: don't try to catch up */
+        if (s->align_ms > 0) {
+            long long a = (long long)s->align_ms * 1000;
+            s->deadline_us = (s->deadline_us + a - 1) / a * a;
+        }
+
+        struct itimerspec its = {0};
+        its.it_value.tv_sec  = (time_t)(s->deadline_us / 1000000);
+        its.it_value.tv_nsec = (long)(s->deadline_us % 1000000) * 1000;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+        if (s->fd >= 0 && timerfd_settime(s->fd, TFD_TIMER_ABSTIME, &its, NULL) != 0) {
+            close(s->fd);                                   /* fall back to poll timeouts */
+            s->fd = -1;
+        }
+        s->armed = 1;
+    }
+
+    for (;;) {
+        struct pollfd pfd[2];
+        int n = 0, timeout_ms = -1;
+        if (s->fd >= 0) {
+            pfd[n].fd = s->fd; pfd[n].events = POLLIN; n++;
+        } else {
+            long long left = s->deadline_us - mono_us();
+            if (left <= 0) { s->armed = 0; return 0; }
+            timeout_ms = (int)((left + 999) / 1000);
+        }
+        if (extra_fd >= 0) { pfd[n].fd = extra_fd; pfd[n].events = POLLIN; n++; }
+
+        int r = poll(pfd, (nfds_t)n, timeout_ms);
+        if (r < 0) {
+            if (errno == EINTR) return -1;
+            continue;
+        }
+        if (s->fd >= 0 && (pfd[0].revents & POLLIN)) {
+            uint64_t expirations;
+            if (read(s->fd, &expirations, sizeof(expirations)) < 0 && errno == EINTR) return -1;
+            s->armed = 0;
+            return 0;
+        }
+        if (extra_fd >= 0 && (pfd[n - 1].revents & POLLIN)) return 1;
+        if (r == 0 && s->fd < 0) { s->armed = 0; return 0; }
+    }
+}
+
+double sampler_rate_hz(const struct sampler *s) {
+    return 1000.0 / (double)s->period_ms;
+}
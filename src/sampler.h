@@ -0,0 +1,61 @@
+/*
+ * sampler.h
+ *
+ * Adaptive sampling period for auto mode, driven by a timerfd.
+ */
+
+#ifndef FAN_CONTROL_SAMPLER_H
+#define FAN_CONTROL_SAMPLER_H
+
+#define SAMPLER_MIN_MS         200    /* fastest period: spikes / near a knee */
+#define SAMPLER_BASE_MS        1000   /* normal period */
+#define SAMPLER_MAX_MS         5000   /* slowest period: stable and settled */
+#define SAMPLER_FLOOR_MS       10     /* min bound: SAMPLER_FLOOR_MS..SAMPLER_BASE_MS */
+#define SAMPLER_CEIL_MS        600000 /* max bound: SAMPLER_BASE_MS..SAMPLER_CEIL_MS */
+#define SAMPLER_FAST_RATE_C_S  1.0    /* |dT/dt| at/above this -> fastest period */
+#define SAMPLER_STABLE_RATE_C_S 0.1   /* |dT/dt| at/below this may stretch the period */
+#define SAMPLER_KNEE_NEAR_C    3      /* within this of a curve knee -> fastest period */
+#define SAMPLER_KNEE_FAR_C     8      /* stretch only when further than this */
+
+struct sampler {
+    int       fd;           /* CLOCK_MONOTONIC timerfd */
+    int       min_ms;
+    int       max_ms;
+    int       period_ms;    /* current period */
+    double    rate_c_s;     /* smoothed |dT/dt| */
+    int       last_temp;
+    long long last_us;      /* time of the previous sample, 0 = none */
+    long long deadline_us;  /* next absolute wakeup */
+    int       armed;        /* deadline_us is set for the current cycle */
+    int       align_ms;     /* round deadlines up to a multiple of this, 0 = off */
+};
+
+/* 0 on success (-1: no timerfd, falls back to usleep);
+   bounds are clamped so that min <= base <= max (config_load() and the
+   command line reject anything else, so this is a last line of defence) */
+int  sampler_init(struct sampler *s, int min_ms, int max_ms);
+void sampler_close(struct sampler *s);
+
+/* Change the bounds (config reload); takes effect from the next period */
+void sampler_set_bounds(struct sampler *s, int min_ms, int max_ms);
+
+/* Coarse wakeups: deadlines land on multiples of align_ms of CLOCK_MONOTONIC,
+   so they coincide with other aligned timers (0 = exact deadlines) */
+void sampler_set_align(struct sampler *s, int align_ms);
+
+/* Feed this cycle's temperature and the curve knees; picks the next period.
+   settled: the applied duty already equals the curve target */
+void sampler_update(struct sampler *s, int temp_c, int knee_lo_c, int knee_hi_c, int settled);
+
+/* Same at a given CLOCK_MONOTONIC time (the simulator runs on its own clock) */
+void sampler_update_at(struct sampler *s, long long now_us, int temp_c, int knee_lo_c, int knee_hi_c, int settled);
+
+/* Block until the next deadline (drift-free).
+   Returns 0 at the deadline, 1 if extra_fd (-1: none) became readable first
+   - call again to keep waiting for the same deadline - and -1 on a signal */
+int  sampler_wait(struct sampler *s, int extra_fd);
+
+/* Effective sampling rate in Hz */
+double sampler_rate_hz(const struct sampler *s);
+
+#endif /* FAN_CONTROL_SAMPLER_H */
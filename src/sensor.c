@@ -0,0 +1,208 @@
+/*
+ * sensor.c
+ *
+ * Sensor registry (sensor.h). The scan is the only place that walks
+ * sysfs; a cycle is one pread() per used hwmon sensor. A sensor that goes
+ * away (driver unload) just stops reading until the next scan.
+ */
+
+#include "sensor.h"
+#include "gpu.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HWMON_ROOT  "/sys/class/hwmon"
+#define HWMON_SLOTS (SENSOR_MAX - 3)   /* room left for ec/cpu, ec/gpu, gpu/driver */
+
+static struct {
+    struct sensor s[SENSOR_MAX];
+    int count;
+} g_sensors;
+
+static void read_line(int dirfd, const char *name, char *out, size_t len);
+static void sanitize(char *s);
+static int  name_taken(const char *name, int len);
+static void scan_hwmon(int rootfd, const char *dir);
+static struct sensor *sensor_add(int kind, const char *id);
+
+/* -------------------- registry -------------------- */
+
+int sensor_scan(void) {
+    sensor_close();
+
+    DIR *d = opendir(HWMON_ROOT);
+    if (d) {
+        int rootfd = dirfd(d);
+        struct dirent *de;
+        while (rootfd >= 0 && (de = readdir(d)) != NULL && g_sensors.count < HWMON_SLOTS) {
+            if (strncmp(de->d_name, "hwmon", 5) == 0) scan_hwmon(rootfd, de->d_name);
+        }
+        closedir(d);
+    }
+    sensor_add(SENSOR_EC_CPU, "ec/cpu");
+    sensor_add(SENSOR_EC_GPU, "ec/gpu");
+    sensor_add(SENSOR_GPU_DRIVER, "gpu/driver");
+    return g_sensors.count;
+}
+
+void sensor_close(void) {
+    for (int i = 0; i < g_sensors.count; i++) {
+        if (g_sensors.s[i].fd >= 0) close(g_sensors.s[i].fd);
+    }
+    g_sensors.count = 0;
+}
+
+int sensor_count(void) {
+    return g_sensors.count;
+}
+
+const struct sensor *sensor_at(int i) {
+    return (i >= 0 && i < g_sensors.count) ? &g_sensors.s[i] : NULL;
+}
+
+int sensor_match(const char *pattern, int *idx, int max) {
+    int n = 0;
+    for (int i = 0; i < g_sensors.count && n < max; i++) {
+        if (fnmatch(pattern, g_sensors.s[i].id, 0) == 0) idx[n++] = i;
+    }
+    return n;
+}
+
+void sensor_unuse_all(void) {
+    for (int i = 0; i < g_sensors.count; i++) g_sensors.s[i].used = 0;
+}
+
+void sensor_use(int i) {
+    if (i >= 0 && i < g_sensors.count) g_sensors.s[i].used = 1;
+}
+
+/* -------------------- hot path -------------------- */
+
+void sensor_update(int ec_cpu_c, int ec_gpu_c, int gpu_driver_c, int flags) {
+    for (int i = 0; i < g_sensors.count; i++) {
+        struct sensor *s = &g_sensors.s[i];
+        if (!s->used && !(flags & SENSOR_READ_ALL)) continue;
+
+        int c = -1;
+        switch (s->kind) {
+        case SENSOR_EC_CPU:     c = ec_cpu_c; break;
+        case SENSOR_EC_GPU:     c = ec_gpu_c; break;
+        case SENSOR_GPU_DRIVER: c = gpu_driver_c; break;
+        default: {
+            s->milli = -1;
+            if (s->gpu && (flags & SENSOR_SKIP_GPU)) continue;   /* reading it would wake the dGPU */
+            char buf[32];
+            ssize_t r = pread(s->fd, buf, sizeof(buf) - 1, 0);
+            if (r <= 0) continue;
+            buf[r] = 0;
+            int milli = atoi(buf);
+            if (milli > 0) s->milli = milli;
+            continue;
+        }
+        }
+        s->milli = (c > 0) ? c * 1000 : -1;
+    }
+}
+
+/* -------------------- scan -------------------- */
+
+/* Every tempN_input of one hwmon */
+static void scan_hwmon(int rootfd, const char *dir) {
+    int hwfd = openat(rootfd, dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (hwfd < 0) return;
+
+    char name[24];
+    read_line(hwfd, "name", name, sizeof(name));
+    if (!*name) snprintf(name, sizeof(name), "%.23s", dir);
+    sanitize(name);
+    int gpu = gpu_hwmon_name_is_gpu(name);
+
+    /* Second nvme etc.: "nvme_2" */
+    char base[24];
+    snprintf(base, sizeof(base), "%s", name);
+    for (int k = 2; name_taken(name, (int)strlen(name)) && k < 100; k++)
+        snprintf(name, sizeof(name), "%.20s_%d", base, k);
+
+    int dupfd = dup(hwfd);
+    DIR *d = (dupfd >= 0) ? fdopendir(dupfd) : NULL;
+    if (!d) {
+        if (dupfd >= 0) close(dupfd);
+        close(hwfd);
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL && g_sensors.count < HWMON_SLOTS) {
+        int n = -1, end = 0;
+        if (sscanf(de->d_name, "temp%d_input%n", &n, &end) != 1 || de->d_name[end] != 0) continue;
+
+        char fn[32], label[SENSOR_ID_MAX];
+        snprintf(fn, sizeof(fn), "temp%d_label", n);
+        read_line(hwfd, fn, label, sizeof(label));
+        if (*label) sanitize(label);
+        else snprintf(label, sizeof(label), "temp%d", n);
+
+        int tfd = openat(hwfd, de->d_name, O_RDONLY | O_CLOEXEC);
+        if (tfd < 0) continue;
+
+        char id[SENSOR_ID_MAX];
+        snprintf(id, sizeof(id), "%s/%.*s", name, (int)(sizeof(id) - strlen(name) - 2), label);
+        struct sensor *s = sensor_add(SENSOR_HWMON, id);
+        int m = snprintf(s->path, sizeof(s->path), "%s/%s/%s", HWMON_ROOT, dir, de->d_name);
+        if (m < 0 || (size_t)m >= sizeof(s->path)) s->path[0] = 0;
+        s->fd = tfd;
+        s->gpu = gpu;
+    }
+    closedir(d);
+    close(hwfd);
+}
+
+static struct sensor *sensor_add(int kind, const char *id) {
+    struct sensor *s = &g_sensors.s[g_sensors.count++];
+    memset(s, 0, sizeof(*s));
+    snprintf(s->id, sizeof(s->id), "%s", id);
+    s->kind = kind;
+    s->fd = -1;
+    s->milli = -1;
+    return s;
+}
+
+/* Does some registered hwmon sensor already use this name? */
+static int name_taken(const char *name, int len) {
+    for (int i = 0; i < g_sensors.count; i++) {
+        const char *id = g_sensors.s[i].id;
+        if (strncmp(id, name, (size_t)len) == 0 && id[len] == '/') return 1;
+    }
+    return 0;
+}
+
+/* First line of dirfd/name, "" if unreadable */
+static void read_line(int dirfd, const char *name, char *out, size_t len) {
+    out[0] = 0;
+    int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    ssize_t n = read(fd, out, len - 1);
+    close(fd);
+    if (n <= 0) { out[0] = 0; return; }
+    out[n] = 0;
+    out[strcspn(out, "\n")] = 0;
+}
+
+/* Lowercase, [a-z0-9] kept, runs of anything else become one '_' */
+static void sanitize(char *s) {
+    char *w = s;
+    for (const char *r = s; *r; r++) {
+        unsigned char ch = (unsigned char)*r;
+        if (isalnum(ch)) *w++ = (char)tolower(ch);
+        else if (w > s && w[-1] != '_') *w++ = '_';
+    }
+    while (w > s && w[-1] == '_') w--;
+    *w = 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * sensor.h
+ *
+ * Temperature sensor registry for zones (zone.h). Enumerated once (start,
+ * config reload): every hwmon tempN_input with its fd kept open, plus the
+ * inputs auto mode already has each cycle - the EC's CPU and GPU bytes
+ * and the GPU driver temp (gpu.h: hwmon, NVML or nvidia-smi, via gpumon.h).
+ *
+ * Ids are "<hwmon name>/<label>", lowercased with anything but [a-z0-9]
+ * turned into '_' ("coretemp/package_id_0", "amdgpu/junction"); "tempN"
+ * without a label, "<name>_2" for the second hwmon of the same name.
+ * The others are "ec/cpu", "ec/gpu" and "gpu/driver".
+ */
+
+#ifndef FAN_CONTROL_SENSOR_H
+#define FAN_CONTROL_SENSOR_H
+
+#define SENSOR_MAX        64
+#define SENSOR_ID_MAX     40
+#define SENSOR_PATH_MAX   64
+
+enum { SENSOR_HWMON, SENSOR_EC_CPU, SENSOR_EC_GPU, SENSOR_GPU_DRIVER };
+
+/* sensor_update() flags */
+#define SENSOR_READ_ALL   0x1     /* every sensor, not only the ones zones use */
+#define SENSOR_SKIP_GPU   0x2     /* leave GPU driver hwmons alone (runtime-suspended dGPU) */
+
+struct sensor {
+    char id[SENSOR_ID_MAX];
+    char path[SENSOR_PATH_MAX];   /* hwmon only */
+    int  kind;                    /* SENSOR_* */
+    int  fd;                      /* hwmon: open tempN_input, else -1 */
+    int  gpu;                     /* hwmon of a GPU driver */
+    int  used;                    /* read by sensor_update() */
+    int  milli;                   /* latest reading, m°C; -1: none */
+};
+
+/* (Re)build the registry; returns the number of sensors */
+int  sensor_scan(void);
+void sensor_close(void);
+
+int  sensor_count(void);
+const struct sensor *sensor_at(int i);   /* NULL past the end */
+
+/* Indices of the sensors whose id matches the fnmatch() pattern, up to max */
+int  sensor_match(const char *pattern, int *idx, int max);
+
+/* Which sensors the next sensor_update() reads */
+void sensor_unuse_all(void);
+void sensor_use(int i);
+
+/* Refresh the used sensors: pread() for hwmon, the given values (°C, <= 0:
+   unknown) for the rest. A failed read leaves that sensor without a reading */
+void sensor_update(int ec_cpu_c, int ec_gpu_c, int gpu_driver_c, int flags);
+
+#endif /* FAN_CONTROL_SENSOR_H */
@@ -0,0 +1,318 @@
+/*
+ * sim.c
+ *
+ * Simulator (model and metrics in sim.h). Everything is deterministic:
+ * the same config and input always give the same numbers, so a baseline
+ * comparison only moves when the control algorithm or its tuning does.
+ */
+
+#include "sim.h"
+#include "control.h"
+#include "filter.h"
+#include "rec.h"
+#include "sampler.h"
+#include "util.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_TRACE_TAU_S   3.0    /* temp smoothing before differentiating a trace */
+#define SIM_TRACE_GAP_S   60.0   /* longer gaps (daemon stopped) are not differentiated */
+
+static const char *const g_profiles[] = { "step", "burst", "ramp", "game" };
+
+static int    sim_push(struct sim_input *in, int *cap, double t, double cpu_load, double gpu_load);
+static double sim_conductance(double duty_pct);
+static int    sim_baseline_get(FILE *f, const char *name, const char *metric, double *out);
+
+/* ---------------------- Inputs ------------------------ */
+
+const char *sim_profile_name_at(int i) {
+    return (i >= 0 && i < (int)(sizeof(g_profiles) / sizeof(g_profiles[0]))) ? g_profiles[i] : NULL;
+}
+
+/* 1 s resolution; heat follows load linearly between idle and max */
+int sim_profile(struct sim_input *in, const char *name) {
+    memset(in, 0, sizeof(*in));
+    in->t0_c = in->g0_c = SIM_AMBIENT_C + 15.0;
+    int cap = 0, rc = 0;
+
+    if (strcmp(name, "step") == 0) {            /* idle, 5 min full CPU load, idle */
+        for (int t = 0; t < 660 && rc == 0; t++)
+            rc = sim_push(in, &cap, t, (t >= 60 && t < 360) ? 100 : 5, 10);
+    } else if (strcmp(name, "burst") == 0) {    /* 10 s on / 20 s off, a build with pauses */
+        for (int t = 0; t < 600 && rc == 0; t++)
+            rc = sim_push(in, &cap, t, (t % 30) < 10 ? 100 : 5, 5);
+    } else if (strcmp(name, "ramp") == 0) {     /* slow up and down: hysteresis and smoothing */
+        for (int t = 0; t < 600 && rc == 0; t++) {
+            double l = (t < 300) ? t / 3.0 : (600 - t) / 3.0;
+            rc = sim_push(in, &cap, t, l, l / 2);
+        }
+    } else if (strcmp(name, "game") == 0) {     /* GPU-bound with moderate CPU */
+        for (int t = 0; t < 780 && rc == 0; t++) {
+            int on = (t >= 60 && t < 660);
+            rc = sim_push(in, &cap, t, on ? 50 : 5, on ? 95 : 5);
+        }
+    } else {
+        return -1;
+    }
+    return rc;
+}
+
+/* Heat per side from the recorded temps and duties: the model solved for P */
+int sim_trace(struct sim_input *in, const char *dir, int64_t from_ms, int64_t to_ms) {
+    memset(in, 0, sizeof(*in));
+    struct rec_reader r;
+    if (rec_reader_open(&r, dir) != 0) return -1;
+
+    int cap = 0, first = 1;
+    int64_t t0 = 0, prev_ms = 0;
+    double tc = 0, tg = 0;        /* smoothed temps */
+    struct rec_sample s;
+    while (rec_next(&r, &s) == 1) {
+        if (s.real_ms < from_ms || s.real_ms > to_ms) continue;
+        double load = s.cpu_load >= 0 ? s.cpu_load : 0;
+        if (first) {
+            t0 = prev_ms = s.real_ms;
+            tc = in->t0_c = s.cpu_temp;
+            tg = in->g0_c = s.gpu_temp;
+            first = 0;
+        }
+        double dt = (double)(s.real_ms - prev_ms) / 1000.0;
+        double pc = 0, pg = 0;
+        if (dt > 0 && dt < SIM_TRACE_GAP_S) {
+            double a = dt / (SIM_TRACE_TAU_S + dt);
+            double nc = tc + a * (s.cpu_temp - tc), ng = tg + a * (s.gpu_temp - tg);
+            pc = SIM_HEAT_CAP_J_K * (nc - tc) / dt + sim_conductance(s.duty1) * (nc - SIM_AMBIENT_C)
+                 - SIM_COUPLING_W_K * (ng - nc);
+            pg = SIM_HEAT_CAP_J_K * (ng - tg) / dt + sim_conductance(s.duty2) * (ng - SIM_AMBIENT_C)
+                 - SIM_COUPLING_W_K * (nc - ng);
+            tc = nc;
+            tg = ng;
+        } else {
+            tc = s.cpu_temp;
+            tg = s.gpu_temp;
+            pc = sim_conductance(s.duty1) * (tc - SIM_AMBIENT_C);   /* assume steady state */
+            pg = sim_conductance(s.duty2) * (tg - SIM_AMBIENT_C);
+        }
+        prev_ms = s.real_ms;
+        if (sim_push(in, &cap, (double)(s.real_ms - t0) / 1000.0, load, 0) != 0) break;
+        in->p[in->n - 1].cpu_w = pc > 0 ? pc : 0;
+        in->p[in->n - 1].gpu_w = pg > 0 ? pg : 0;
+    }
+    rec_reader_close(&r);
+    if (in->n == 0) { errno = ENOENT; return -1; }
+    return 0;
+}
+
+void sim_free(struct sim_input *in) {
+    free(in->p);
+    in->p = NULL;
+    in->n = 0;
+}
+
+static int sim_push(struct sim_input *in, int *cap, double t, double cpu_load, double gpu_load) {
+    if (in->n == *cap) {
+        int ncap = *cap ? *cap * 2 : 1024;
+        struct sim_point *p = realloc(in->p, (size_t)ncap * sizeof(*p));
+        if (!p) return -1;
+        in->p = p;
+        *cap = ncap;
+    }
+    in->p[in->n++] = (struct sim_point){
+        .t_s = t,
+        .cpu_w = SIM_CPU_IDLE_W + (SIM_CPU_MAX_W - SIM_CPU_IDLE_W) * cpu_load / 100.0,
+        .gpu_w = SIM_GPU_IDLE_W + (SIM_GPU_MAX_W - SIM_GPU_IDLE_W) * gpu_load / 100.0,
+        .cpu_load = cpu_load,
+        .gpu_load = gpu_load,
+    };
+    return 0;
+}
+
+static double sim_conductance(double duty_pct) {
+    return SIM_G_MIN_W_K + SIM_G_FAN_W_K * duty_pct / 100.0;
+}
+
+/* ------------------------ Run ------------------------- */
+
+void sim_run(const struct config *cfg, int controller, int independent, const struct sim_input *in,
+             double threshold_c, int noise, struct sim_metrics *m) {
+    memset(m, 0, sizeof(*m));
+    if (in->n == 0) return;
+
+    struct control c;
+    control_init(&c, controller, independent, 0, 0);
+    struct filter flt[2];
+    filter_reset(&flt[0]);
+    filter_reset(&flt[1]);
+    struct sampler smp;
+    sampler_init(&smp, cfg->min_interval_ms, cfg->max_interval_ms);
+    sampler_close(&smp);          /* only the period policy is used */
+
+    double temp[2] = { in->t0_c, in->g0_c };
+    double fan[2] = { 0, 0 };
+    int    cmd[2] = { 0, 0 };
+    double load_avg[2] = { 0, 0 };
+    long long last_ctl_us = 0, next_ctl_ms = 0;
+    unsigned rng = 12345;         /* LCG for the sensor noise */
+
+    int idx = 0;
+    double prev_load = in->p[0].cpu_load > in->p[0].gpu_load ? in->p[0].cpu_load : in->p[0].gpu_load;
+    double step_t = -1;           /* pending load step */
+    int    step_ref = 0;
+    double lat_sum = 0;
+
+    long long end_ms = (long long)(in->p[in->n - 1].t_s * 1000.0) + 1000;
+    const double dt = SIM_DT_MS / 1000.0;
+    const double fan_a = dt / (SIM_FAN_TAU_S + dt);
+    double temp_sum = 0;
+    unsigned long nsteps = 0;
+
+    for (long long t_ms = 0; t_ms < end_ms; t_ms += SIM_DT_MS) {
+        double t = (double)t_ms / 1000.0;
+        while (idx + 1 < in->n && in->p[idx + 1].t_s <= t) idx++;
+        const struct sim_point *p = &in->p[idx];
+
+        // Load steps for the response latency
+        double l = p->cpu_load > p->gpu_load ? p->cpu_load : p->gpu_load;
+        if (l - prev_load >= SIM_STEP_LOAD_PCT && step_t < 0) {
+            step_t = t;
+            step_ref = cmd[0] > cmd[1] ? cmd[0] : cmd[1];
+            m->steps++;
+        }
+        prev_load = l;
+
+        // Control cycle when the sampler's period is up
+        if (t_ms >= next_ctl_ms) {
+            long long now_us = t_ms * 1000 + 1;   /* 0 means "no previous sample" to the PID */
+            double ldt = last_ctl_us ? (double)(now_us - last_ctl_us) / 1e6 : 0.0;
+            double a = (ldt > 0.0) ? ldt / (cfg->ff.tau_s + ldt) : 0.0;
+            load_avg[0] += a * (p->cpu_load - load_avg[0]);
+            load_avg[1] += a * (p->gpu_load - load_avg[1]);
+            last_ctl_us = now_us;
+
+            // Same conditioning as the daemon: oversampled CPU reads, one GPU read
+            int sensed[2];
+            for (int f = 0; f < 2; f++) {
+                int raw[FILTER_MAX_SAMPLES];
+                int nraw = f ? 1 : cfg->filter.oversample;
+                for (int i = 0; i < nraw; i++) {
+                    int n = 0;
+                    if (noise) { rng = rng * 1103515245u + 12345u; n = (int)((rng >> 16) % 3) - 1; }
+                    raw[i] = (int)lround(temp[f]) + n;
+                }
+                sensed[f] = filter_step(&flt[f], &cfg->filter, raw, nraw, now_us);
+            }
+            struct control_input ci = {
+                .tc = sensed[0], .tg = sensed[1],
+                .cpu_load = load_avg[0], .gpu_load = load_avg[1],
+                .now_us = now_us,
+            };
+            control_step(&c, cfg, &ci);
+            for (int f = 0; f < 2; f++) {
+                if (c.last[f] != cmd[f]) m->changes++;
+                cmd[f] = c.last[f];
+            }
+            m->cycles++;
+
+            int hi = cmd[0] > cmd[1] ? cmd[0] : cmd[1];
+            if (step_t >= 0 && hi >= step_ref + SIM_RESPONSE_PCT) {
+                double lat = t - step_t;
+                lat_sum += lat;
+                if (lat > m->latency_max_s) m->latency_max_s = lat;
+                m->responded++;
+                step_t = -1;
+            } else if (step_t >= 0 && hi >= 100) {
+                step_t = -1;      /* nothing left to answer with: not a response */
+            }
+
+            sampler_update_at(&smp, now_us, c.th, control_knee(&c, cfg), cfg->max_temp_c, control_settled(&c));
+            next_ctl_ms = t_ms + smp.period_ms;
+        }
+
+        // Physics
+        double pw[2] = { p->cpu_w, p->gpu_w };
+        double nt[2];
+        for (int f = 0; f < 2; f++) {
+            fan[f] += fan_a * (cmd[f] - fan[f]);
+            double q = pw[f] - sim_conductance(fan[f]) * (temp[f] - SIM_AMBIENT_C)
+                       + SIM_COUPLING_W_K * (temp[1 - f] - temp[f]);
+            nt[f] = temp[f] + q / SIM_HEAT_CAP_J_K * dt;
+        }
+        temp[0] = nt[0];
+        temp[1] = nt[1];
+
+        double hot = temp[0] > temp[1] ? temp[0] : temp[1];
+        if (hot >= threshold_c) m->above_s += dt;
+        if (hot > m->peak_c) m->peak_c = hot;
+        temp_sum += hot;
+        m->duty_integral += (fan[0] + fan[1]) * dt;
+        nsteps++;
+    }
+
+    m->duration_s = (double)nsteps * dt;
+    m->mean_temp_c = temp_sum / (double)nsteps;
+    m->mean_duty = m->duty_integral / (2.0 * m->duration_s);
+    m->latency_avg_s = m->responded ? lat_sum / m->responded : 0.0;
+}
+
+/* ---------------------- Baseline ---------------------- */
+
+int sim_baseline_write(FILE *f, const char *name, const struct sim_metrics *m) {
+    return fprintf(f,
+                   "%s.above_s = %.1f\n%s.peak_c = %.1f\n%s.mean_duty = %.2f\n"
+                   "%s.duty_integral = %.0f\n%s.changes = %lu\n%s.latency_avg_s = %.2f\n",
+                   name, m->above_s, name, m->peak_c, name, m->mean_duty,
+                   name, m->duty_integral, name, m->changes, name, m->latency_avg_s) < 0 ? -1 : 0;
+}
+
+/* Worse than the baseline by more than rel (fraction) plus abs */
+struct sim_limit { const char *metric; double rel, abs; };
+static const struct sim_limit g_limits[] = {
+    { "above_s",       0.10, 1.0 },
+    { "peak_c",        0.00, 1.0 },
+    { "duty_integral", 0.05, 100.0 },
+    { "changes",       0.10, 5.0 },
+    { "latency_avg_s", 0.20, 0.5 },
+};
+
+int sim_baseline_check(const char *path, const char *name, const struct sim_metrics *m, FILE *out) {
+    FILE *f = fopen(path, "re");
+    if (!f) return -1;
+    const double now[] = { m->above_s, m->peak_c, m->duty_integral, (double)m->changes, m->latency_avg_s };
+    int bad = 0, found = 0;
+    for (int i = 0; i < (int)(sizeof(g_limits) / sizeof(g_limits[0])); i++) {
+        double base;
+        if (sim_baseline_get(f, name, g_limits[i].metric, &base) != 0) continue;
+        found++;
+        double limit = base * (1.0 + g_limits[i].rel) + g_limits[i].abs;
+        if (now[i] > limit) {
+            fprintf(out, "  REGRESSION %s.%s: %.2f (baseline %.2f, limit %.2f)\n",
+                    name, g_limits[i].metric, now[i], base, limit);
+            bad++;
+        }
+    }
+    fclose(f);
+    return found ? bad : -1;
+}
+
+static int sim_baseline_get(FILE *f, const char *name, const char *metric, double *out) {
+    char line[256], key[128];
+    snprintf(key, sizeof(key), "%s.%s", name, metric);
+    size_t klen = strlen(key);
+    rewind(f);
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncmp(p, key, klen) != 0) continue;
+        p += klen;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p != '=') continue;
+        char *end;
+        *out = strtod(p + 1, &end);
+        if (end != p + 1) return 0;
+    }
+    return -1;
+}
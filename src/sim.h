@@ -0,0 +1,85 @@
+/*
+ * sim.h
+ *
+ * Offline replay of the control loop (control.h, the real sampler policy)
+ * against a lumped thermal model, much faster than real time. Inputs are
+ * synthetic load profiles or recorded traces (rec.h), whose heat input is
+ * recovered by running the model backwards over the recorded temps and duties.
+ *
+ * Model, per side (CPU, GPU):
+ *   C dT/dt = P - (G_min + G_fan * fan) (T - T_amb) + K (T_other - T)
+ * with the fan following its commanded duty with time constant SIM_FAN_TAU_S.
+ */
+
+#ifndef FAN_CONTROL_SIM_H
+#define FAN_CONTROL_SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "config.h"
+
+/* --- Thermal model --- */
+#define SIM_AMBIENT_C        30.0
+#define SIM_CPU_IDLE_W       8.0
+#define SIM_CPU_MAX_W        90.0
+#define SIM_GPU_IDLE_W       6.0
+#define SIM_GPU_MAX_W        100.0
+#define SIM_G_MIN_W_K        0.35    /* fan stopped: passive only */
+#define SIM_G_FAN_W_K        1.45    /* added at 100% duty */
+#define SIM_HEAT_CAP_J_K     25.0
+#define SIM_COUPLING_W_K     0.4     /* shared heatpipes */
+#define SIM_FAN_TAU_S        1.5     /* spin-up/down */
+#define SIM_DT_MS            50      /* physics step */
+
+/* --- Metrics --- */
+#define SIM_STEP_LOAD_PCT    30      /* load rise that counts as a step ... */
+#define SIM_RESPONSE_PCT     5       /* ... answered once a duty rose this much */
+
+/* Input, piecewise constant from t_s on */
+struct sim_point {
+    double t_s;
+    double cpu_w, gpu_w;          /* heat */
+    double cpu_load, gpu_load;    /* utilization %, for the feed-forward */
+};
+
+struct sim_input {
+    struct sim_point *p;
+    int    n;
+    double t0_c, g0_c;            /* initial temps */
+};
+
+struct sim_metrics {
+    double duration_s;
+    double above_s;               /* hotter side at/above the threshold */
+    double peak_c;
+    double mean_temp_c;
+    double mean_duty;             /* actual fan duty, both fans, % */
+    double duty_integral;         /* %*s, both fans: noise / energy proxy */
+    unsigned long changes;        /* commanded duty changes = EC writes */
+    unsigned long cycles;         /* control cycles */
+    int    steps, responded;      /* load steps, and those the fans answered */
+    double latency_avg_s, latency_max_s;
+};
+
+/* Synthetic profiles: "step", "burst", "ramp", "game"; -1 if unknown */
+int  sim_profile(struct sim_input *in, const char *name);
+const char *sim_profile_name_at(int i);           /* NULL past the end */
+
+/* Recorded samples of dir within [from_ms, to_ms]; -1 if none */
+int  sim_trace(struct sim_input *in, const char *dir, int64_t from_ms, int64_t to_ms);
+
+void sim_free(struct sim_input *in);
+
+/* One run; noise: +-1 °C on the sensed temps (deterministic) */
+void sim_run(const struct config *cfg, int controller, int independent, const struct sim_input *in,
+             double threshold_c, int noise, struct sim_metrics *m);
+
+/* Baseline file: "<name>.<metric> = value" lines */
+int  sim_baseline_write(FILE *f, const char *name, const struct sim_metrics *m);
+
+/* Compare m to the baseline entry for name; prints regressions to out.
+   Returns the number of regressions, -1 if the baseline has no such entry */
+int  sim_baseline_check(const char *path, const char *name, const struct sim_metrics *m, FILE *out);
+
+#endif /* FAN_CONTROL_SIM_H */
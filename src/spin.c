@@ -0,0 +1,108 @@
+/*
+ * spin.c
+ *
+ * Per-fan start-up kick and stall detection (spin.h):
+ *
+ *   OFF     --target > 0-->  KICK (kick_pct for kick_ms), or RUN if the
+ *                            target is already at/above the kick duty
+ *   KICK    --kick_ms----->  RUN
+ *   RUN     --0 RPM for stall_ms--> KICK again, STALLED after SPIN_MAX_KICKS
+ *   STALLED --RPM > 0----->  RUN; otherwise a kick every SPIN_RETRY_MS
+ *   any     --target 0---->  OFF
+ *
+ * The RPM registers lag the duty by a second or so; stall_ms covers that.
+ */
+
+#include "spin.h"
+
+static void enter(struct spin *s, int state, long long now_us);
+static void running(struct spin *s, long long now_us);
+static int  kick(struct spin *s, const struct spin_params *k, int target_pct, long long now_us);
+
+void spin_init(struct spin *s, int duty_pct, long long now_us) {
+    s->state = (duty_pct > 0) ? SPIN_RUN : SPIN_OFF;
+    s->event = SPIN_EV_NONE;
+    s->kicks = 0;
+    s->failed = 0;
+    s->since_us = now_us;
+    s->starts = s->stalls = 0;
+}
+
+int spin_step(struct spin *s, const struct spin_params *k, int target_pct, int rpm, long long now_us) {
+    s->event = SPIN_EV_NONE;
+    if (target_pct <= 0) {
+        enter(s, SPIN_OFF, now_us);
+        return 0;
+    }
+    long long stall_us = (long long)k->stall_ms * 1000;
+
+    switch (s->state) {
+    case SPIN_OFF:
+        s->kicks = 0;
+        if (k->kick_pct > target_pct) {
+            s->starts++;
+            return kick(s, k, target_pct, now_us);
+        }
+        enter(s, SPIN_RUN, now_us);
+        return target_pct;
+
+    case SPIN_KICK:
+        if (now_us - s->since_us < (long long)k->kick_ms * 1000)
+            return (k->kick_pct > target_pct) ? k->kick_pct : target_pct;
+        enter(s, SPIN_RUN, now_us);
+        return target_pct;
+
+    case SPIN_RUN:
+        if (rpm != 0 || k->stall_ms <= 0) {
+            if (rpm > 0) running(s, now_us);
+            return target_pct;
+        }
+        if (now_us - s->since_us < stall_us) return target_pct;
+        s->stalls++;
+        if (s->kicks >= SPIN_MAX_KICKS) {
+            enter(s, SPIN_STALLED, now_us);
+            if (!s->failed) s->event = SPIN_EV_STALLED;
+            s->failed = 1;
+            return target_pct;
+        }
+        s->event = SPIN_EV_STALL;
+        return kick(s, k, target_pct, now_us);
+
+    case SPIN_STALLED:
+    default:
+        if (rpm > 0) {
+            s->state = SPIN_RUN;
+            running(s, now_us);
+            return target_pct;
+        }
+        if (now_us - s->since_us >= (long long)SPIN_RETRY_MS * 1000) {
+            s->kicks = SPIN_MAX_KICKS - 1;    /* one more try, then stalled again */
+            return kick(s, k, target_pct, now_us);
+        }
+        return target_pct;
+    }
+}
+
+static void enter(struct spin *s, int state, long long now_us) {
+    s->state = state;
+    s->since_us = now_us;
+}
+
+static void running(struct spin *s, long long now_us) {
+    s->kicks = 0;
+    s->since_us = now_us;
+    if (s->failed) s->event = SPIN_EV_RECOVERED;
+    s->failed = 0;
+}
+
+/* Without a kick duty (0) the stall retry still restarts the wait */
+static int kick(struct spin *s, const struct spin_params *k, int target_pct, long long now_us) {
+    s->kicks++;
+    if (s->event == SPIN_EV_NONE) s->event = SPIN_EV_KICK;
+    if (k->kick_pct <= target_pct) {
+        enter(s, SPIN_RUN, now_us);
+        return target_pct;
+    }
+    enter(s, SPIN_KICK, now_us);
+    return k->kick_pct;
+}
@@ -0,0 +1,54 @@
+/*
+ * spin.h
+ *
+ * Fan start-up and stall watch. A fan going from 0% to a low duty gets a
+ * short kick at a high duty first, then drops to its target; a fan that
+ * still reads 0 RPM at a non-zero duty after SPIN_DEFAULT_STALL_MS is
+ * kicked again, and after SPIN_MAX_KICKS failed kicks reported as stalled
+ * (and retried every SPIN_RETRY_MS).
+ */
+
+#ifndef FAN_CONTROL_SPIN_H
+#define FAN_CONTROL_SPIN_H
+
+/* Defaults, overridable in the config file (spinup_* / stall_timeout) */
+#define SPIN_DEFAULT_KICK_PCT   60     /* start duty (0: no kick), also the floor while kicking */
+#define SPIN_DEFAULT_KICK_MS    1500
+#define SPIN_DEFAULT_STALL_MS   4000   /* 0 RPM this long at duty > 0 -> stall (0: off) */
+#define SPIN_MAX_KICKS          3      /* consecutive failed kicks before "stalled" */
+#define SPIN_RETRY_MS           30000  /* stalled: another kick this often */
+
+struct spin_params {
+    int kick_pct;
+    int kick_ms;
+    int stall_ms;
+};
+
+enum { SPIN_OFF, SPIN_KICK, SPIN_RUN, SPIN_STALLED };
+
+/* What the latest spin_step() did, for the event log */
+enum { SPIN_EV_NONE, SPIN_EV_KICK, SPIN_EV_STALL, SPIN_EV_STALLED, SPIN_EV_RECOVERED };
+
+struct spin {
+    int       state;          /* SPIN_* */
+    int       event;          /* SPIN_EV_* of the latest step */
+    int       kicks;          /* consecutive kicks without RPM */
+    int       failed;         /* reported stalled, not yet recovered */
+    long long since_us;       /* entered the state / last saw RPM */
+    unsigned long starts;     /* kicked starts */
+    unsigned long stalls;     /* 0 RPM at duty > 0 */
+};
+
+/* duty_pct > 0 starts watching right away (the fan may already be running) */
+void spin_init(struct spin *s, int duty_pct, long long now_us);
+
+/* The duty to write for target_pct. rpm < 0: unknown (EC read failed),
+   no stall judgement this cycle */
+int  spin_step(struct spin *s, const struct spin_params *k, int target_pct, int rpm, long long now_us);
+
+/* Kicking or waiting on a kick: the sampler should not stretch its period */
+static inline int spin_busy(const struct spin *s) {
+    return s->state == SPIN_KICK;
+}
+
+#endif /* FAN_CONTROL_SPIN_H */
@@ -0,0 +1,104 @@
+/*
+ * state.c
+ *
+ * Checkpoint file (state.h), "key = value" lines like the calibration:
+ *
+ *   stamp = 1760000000
+ *   boot = 6f1c...
+ *   controller = 0
+ *   duty = 45 50
+ *   filter = x1 dx1 x2 dx2
+ *   pid = integ1 t_filt1 duty1 integ2 t_filt2 duty2
+ *   calib = <calibration stamp>
+ *   trim = t1 t2
+ *   sensor = /sys/class/hwmon/hwmon3/temp1_input     (one line each)
+ */
+
+#include "state.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int state_load(const char *path, struct state *s) {
+    memset(s, 0, sizeof(*s));
+    FILE *f = fopen(path, "re");
+    if (!f) return -1;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char key[32];
+        int off = 0;
+        if (line[0] == '#' || sscanf(line, " %31[^= \t] = %n", key, &off) != 1 || off == 0) continue;
+        const char *v = line + off;
+
+        if (strcmp(key, "stamp") == 0)           s->stamp = atoll(v);
+        else if (strcmp(key, "boot") == 0)       sscanf(v, "%39s", s->boot_id);
+        else if (strcmp(key, "controller") == 0) s->controller = atoi(v);
+        else if (strcmp(key, "duty") == 0)       sscanf(v, "%d %d", &s->duty[0], &s->duty[1]);
+        else if (strcmp(key, "filter") == 0)
+            sscanf(v, "%lf %lf %lf %lf", &s->filt_x[0], &s->filt_dx[0], &s->filt_x[1], &s->filt_dx[1]);
+        else if (strcmp(key, "pid") == 0)
+            sscanf(v, "%lf %lf %lf %lf %lf %lf", &s->pid_integ[0], &s->pid_t_filt[0], &s->pid_duty[0],
+                   &s->pid_integ[1], &s->pid_t_filt[1], &s->pid_duty[1]);
+        else if (strcmp(key, "calib") == 0)      s->calib_stamp = atoll(v);
+        else if (strcmp(key, "trim") == 0)       sscanf(v, "%lf %lf", &s->trim[0], &s->trim[1]);
+        else if (strcmp(key, "sensor") == 0 && s->nsensors < GPU_MAX_SENSORS) {
+            char *p = s->sensors[s->nsensors];
+            if (sscanf(v, "%63s", p) == 1) s->nsensors++;
+        }
+    }
+    int rc = ferror(f) ? -1 : 0;
+    fclose(f);
+    for (int i = 0; i < 2; i++)
+        if (s->duty[i] < 0 || s->duty[i] > 100) s->duty[i] = 0;
+    return rc;
+}
+
+int state_save(const char *path, const struct state *s) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "we");
+    if (!f) return -1;
+    fprintf(f, "# fan-control checkpoint, rewritten while auto/daemon runs\n");
+    fprintf(f, "stamp = %lld\nboot = %s\ncontroller = %d\n", s->stamp, s->boot_id, s->controller);
+    fprintf(f, "duty = %d %d\n", s->duty[0], s->duty[1]);
+    fprintf(f, "filter = %.3f %.4f %.3f %.4f\n", s->filt_x[0], s->filt_dx[0], s->filt_x[1], s->filt_dx[1]);
+    fprintf(f, "pid = %.4f %.3f %.3f %.4f %.3f %.3f\n", s->pid_integ[0], s->pid_t_filt[0], s->pid_duty[0],
+            s->pid_integ[1], s->pid_t_filt[1], s->pid_duty[1]);
+    fprintf(f, "calib = %lld\ntrim = %.3f %.3f\n", s->calib_stamp, s->trim[0], s->trim[1]);
+    for (int i = 0; i < s->nsensors; i++)
+        if (s->sensors[i][0]) fprintf(f, "sensor = %s\n", s->sensors[i]);
+    int rc = (fclose(f) == 0) ? 0 : -1;
+    if (rc == 0 && rename(tmp, path) != 0) rc = -1;
+    if (rc != 0) { int e = errno; remove(tmp); errno = e; }
+    return rc;
+}
+
+int state_fresh(const struct state *s) {
+    char boot[STATE_BOOT_ID_MAX];
+    state_boot_id(boot);
+    long long age = (long long)time(NULL) - s->stamp;
+    return boot[0] && strcmp(boot, s->boot_id) == 0 && age >= 0 && age <= STATE_MAX_AGE_S;
+}
+
+void state_boot_id(char out[STATE_BOOT_ID_MAX]) {
+    out[0] = 0;
+    int fd = open(STATE_BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    ssize_t n = read(fd, out, STATE_BOOT_ID_MAX - 1);
+    close(fd);
+    out[n > 0 ? n : 0] = 0;
+    out[strcspn(out, "\n")] = 0;
+}
+
+long long state_suspended_ms(void) {
+    struct timespec b, m;
+    clock_gettime(CLOCK_BOOTTIME, &b);
+    clock_gettime(CLOCK_MONOTONIC, &m);
+    return ((long long)b.tv_sec - m.tv_sec) * 1000 + (b.tv_nsec - m.tv_nsec) / 1000000;
+}
@@ -0,0 +1,57 @@
+/*
+ * state.h
+ *
+ * Controller checkpoint, so a restart or a resume from suspend controls
+ * correctly from the first cycle instead of ramping up from whatever the
+ * EC holds: the decided duty per fan (which also picks the hysteresis
+ * side of the curve), PID and temperature filter state, the resolved GPU
+ * sensor paths, and the RPM-mode trims with the calibration they belong to.
+ *
+ * auto/daemon write it every STATE_SAVE_MS and at exit. Only a checkpoint
+ * of the same boot, at most STATE_MAX_AGE_S old, restores the control
+ * state; the trims are kept whenever the calibration is the same.
+ *
+ * Resume is noticed in the loop itself: CLOCK_BOOTTIME runs on through
+ * suspend and CLOCK_MONOTONIC doesn't, so their difference jumps.
+ */
+
+#ifndef FAN_CONTROL_STATE_H
+#define FAN_CONTROL_STATE_H
+
+#include "gpu.h"
+#include "rec.h"
+
+#define STATE_PATH             REC_DIR "/state"
+#define STATE_SAVE_MS          60000
+#define STATE_MAX_AGE_S        900
+#define STATE_RESUME_JUMP_MS   2000     /* suspended at least this long: treat as a resume */
+#define STATE_BOOT_ID_PATH     "/proc/sys/kernel/random/boot_id"
+#define STATE_BOOT_ID_MAX      40
+
+struct state {
+    long long stamp;                    /* CLOCK_REALTIME, s */
+    char      boot_id[STATE_BOOT_ID_MAX];
+    int       controller;               /* CONTROLLER_* the PID state belongs to */
+    int       duty[2];                  /* decided (control's last[]) */
+    double    filt_x[2], filt_dx[2];    /* filter.h, CPU / GPU; have = filt_x > 0 */
+    double    pid_integ[2], pid_t_filt[2], pid_duty[2];
+    long long calib_stamp;              /* calibration the trims were learned on */
+    double    trim[2];
+    int       nsensors;
+    char      sensors[GPU_MAX_SENSORS][GPU_SENSOR_PATH_MAX];
+};
+
+/* 0 on success; -1/errno (missing file included) */
+int  state_load(const char *path, struct state *s);
+int  state_save(const char *path, const struct state *s);   /* tmp file + rename */
+
+/* Written by this boot, recently enough to restore the control state */
+int  state_fresh(const struct state *s);
+
+/* This boot's id ("" if unknown) */
+void state_boot_id(char out[STATE_BOOT_ID_MAX]);
+
+/* CLOCK_BOOTTIME - CLOCK_MONOTONIC: time spent suspended since boot, ms */
+long long state_suspended_ms(void);
+
+#endif /* FAN_CONTROL_STATE_H */
@@ -0,0 +1,61 @@
+/*
+ * telemetry.c
+ *
+ * Writer side of the /dev/shm telemetry ring (format in telemetry.h).
+ * Publishing is a memcpy plus a few atomic stores: no syscalls, no locks.
+ */
+
+#include "telemetry.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static struct telem_header *g_telem;
+
+int telem_open_writer(void) {
+    int fd = shm_open(TELEM_SHM_NAME, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)TELEM_SHM_SIZE) != 0) { close(fd); return -1; }
+
+    void *p = mmap(NULL, TELEM_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return -1;
+
+    /* Fresh ring each start; magic last so readers never see a half-made header */
+    struct telem_header *h = p;
+    memset(p, 0, TELEM_SHM_SIZE);
+    h->version     = TELEM_VERSION;
+    h->header_size = sizeof(struct telem_header);
+    h->slot_size   = sizeof(struct telem_slot);
+    h->slots       = TELEM_SLOTS;
+    h->writer_pid  = (uint32_t)getpid();
+    __atomic_store_n(&h->magic, TELEM_MAGIC, __ATOMIC_RELEASE);
+
+    g_telem = h;
+    return 0;
+}
+
+void telem_publish(const struct telem_sample *s) {
+    struct telem_header *h = g_telem;
+    if (!h) return;
+
+    uint64_t idx = h->head;
+    struct telem_slot *slot = &telem_slots(h)[idx % TELEM_SLOTS];
+
+    uint32_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);   /* odd: writing */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->s = *s;
+    slot->s.index = idx;
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);   /* even: stable */
+
+    __atomic_store_n(&h->head, idx + 1, __ATOMIC_RELEASE);
+}
+
+void telem_close_writer(void) {
+    if (!g_telem) return;
+    munmap(g_telem, TELEM_SHM_SIZE);
+    g_telem = NULL;
+    shm_unlink(TELEM_SHM_NAME);
+}
@@ -0,0 +1,102 @@
+/*
+ * telemetry.h
+ *
+ * Shared-memory telemetry ring: the control loop publishes every sample to
+ * /dev/shm/fan-control; readers mmap it read-only and never block the writer.
+ *
+ * This header is the format contract for out-of-tree readers and is
+ * self-contained (the reader helpers below are inline). Layout:
+ *
+ *   struct telem_header  (magic, version, sizes, head)
+ *   struct telem_slot    [slots]
+ *
+ * Each slot is a seqlock: seq is odd while the writer is inside it.
+ * head counts samples ever published; the newest is slot (head - 1) % slots.
+ * Compatible changes only append fields (check header_size/slot_size);
+ * anything else bumps TELEM_VERSION.
+ */
+
+#ifndef FAN_CONTROL_TELEMETRY_H
+#define FAN_CONTROL_TELEMETRY_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define TELEM_SHM_NAME   "/fan-control"   /* shm_open() name -> /dev/shm/fan-control */
+#define TELEM_MAGIC      0x434e4146u      /* "FANC" little-endian */
+#define TELEM_VERSION    1
+#define TELEM_SLOTS      256              /* ~4 min at 1 Hz, ~50 s at 5 Hz */
+
+struct telem_sample {
+    uint64_t index;         /* sample number (head value when it was written) */
+    uint64_t mono_ns;       /* CLOCK_MONOTONIC */
+    uint64_t real_ns;       /* CLOCK_REALTIME */
+    int16_t  cpu_temp_c;
+    int16_t  gpu_temp_c;
+    int16_t  hot_temp_c;    /* hotter of the two (what shared mode controls on) */
+    uint8_t  target_duty;   /* fan1 curve target, % */
+    uint8_t  duty1;         /* applied, % */
+    uint8_t  duty2;
+    uint8_t  target_duty2;  /* fan2 curve target, % (0 in writers before per-fan curves) */
+    uint8_t  cpu_load_pct;  /* utilization, % (255 = unknown; 0 in older writers) */
+    uint8_t  gpu_load_pct;
+    uint16_t rpm1;
+    uint16_t rpm2;
+    uint32_t cycle_us;      /* sense + decide + actuate */
+    /* appended: CPU throttle feedback */
+    uint32_t throttle_events;   /* CPU thermal throttle events since the writer started */
+    uint16_t throttle_per_min;  /* smoothed event rate */
+    uint16_t cpu_mhz;           /* average current clock, 0 = unknown */
+    uint8_t  throttle_boost;    /* duty added because of throttling, % */
+    uint8_t  reserved2[3];
+};
+
+struct telem_slot {
+    uint32_t            seq;
+    uint32_t            pad;
+    struct telem_sample s;
+};
+
+struct telem_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;   /* sizeof(struct telem_header) */
+    uint32_t slot_size;     /* sizeof(struct telem_slot) */
+    uint32_t slots;
+    uint32_t writer_pid;
+    uint64_t head;          /* samples published so far */
+};
+
+#define TELEM_SHM_SIZE (sizeof(struct telem_header) + TELEM_SLOTS * sizeof(struct telem_slot))
+
+/* --- Writer (control loop) --- */
+int  telem_open_writer(void);
+void telem_publish(const struct telem_sample *s);
+void telem_close_writer(void);
+
+/* --- Reader helpers (no syscalls after mmap) --- */
+
+static inline struct telem_slot *telem_slots(const struct telem_header *h) {
+    return (struct telem_slot *)((char *)h + h->header_size);
+}
+
+static inline uint64_t telem_head(const struct telem_header *h) {
+    return __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+}
+
+/* Copy sample number idx; 0 on success, -1 if it was overwritten or not written yet */
+static inline int telem_read(const struct telem_header *h, uint64_t idx, struct telem_sample *out) {
+    const struct telem_slot *slot = (const struct telem_slot *)
+        ((const char *)telem_slots(h) + (idx % h->slots) * h->slot_size);
+    for (int tries = 0; tries < 100; tries++) {
+        uint32_t s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) continue;                       /* writer inside */
+        memcpy(out, &slot->s, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != s1) continue;
+        return (out->index == idx) ? 0 : -1;
+    }
+    return -1;
+}
+
+#endif /* FAN_CONTROL_TELEMETRY_H */
@@ -0,0 +1,106 @@
+/*
+ * throttle.c
+ *
+ * Reads /sys/devices/system/cpu/cpuN/thermal_throttle/{core,package}_throttle_count
+ * and cpufreq/scaling_cur_freq. All fds are opened once and pread() every
+ * cycle. Package counters are repeated on every CPU of the package, so
+ * those count once (max), core counters are summed.
+ */
+
+#include "throttle.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CPU_SYSFS_ROOT  "/sys/devices/system/cpu"
+
+static int      open_cpu_file(int cpu, const char *rel);
+static uint64_t read_u64(int fd, int *ok);
+static uint64_t throttle_count(struct throttle *t);
+
+int throttle_init(struct throttle *t) {
+    t->ncore = t->npkg = t->nfreq = 0;
+    t->events = 0;
+    t->new_events = 0;
+    t->rate_per_min = 0.0;
+    t->boost = 0.0;
+    t->cpu_mhz = 0;
+    t->last_us = 0;
+
+    /* CPUs can be offline (holes): probe a fixed range instead of stopping at the first gap */
+    for (int cpu = 0; cpu < THROTTLE_MAX_CPUS; cpu++) {
+        int fd = open_cpu_file(cpu, "thermal_throttle/core_throttle_count");
+        if (fd >= 0) t->core_fds[t->ncore++] = fd;
+        fd = open_cpu_file(cpu, "thermal_throttle/package_throttle_count");
+        if (fd >= 0) t->pkg_fds[t->npkg++] = fd;
+        fd = open_cpu_file(cpu, "cpufreq/scaling_cur_freq");
+        if (fd >= 0) t->freq_fds[t->nfreq++] = fd;
+    }
+    t->last_count = throttle_count(t);
+    return (t->ncore + t->npkg) ? 0 : -1;
+}
+
+void throttle_close(struct throttle *t) {
+    for (int i = 0; i < t->ncore; i++) close(t->core_fds[i]);
+    for (int i = 0; i < t->npkg; i++)  close(t->pkg_fds[i]);
+    for (int i = 0; i < t->nfreq; i++) close(t->freq_fds[i]);
+    t->ncore = t->npkg = t->nfreq = 0;
+}
+
+void throttle_sample(struct throttle *t, const struct throttle_params *k, long long now_us) {
+    uint64_t count = throttle_count(t);
+    uint64_t delta = (count > t->last_count) ? count - t->last_count : 0;   /* counters can't go back */
+    t->last_count = count;
+    t->events += delta;
+    t->new_events = delta > 0;
+
+    double dt = t->last_us ? (double)(now_us - t->last_us) / 1e6 : 0.0;
+    t->last_us = now_us;
+    if (dt > 0.0) {
+        double alpha = dt / (THROTTLE_RATE_TAU_S + dt);
+        t->rate_per_min += alpha * ((double)delta * 60.0 / dt - t->rate_per_min);
+    }
+
+    /* Step up on every cycle with new events, bleed off slowly without */
+    if (delta > 0 && k->boost_pct > 0) t->boost += k->boost_pct;
+    else t->boost -= k->decay_pct_s * dt;
+    if (t->boost > k->max_pct) t->boost = k->max_pct;
+    if (t->boost < 0.0) t->boost = 0.0;
+
+    uint64_t khz = 0;
+    int n = 0;
+    for (int i = 0; i < t->nfreq; i++) {
+        int ok;
+        uint64_t v = read_u64(t->freq_fds[i], &ok);
+        if (ok) { khz += v; n++; }
+    }
+    t->cpu_mhz = n ? (int)(khz / (uint64_t)n / 1000) : 0;
+}
+
+static uint64_t throttle_count(struct throttle *t) {
+    uint64_t sum = 0, pkg = 0;
+    int ok;
+    for (int i = 0; i < t->ncore; i++) sum += read_u64(t->core_fds[i], &ok);
+    for (int i = 0; i < t->npkg; i++) {
+        uint64_t v = read_u64(t->pkg_fds[i], &ok);
+        if (v > pkg) pkg = v;
+    }
+    return sum + pkg;
+}
+
+static int open_cpu_file(int cpu, const char *rel) {
+    char path[128];
+    snprintf(path, sizeof(path), CPU_SYSFS_ROOT "/cpu%d/%s", cpu, rel);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static uint64_t read_u64(int fd, int *ok) {
+    char buf[32];
+    ssize_t r = pread(fd, buf, sizeof(buf) - 1, 0);
+    *ok = r > 0;
+    if (r <= 0) return 0;
+    buf[r] = 0;
+    return strtoull(buf, NULL, 10);
+}
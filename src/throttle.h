@@ -0,0 +1,49 @@
+/*
+ * throttle.h
+ *
+ * CPU thermal-throttle feedback: kernel throttle event counters and the
+ * current cpufreq clock. New throttle events boost the fans regardless of
+ * what the EC temperature says.
+ */
+
+#ifndef FAN_CONTROL_THROTTLE_H
+#define FAN_CONTROL_THROTTLE_H
+
+#include <stdint.h>
+
+#define THROTTLE_MAX_CPUS         64
+
+/* Defaults, overridable in the config file (throttle_* keys) */
+#define THROTTLE_DEFAULT_BOOST    10     /* % added per cycle that saw new events (0: off) */
+#define THROTTLE_DEFAULT_MAX      40     /* boost cap, % */
+#define THROTTLE_DEFAULT_DECAY    1.0    /* boost decay without events, %/s */
+#define THROTTLE_RATE_TAU_S       10.0   /* smoothing of the reported event rate */
+
+struct throttle_params {
+    int    boost_pct;
+    int    max_pct;
+    double decay_pct_s;
+};
+
+struct throttle {
+    int      core_fds[THROTTLE_MAX_CPUS];   /* cpuN/thermal_throttle/core_throttle_count */
+    int      pkg_fds[THROTTLE_MAX_CPUS];    /* .../package_throttle_count */
+    int      freq_fds[THROTTLE_MAX_CPUS];   /* cpuN/cpufreq/scaling_cur_freq */
+    int      ncore, npkg, nfreq;
+    uint64_t last_count;      /* core sum + package max at the previous sample */
+    uint64_t events;          /* new events since throttle_init() */
+    int      new_events;      /* seen in the latest sample */
+    double   rate_per_min;    /* smoothed */
+    double   boost;           /* current duty boost, % */
+    int      cpu_mhz;         /* average current clock, 0 = unknown */
+    long long last_us;
+};
+
+/* Open and cache every counter/frequency file; 0 if any counter exists */
+int  throttle_init(struct throttle *t);
+void throttle_close(struct throttle *t);
+
+/* pread the counters and clocks, update the rate and the boost */
+void throttle_sample(struct throttle *t, const struct throttle_params *k, long long now_us);
+
+#endif /* FAN_CONTROL_THROTTLE_H */
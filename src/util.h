@@ -0,0 +1,29 @@
+/*
+ * util.h
+ *
+ * Small helpers shared by the modules.
+ */
+
+#ifndef FAN_CONTROL_UTIL_H
+#define FAN_CONTROL_UTIL_H
+
+#include <time.h>
+
+static inline int clamp(int v, int lo, int hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+/* CLOCK_MONOTONIC in microseconds / milliseconds */
+static inline long long mono_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline long long mono_ms(void) {
+    return mono_us() / 1000;
+}
+
+#endif /* FAN_CONTROL_UTIL_H */
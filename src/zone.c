@@ -0,0 +1,130 @@
+/*
+ * zone.c
+ *
+ * Zone terms, binding and aggregation (zone.h). Binding happens once per
+ * scan; zone_temp() only reads the registry's latest values.
+ */
+
+#include "zone.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ZONE_VALID_MIN_MC   1000      /* plausible reading, m°C (filter.h's range) */
+#define ZONE_VALID_MAX_MC   125000
+
+static int parse_term(struct zone_term *t, const char *s, size_t len, char *why, size_t whylen);
+
+int zone_parse_terms(struct zone *z, const char *spec, char *why, size_t whylen) {
+    z->nterms = 0;
+    const char *p = spec;
+    for (;;) {
+        p += strspn(p, " \t,");
+        if (!*p) break;
+        size_t len = strcspn(p, " \t,");
+        if (z->nterms >= ZONE_MAX_TERMS) {
+            snprintf(why, whylen, "more than %d sensors", ZONE_MAX_TERMS);
+            return -1;
+        }
+        if (parse_term(&z->term[z->nterms], p, len, why, whylen) != 0) return -1;
+        z->nterms++;
+        p += len;
+    }
+    if (z->nterms == 0) { snprintf(why, whylen, "no sensors"); return -1; }
+    return 0;
+}
+
+int zone_parse_agg(struct zone *z, const char *name) {
+    if (strcmp(name, "max") == 0) { z->agg = ZONE_AGG_MAX; return 0; }
+    if (strcmp(name, "avg") == 0) { z->agg = ZONE_AGG_AVG; return 0; }
+    char *end = NULL;
+    long p = (name[0] == 'p') ? strtol(name + 1, &end, 10) : 0;
+    if (p < 1 || p > 99 || *end) return -1;
+    z->agg = ZONE_AGG_PCT;
+    z->pct = (int)p;
+    return 0;
+}
+
+const char *zone_agg_name(const struct zone *z, char *buf, size_t len) {
+    if (z->agg == ZONE_AGG_PCT) snprintf(buf, len, "p%d", z->pct);
+    else snprintf(buf, len, "%s", z->agg == ZONE_AGG_AVG ? "avg" : "max");
+    return buf;
+}
+
+int zone_bind(struct zone *z) {
+    z->nmembers = 0;
+    for (int t = 0; t < z->nterms; t++) {
+        int idx[ZONE_MAX_MEMBERS];
+        int n = sensor_match(z->term[t].pattern, idx, ZONE_MAX_MEMBERS - z->nmembers);
+        for (int i = 0; i < n; i++) {
+            // A sensor two patterns match counts once, with the first one's term
+            int dup = 0;
+            for (int m = 0; m < z->nmembers; m++) dup |= z->member[m] == idx[i];
+            if (dup) continue;
+            sensor_use(idx[i]);
+            z->member_term[z->nmembers] = t;
+            z->member[z->nmembers++] = idx[i];
+        }
+    }
+    return z->nmembers;
+}
+
+/* Hot path: at most ZONE_MAX_MEMBERS values, no I/O */
+int zone_temp(const struct zone *z) {
+    double v[ZONE_MAX_MEMBERS], w[ZONE_MAX_MEMBERS];
+    int n = 0;
+    for (int m = 0; m < z->nmembers; m++) {
+        int milli = sensor_at(z->member[m])->milli;
+        if (milli < ZONE_VALID_MIN_MC || milli > ZONE_VALID_MAX_MC) continue;
+        const struct zone_term *t = &z->term[z->member_term[m]];
+        v[n] = milli / 1000.0 + t->offset;
+        w[n++] = t->weight;
+    }
+    if (n == 0) return -1;
+
+    double out = v[0];
+    if (z->agg == ZONE_AGG_MAX) {
+        for (int i = 1; i < n; i++) if (v[i] > out) out = v[i];
+    } else if (z->agg == ZONE_AGG_AVG) {
+        double sum = 0.0, wsum = 0.0;
+        for (int i = 0; i < n; i++) { sum += w[i] * v[i]; wsum += w[i]; }
+        if (wsum > 0.0) out = sum / wsum;
+    } else {
+        // Nearest rank, on a sorted copy (insertion sort: n is tiny)
+        for (int i = 1; i < n; i++) {
+            double x = v[i];
+            int j = i - 1;
+            for (; j >= 0 && v[j] > x; j--) v[j + 1] = v[j];
+            v[j + 1] = x;
+        }
+        int rank = (z->pct * n + 99) / 100;
+        out = v[rank > 0 ? rank - 1 : 0];
+    }
+    return out > 0.0 ? (int)(out + 0.5) : 0;
+}
+
+/* "pattern[@weight][+offset|-offset]" */
+static int parse_term(struct zone_term *t, const char *s, size_t len, char *why, size_t whylen) {
+    char buf[64];
+    if (len >= sizeof(buf) || len == 0) { snprintf(why, whylen, "bad sensor \"%.*s\"", (int)len, s); return -1; }
+    memcpy(buf, s, len);
+    buf[len] = 0;
+
+    t->weight = 1.0;
+    t->offset = 0.0;
+    size_t plen = strcspn(buf, "@+-");
+    char *p = buf + plen;
+    if (*p == '@') {
+        t->weight = strtod(p + 1, &p);
+        if (t->weight < 0.0 || t->weight > 100.0) { snprintf(why, whylen, "weight out of range in \"%s\"", buf); return -1; }
+    }
+    if (*p == '+' || *p == '-') {
+        t->offset = strtod(p, &p);
+        if (t->offset < -50.0 || t->offset > 50.0) { snprintf(why, whylen, "offset out of range in \"%s\"", buf); return -1; }
+    }
+    if (*p || plen == 0 || plen >= sizeof(t->pattern)) { snprintf(why, whylen, "bad sensor \"%s\"", buf); return -1; }
+    memcpy(t->pattern, buf, plen);
+    t->pattern[plen] = 0;
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * zone.h
+ *
+ * Thermal zones: a named group of registry sensors (sensor.h) reduced to
+ * one temperature - the hottest, a weighted average or a percentile, each
+ * sensor with its own offset - feeding its own curve on the fans it is
+ * assigned to. With zones configured, a fan follows the hottest of its
+ * zones instead of the CPU/GPU sides (control.h).
+ *
+ * Sensor terms, space separated: "pattern[@weight][+offset|-offset]",
+ * pattern an fnmatch() glob over the registry ids, e.g.
+ *   amdgpu/edge amdgpu/junction-10 amdgpu/mem@0.5-15 nvme*
+ */
+
+#ifndef FAN_CONTROL_ZONE_H
+#define FAN_CONTROL_ZONE_H
+
+#include <stddef.h>
+
+#include "curve.h"
+#include "sensor.h"
+
+#define ZONE_MAX           8
+#define ZONE_MAX_TERMS     16     /* patterns per zone */
+#define ZONE_MAX_MEMBERS   16     /* sensors per zone once the globs are expanded */
+#define ZONE_NAME_MAX      16
+
+enum { ZONE_AGG_MAX, ZONE_AGG_AVG, ZONE_AGG_PCT };
+
+struct zone_term {
+    char   pattern[SENSOR_ID_MAX];
+    double weight;                /* avg only */
+    double offset;                /* °C, added before aggregating */
+};
+
+struct zone {
+    char name[ZONE_NAME_MAX];
+    int  agg;                     /* ZONE_AGG_* */
+    int  pct;                     /* ZONE_AGG_PCT: 1..99 */
+    int  fans;                    /* bit 0: fan1, bit 1: fan2 */
+    int  have_curve;              /* else each fan's own curve */
+    struct fan_curve curve;
+    int  nterms;
+    struct zone_term term[ZONE_MAX_TERMS];
+
+    /* Bound by zone_bind() against the current registry */
+    int  nmembers;
+    int  member[ZONE_MAX_MEMBERS];        /* sensor index */
+    int  member_term[ZONE_MAX_MEMBERS];   /* term it came from */
+};
+
+/* Sensor terms (see above) into z->term; 0, or -1 with why */
+int  zone_parse_terms(struct zone *z, const char *spec, char *why, size_t whylen);
+
+/* "max" / "avg" / "p<1..99>"; 0, or -1 if unknown */
+int  zone_parse_agg(struct zone *z, const char *name);
+
+/* "max", "avg", "p90" */
+const char *zone_agg_name(const struct zone *z, char *buf, size_t len);
+
+/* Resolve the terms against the registry and mark the members used
+   (sensor_use()); returns the number of members */
+int  zone_bind(struct zone *z);
+
+/* Aggregate the members' latest readings, rounded °C; -1 if none has one */
+int  zone_temp(const struct zone *z);
+
+#endif /* FAN_CONTROL_ZONE_H */
@@ -0,0 +1,29 @@
+/*
+ * check.h
+ *
+ * Minimal checks for the unit tests: CHECK() reports a failure and goes
+ * on, check_done() is main()'s exit status.
+ */
+
+#ifndef FAN_CONTROL_CHECK_H
+#define FAN_CONTROL_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int g_check_failed;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_check_failed++;                                                \
+        }                                                                    \
+    } while (0)
+
+static inline int check_done(void) {
+    if (g_check_failed) fprintf(stderr, "%d check%s failed\n", g_check_failed, g_check_failed == 1 ? "" : "s");
+    return g_check_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif /* FAN_CONTROL_CHECK_H */
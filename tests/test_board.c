@@ -0,0 +1,62 @@
+/*
+ * test_board.c
+ *
+ * Board profile selection from DMI strings (board.h): the fnmatch()
+ * patterns, case folding, the read-only fallback (vendor-only matches
+ * included), and the table itself.
+ */
+
+#include "check.h"
+#include "board.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *match(const char *vendor, const char *product, const char *board) {
+    struct board_dmi d;
+    snprintf(d.sys_vendor, sizeof(d.sys_vendor), "%s", vendor);
+    snprintf(d.product_name, sizeof(d.product_name), "%s", product);
+    snprintf(d.board_name, sizeof(d.board_name), "%s", board);
+    return board_match(&d)->name;
+}
+
+static void test_match(void) {
+    CHECK(strcmp(match("GIGABYTE", "G5 KF", "G5 KF"), "gigabyte-g5") == 0);
+    CHECK(strcmp(match("Gigabyte Technology Co., Ltd.", "g5 md", ""), "gigabyte-g5") == 0);
+    CHECK(strcmp(match("GIGABYTE", "AORUS 15", "AORUS 15"), BOARD_UNKNOWN) == 0);
+    CHECK(strcmp(match("GIGABYTE", "XG5 KF", ""), BOARD_UNKNOWN) == 0);       /* whole string */
+
+    /* A vendor alone never selects a writable profile */
+    CHECK(strcmp(match("Notebook", "NH5xHP", "NH5xHP"), BOARD_UNKNOWN) == 0);
+    CHECK(strcmp(match("NOTEBOOK", "", ""), BOARD_UNKNOWN) == 0);
+    CHECK(strcmp(match("GIGABYTE", "", ""), BOARD_UNKNOWN) == 0);
+    CHECK(strcmp(match("", "", ""), BOARD_UNKNOWN) == 0);                      /* DMI unreadable */
+
+    struct board_dmi none;
+    memset(&none, 0, sizeof(none));
+    CHECK(board_match(&none)->read_only);
+}
+
+static void test_table(void) {
+    int n = 0;
+    while (board_at(n)) n++;
+    CHECK(n >= 2);
+    CHECK(board_at(-1) == NULL);
+
+    /* The fallback is last and read-only; every other entry can write, and
+       is keyed on a product or board name */
+    CHECK(strcmp(board_at(n - 1)->name, BOARD_UNKNOWN) == 0 && board_at(n - 1)->read_only);
+    for (int i = 0; i < n; i++) {
+        const struct board_profile *b = board_at(i);
+        CHECK(board_by_name(b->name) == b);       /* names are unique */
+        CHECK(b->duty_raw_max > 0 && b->rpm_k > 0);
+        if (i < n - 1) CHECK(!b->read_only && (b->product_name || b->board_name));
+    }
+    CHECK(board_by_name("no-such-board") == NULL);
+}
+
+int main(void) {
+    test_match();
+    test_table();
+    return check_done();
+}
@@ -0,0 +1,159 @@
+/*
+ * test_config.c
+ *
+ * config_load() on small files: the defaults, keys and their ranges, the
+ * "path:line: why" errors, and zones down to an aggregated temperature.
+ */
+
+#include "check.h"
+#include "config.h"
+#include "sampler.h"
+#include "sensor.h"
+#include "zone.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static char g_path[] = "/tmp/fan-control-test-XXXXXX";
+
+/* Write text to the scratch file and load it; err gets config_load's message */
+static int load(const char *text, struct config *cfg, char *err, size_t errlen) {
+    FILE *f = fopen(g_path, "w");
+    if (!f) { perror(g_path); exit(EXIT_FAILURE); }
+    fputs(text, f);
+    fclose(f);
+    err[0] = 0;
+    return config_load(g_path, 0, cfg, err, errlen);
+}
+
+/* err is "<path>:<line>: <why>" */
+static int err_is(const char *err, int line, const char *why) {
+    char want[256];
+    snprintf(want, sizeof(want), "%s:%d: %s", g_path, line, why);
+    return strcmp(err, want) == 0;
+}
+
+static void test_defaults(void) {
+    struct config def, cfg;
+    char err[256];
+    config_defaults(&def);
+
+    CHECK(config_load("/nonexistent/fan-control.conf", 1, &cfg, err, sizeof(err)) == 0);
+    CHECK(config_load("/nonexistent/fan-control.conf", 0, &cfg, err, sizeof(err)) != 0);
+
+    CHECK(load("# nothing but a comment\n\n", &cfg, err, sizeof(err)) == 0);
+    CHECK(cfg.max_temp_c == CONFIG_DEFAULT_MAX_TEMP);
+    CHECK(cfg.min_interval_ms == def.min_interval_ms && cfg.max_interval_ms == def.max_interval_ms);
+    CHECK(cfg.controller == CONTROLLER_CURVE && cfg.nzones == 0);
+    CHECK(memcmp(&cfg.curve[0], &def.curve[0], sizeof(cfg.curve[0])) == 0);
+}
+
+static void test_keys(void) {
+    struct config cfg;
+    char err[256];
+    CHECK(load("max_temp = 85   # trailing comment\n"
+               "  controller=pid\n"
+               "curve1 = 45:30 70:60 85:100\n"
+               "min_interval = 50\n"
+               "max_interval = 2000\n", &cfg, err, sizeof(err)) == 0);
+    CHECK(cfg.max_temp_c == 85);
+    CHECK(cfg.controller == CONTROLLER_PID);
+    CHECK(cfg.min_interval_ms == 50 && cfg.max_interval_ms == 2000);
+    CHECK(cfg.curve[0].npoints == 3 && cfg.curve[0].temp[1] == 70 && cfg.curve[0].duty[1] == 60);
+    CHECK(cfg.curve[1].npoints == 2);             /* fan2 keeps the default curve */
+    CHECK(cfg.curve[0].duty_for_temp[1][90] == 100);
+}
+
+static void test_errors(void) {
+    struct config cfg;
+    char err[256], why[128];
+
+    CHECK(load("step = 2\nbogus = 1\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(err_is(err, 2, "unknown key 'bogus'"));
+    CHECK(cfg.step_pct == CONFIG_DEFAULT_STEP);   /* a failed load leaves the defaults */
+
+    CHECK(load("max_temp\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(err_is(err, 1, "expected key = value"));
+
+    CHECK(load("min_interval = 5\n", &cfg, err, sizeof(err)) != 0);
+    snprintf(why, sizeof(why), "'5': expected an integer in %d..%d", SAMPLER_FLOOR_MS, SAMPLER_BASE_MS);
+    CHECK(err_is(err, 1, why));
+    CHECK(load("max_interval = 999999999\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(load("max_temp = 80x\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(load("controller = bangbang\n", &cfg, err, sizeof(err)) != 0);
+}
+
+static void test_zones(void) {
+    struct config cfg;
+    char err[256];
+    CHECK(load("zone.gpu = amdgpu/edge amdgpu/junction-10 amdgpu/mem@0.5+5\n"
+               "zone.gpu.agg = p90\n"
+               "zone.gpu.fans = 2\n"
+               "zone.gpu.curve = 45:25 85:100\n"
+               "zone.disk = nvme*\n", &cfg, err, sizeof(err)) == 0);
+    CHECK(cfg.nzones == 2);
+
+    const struct zone *z = &cfg.zone[0];
+    CHECK(strcmp(z->name, "gpu") == 0);
+    CHECK(z->nterms == 3);
+    CHECK(strcmp(z->term[1].pattern, "amdgpu/junction") == 0 && z->term[1].offset == -10.0);
+    CHECK(strcmp(z->term[2].pattern, "amdgpu/mem") == 0);
+    CHECK(z->term[2].weight == 0.5 && z->term[2].offset == 5.0);
+    CHECK(z->agg == ZONE_AGG_PCT && z->pct == 90);
+    CHECK(z->fans == 2 && z->have_curve && z->curve.npoints == 2);
+
+    z = &cfg.zone[1];
+    CHECK(strcmp(z->name, "disk") == 0 && z->agg == ZONE_AGG_MAX && z->fans == 3 && !z->have_curve);
+
+    CHECK(load("zone.a = x\nzone.a.agg = p100\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(err_is(err, 2, "zone agg must be max, avg or p1..p99"));
+    CHECK(load("zone.a = x\nzone.a.fans = 3\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(load("zone.a = x\nzone.a.color = red\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(err_is(err, 2, "unknown key 'zone.a.color'"));
+    CHECK(load("zone.a = x@200\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(load("zone.a = x+60\n", &cfg, err, sizeof(err)) != 0);
+    CHECK(load("zone.a.agg = avg\n", &cfg, err, sizeof(err)) != 0);   /* never given sensors */
+    CHECK(cfg.nzones == 0);
+}
+
+/* The EC inputs are always in the registry: bind and aggregate them */
+static void test_zone_temp(void) {
+    struct zone z;
+    char why[128], buf[8];
+    memset(&z, 0, sizeof(z));
+    sensor_scan();
+
+    CHECK(zone_parse_terms(&z, "ec/cpu+5, ec/gpu@3 ec/*", why, sizeof(why)) == 0);
+    CHECK(z.nterms == 3);
+    CHECK(zone_bind(&z) == 2);                    /* the glob adds nothing new */
+    sensor_update(60, 70, -1, 0);
+
+    z.agg = ZONE_AGG_MAX;
+    CHECK(zone_temp(&z) == 70);
+    CHECK(zone_parse_agg(&z, "avg") == 0);
+    CHECK(zone_temp(&z) == 69);                   /* (65 + 3 * 70) / 4 = 68.75 */
+    CHECK(zone_parse_agg(&z, "p50") == 0);
+    CHECK(zone_temp(&z) == 65);
+    CHECK(strcmp(zone_agg_name(&z, buf, sizeof(buf)), "p50") == 0);
+    CHECK(zone_parse_agg(&z, "p0") != 0 && zone_parse_agg(&z, "median") != 0);
+
+    sensor_update(-1, -1, -1, 0);
+    CHECK(zone_temp(&z) == -1);
+    sensor_close();
+}
+
+int main(void) {
+    int fd = mkstemp(g_path);
+    if (fd < 0) { perror("mkstemp"); return EXIT_FAILURE; }
+    close(fd);
+
+    test_defaults();
+    test_keys();
+    test_errors();
+    test_zones();
+    test_zone_temp();
+
+    unlink(g_path);
+    return check_done();
+}
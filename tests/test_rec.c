@@ -0,0 +1,138 @@
+/*
+ * test_rec.c
+ *
+ * Trace writer and reader round trip across window swaps and file
+ * rotation, continuing after a reopen, and a rotation that cannot be
+ * prepared (the next file is a directory) surfacing as dropped records.
+ */
+
+#include "check.h"
+#include "rec.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define T0_MS 1760000000000ll
+
+static char g_dir[] = "/tmp/fan-control-test-XXXXXX";
+
+static struct telem_sample sample(long i) {
+    struct telem_sample s;
+    memset(&s, 0, sizeof(s));
+    s.mono_ns = (uint64_t)i * 1000000000u;
+    s.real_ns = (uint64_t)(T0_MS + i * 1000) * 1000000u;
+    s.cpu_temp_c = (int16_t)(40 + i % 50);
+    s.gpu_temp_c = (int16_t)(45 + i % 7);
+    s.duty1 = (uint8_t)(i % 101);
+    s.duty2 = 50;
+    s.cpu_load_pct = (uint8_t)(i % 100);
+    s.cycle_us = 200;
+    return s;
+}
+
+/* Append, waiting out a window the worker has not mapped yet */
+static int append(struct rec_writer *w, long i) {
+    struct telem_sample s = sample(i);
+    for (int tries = 0; tries < 2000; tries++) {
+        if (rec_append(w, &s) == 0) return 0;
+        if (errno != EAGAIN) return -1;
+        usleep(1000);
+    }
+    return -1;
+}
+
+/* Number of records in the trace, each checked against sample() and the
+   sequence without gaps; first and last index */
+static long read_back(long *first, long *last) {
+    struct rec_reader r;
+    struct rec_sample s;
+    long n = 0, bad = 0;
+    *first = *last = -1;
+    if (rec_reader_open(&r, g_dir) != 0) return 0;
+    while (rec_next(&r, &s) == 1) {
+        long i = (long)((s.real_ms - T0_MS) / 1000);
+        struct telem_sample want = sample(i);
+        bad += (n > 0 && i != *last + 1) || s.cpu_temp != want.cpu_temp_c || s.gpu_temp != want.gpu_temp_c ||
+               s.duty1 != want.duty1 || s.cpu_load != want.cpu_load_pct;
+        if (n++ == 0) *first = i;
+        *last = i;
+    }
+    rec_reader_close(&r);
+    CHECK(bad == 0);
+    return n;
+}
+
+static void clear_dir(void) {
+    for (int i = 0; i < 4; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s/" REC_FILE_PREFIX "%d", g_dir, i);
+        if (unlink(path) != 0) rmdir(path);
+    }
+}
+
+/* 1 MB files hold ~87k slots: 200k records fill more than two */
+static void test_rotation(int files) {
+    struct rec_writer w;
+    long n = 200000, first, last, failed = 0;
+    clear_dir();
+    CHECK(rec_open(&w, g_dir, files, 1) == 0);
+    for (long i = 0; i < n; i++) failed += append(&w, i) != 0;
+    rec_close(&w);
+    CHECK(failed == 0);
+
+    long got = read_back(&first, &last);
+    CHECK(last == n - 1);
+    CHECK(got == last - first + 1);
+    if (files >= 3) CHECK(first == 0 && got == n);
+    else CHECK(first > 0 && got >= (long)(w.slots * (files - 1)) * 9 / 10);
+}
+
+static void test_reopen(void) {
+    struct rec_writer w;
+    long first, last;
+    clear_dir();
+    CHECK(rec_open(&w, g_dir, 2, 1) == 0);
+    for (long i = 0; i < 5000; i++) CHECK(append(&w, i) == 0);
+    rec_close(&w);
+    CHECK(rec_open(&w, g_dir, 2, 1) == 0);   /* continues trace.0, past a window boundary */
+    for (long i = 5000; i < 10000; i++) CHECK(append(&w, i) == 0);
+    rec_close(&w);
+
+    CHECK(read_back(&first, &last) == 10000 && first == 0 && last == 9999);
+}
+
+static void test_failed_rotation(void) {
+    struct rec_writer w;
+    char path[64];
+    long first, last, i = 0;
+    clear_dir();
+    snprintf(path, sizeof(path), "%s/" REC_FILE_PREFIX "1", g_dir);
+    CHECK(mkdir(path, 0755) == 0);
+
+    CHECK(rec_open(&w, g_dir, 2, 1) == 0);
+    while (i < 200000 && append(&w, i) == 0) i++;
+    int e = errno;
+    CHECK(i < 200000 && e == EISDIR);
+    CHECK(rec_append(&w, &(struct telem_sample){ .mono_ns = 0 }) != 0);   /* still stalled */
+    rec_close(&w);
+
+    CHECK(read_back(&first, &last) == i && first == 0 && last == i - 1);
+    rmdir(path);
+}
+
+int main(void) {
+    if (!mkdtemp(g_dir)) { perror("mkdtemp"); return EXIT_FAILURE; }
+
+    test_rotation(4);
+    test_rotation(2);
+    test_rotation(1);
+    test_reopen();
+    test_failed_rotation();
+
+    clear_dir();
+    rmdir(g_dir);
+    return check_done();
+}
@@ -0,0 +1,111 @@
+/*
+ * test_state.c
+ *
+ * state_save() / state_load() round trip through a scratch directory, the
+ * load-time sanitizing, and state_fresh()'s boot and age checks.
+ */
+
+#include "check.h"
+#include "state.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static char g_dir[] = "/tmp/fan-control-test-XXXXXX";
+static char g_path[sizeof(g_dir) + 8];
+
+/* Equal to the precision state_save() writes */
+static int near(double a, double b) { return fabs(a - b) < 1e-3; }
+
+static void test_round_trip(void) {
+    struct state out, in;
+    memset(&out, 0, sizeof(out));
+    out.stamp = 1760000000;
+    snprintf(out.boot_id, sizeof(out.boot_id), "6f1c2a3b-0000-4000-8000-123456789abc");
+    out.controller = 1;
+    out.duty[0] = 45;
+    out.duty[1] = 100;
+    out.filt_x[0] = 61.25;  out.filt_dx[0] = -0.125;
+    out.filt_x[1] = 70.5;   out.filt_dx[1] = 0.0625;
+    out.pid_integ[0] = 12.3456;  out.pid_t_filt[0] = 63.5;  out.pid_duty[0] = 44.75;
+    out.pid_integ[1] = -3.25;    out.pid_t_filt[1] = 71.25; out.pid_duty[1] = 99.5;
+    out.calib_stamp = 1750000000;
+    out.trim[0] = 1.5;
+    out.trim[1] = -2.25;
+    out.nsensors = 2;
+    snprintf(out.sensors[0], sizeof(out.sensors[0]), "/sys/class/hwmon/hwmon3/temp1_input");
+    snprintf(out.sensors[1], sizeof(out.sensors[1]), "/sys/class/hwmon/hwmon5/temp2_input");
+
+    CHECK(state_save(g_path, &out) == 0);
+    CHECK(state_load(g_path, &in) == 0);
+
+    CHECK(in.stamp == out.stamp && in.calib_stamp == out.calib_stamp);
+    CHECK(strcmp(in.boot_id, out.boot_id) == 0);
+    CHECK(in.controller == out.controller);
+    for (int i = 0; i < 2; i++) {
+        CHECK(in.duty[i] == out.duty[i]);
+        CHECK(near(in.filt_x[i], out.filt_x[i]) && near(in.filt_dx[i], out.filt_dx[i]));
+        CHECK(near(in.pid_integ[i], out.pid_integ[i]));
+        CHECK(near(in.pid_t_filt[i], out.pid_t_filt[i]) && near(in.pid_duty[i], out.pid_duty[i]));
+        CHECK(near(in.trim[i], out.trim[i]));
+    }
+    CHECK(in.nsensors == 2);
+    CHECK(strcmp(in.sensors[0], out.sensors[0]) == 0 && strcmp(in.sensors[1], out.sensors[1]) == 0);
+
+    /* Written through a temporary file, which is gone afterwards */
+    char tmp[sizeof(g_path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_path);
+    CHECK(access(tmp, F_OK) != 0);
+}
+
+static void test_load(void) {
+    struct state s;
+    char missing[sizeof(g_dir) + 16];
+    snprintf(missing, sizeof(missing), "%s/missing", g_dir);
+    errno = 0;
+    CHECK(state_load(missing, &s) == -1 && errno == ENOENT);
+
+    /* Unknown keys and comments are skipped, out-of-range duties dropped */
+    FILE *f = fopen(g_path, "w");
+    if (!f) { perror(g_path); exit(EXIT_FAILURE); }
+    fputs("# hand-edited\nstamp = 42\nfuture_key = 1\nduty = 120 -5\ncontroller = 1\n", f);
+    fclose(f);
+    CHECK(state_load(g_path, &s) == 0);
+    CHECK(s.stamp == 42 && s.controller == 1);
+    CHECK(s.duty[0] == 0 && s.duty[1] == 0);
+    CHECK(s.nsensors == 0 && s.boot_id[0] == 0);
+}
+
+static void test_fresh(void) {
+    struct state s;
+    memset(&s, 0, sizeof(s));
+    state_boot_id(s.boot_id);
+    if (!s.boot_id[0]) return;                    /* no boot id here: never fresh */
+
+    s.stamp = (long long)time(NULL);
+    CHECK(state_fresh(&s));
+    s.stamp -= STATE_MAX_AGE_S + 1;
+    CHECK(!state_fresh(&s));
+    s.stamp = (long long)time(NULL) + 60;         /* from the future: a clock jump */
+    CHECK(!state_fresh(&s));
+    s.stamp = (long long)time(NULL);
+    s.boot_id[0] ^= 1;                            /* another boot */
+    CHECK(!state_fresh(&s));
+}
+
+int main(void) {
+    if (!mkdtemp(g_dir)) { perror("mkdtemp"); return EXIT_FAILURE; }
+    snprintf(g_path, sizeof(g_path), "%s/state", g_dir);
+
+    test_round_trip();
+    test_load();
+    test_fresh();
+
+    unlink(g_path);
+    rmdir(g_dir);
+    return check_done();
+}